@@ -19,8 +19,12 @@
 
 #include "back-merkle-tree.h"
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
+#include <vector>
+
+#include "os-parallel.h"
 
 namespace cartesi {
 
@@ -52,13 +56,18 @@ back_merkle_tree::back_merkle_tree(int log2_root_size, int log2_leaf_size, int l
 }
 
 void back_merkle_tree::push_back(const hash_type &new_leaf_hash) {
-    hasher_type h;
-    hash_type right = new_leaf_hash;
     if (m_leaf_count >= m_max_leaves) {
         throw std::out_of_range{"too many leaves"};
     }
+    push_back_subtree(new_leaf_hash, 0);
+}
+
+void back_merkle_tree::push_back_subtree(const hash_type &subtree_hash, int log2_leaf_count) {
+    hasher_type h;
+    hash_type right = subtree_hash;
+    assert((m_leaf_count & ((address_type{1} << log2_leaf_count) - 1)) == 0);
     const int depth = m_log2_root_size - m_log2_leaf_size;
-    for (int i = 0; i <= depth; ++i) {
+    for (int i = log2_leaf_count; i <= depth; ++i) {
         if (m_leaf_count & (address_type{1} << i)) {
             const auto &left = m_context[i];
             get_concat_hash(h, left, right, right);
@@ -67,7 +76,72 @@ void back_merkle_tree::push_back(const hash_type &new_leaf_hash) {
             break;
         }
     }
-    ++m_leaf_count;
+    m_leaf_count += address_type{1} << log2_leaf_count;
+}
+
+/// \brief Computes the root hash of a complete subtree from its leaf hashes
+/// \param h Hasher object
+/// \param leaf_hashes Pointer to the 2^log2_leaf_count leaf hashes
+/// \param log2_leaf_count Log<sub>2</sub> of number of leaves in subtree
+/// \returns Root hash of subtree
+static back_merkle_tree::hash_type get_subtree_hash(back_merkle_tree::hasher_type &h,
+    const back_merkle_tree::hash_type *leaf_hashes, int log2_leaf_count) {
+    if (log2_leaf_count == 0) {
+        return leaf_hashes[0];
+    }
+    auto left = get_subtree_hash(h, leaf_hashes, log2_leaf_count - 1);
+    const auto right = get_subtree_hash(h, leaf_hashes + (UINT64_C(1) << (log2_leaf_count - 1)), log2_leaf_count - 1);
+    get_concat_hash(h, left, right, left);
+    return left;
+}
+
+void back_merkle_tree::push_back_range(const hash_type *new_leaf_hashes, uint64_t new_leaf_count,
+    uint64_t concurrency) {
+    if (new_leaf_count > m_max_leaves || m_leaf_count + new_leaf_count > m_max_leaves) {
+        throw std::out_of_range{"too many leaves"};
+    }
+    if (new_leaf_count == 0) {
+        return;
+    }
+    const uint64_t n = concurrency > 0 ? concurrency : std::max(os_get_concurrency(), UINT64_C(1));
+    // Limit the size of subtrees so there are a few of them for each thread
+    int max_log2_leaf_count = std::numeric_limits<address_type>::digits - 1;
+    if (n > 1) {
+        const uint64_t target = std::max(new_leaf_count / (4 * n), UINT64_C(1));
+        max_log2_leaf_count = std::numeric_limits<uint64_t>::digits - 1 - __builtin_clzll(target);
+    }
+    // Split range into subtrees aligned to their own size
+    struct subtree {
+        uint64_t first;      ///< Index of first leaf hash in range
+        int log2_leaf_count; ///< Log<sub>2</sub> of number of leaves
+        hash_type hash;      ///< Root hash
+    };
+    std::vector<subtree> subtrees;
+    for (uint64_t first = 0; first < new_leaf_count;) {
+        const address_type leaf_index = m_leaf_count + first;
+        const uint64_t remaining = new_leaf_count - first;
+        int log2_leaf_count = std::numeric_limits<uint64_t>::digits - 1 - __builtin_clzll(remaining);
+        if (leaf_index != 0) {
+            log2_leaf_count = std::min(log2_leaf_count, __builtin_ctzll(leaf_index));
+        }
+        log2_leaf_count = std::min(log2_leaf_count, max_log2_leaf_count);
+        subtrees.push_back({first, log2_leaf_count, {}});
+        first += UINT64_C(1) << log2_leaf_count;
+    }
+    // Compute subtree hashes, with thread j responsible for subtree i if i % n == j
+    os_parallel_for(std::min(n, static_cast<uint64_t>(subtrees.size())),
+        [&subtrees, new_leaf_hashes, n](uint64_t j, const parallel_for_mutex & /*mutex*/) -> bool {
+            hasher_type h;
+            for (uint64_t i = j; i < subtrees.size(); i += n) {
+                auto &s = subtrees[i];
+                s.hash = get_subtree_hash(h, new_leaf_hashes + s.first, s.log2_leaf_count);
+            }
+            return true;
+        });
+    // Add subtrees to context in order
+    for (const auto &s : subtrees) {
+        push_back_subtree(s.hash, s.log2_leaf_count);
+    }
 }
 
 void back_merkle_tree::pad_back(uint64_t new_leaf_count) {
@@ -87,6 +87,21 @@ public:
     /// log time (log2_root_size-log2_leaf_size)
     void push_back(const hash_type &new_leaf_hash);
 
+    /// \brief Appends a range of new hashes to the tree
+    /// \param new_leaf_hashes Pointer to hashes of new leaf data
+    /// \param new_leaf_count Number of hashes to append
+    /// \param concurrency Number of threads to use, or 0 to use all host threads
+    /// \details
+    /// The range is split into subtrees that are aligned to their own size
+    /// in the tree, largest first, just like the complete subtrees in the
+    /// context.
+    /// The root hashes of these subtrees are computed independently, and
+    /// in parallel.
+    /// Each root hash of a subtree with 2^j leaves is then added to the
+    /// context as in push_back(), but starting at entry j.
+    /// The result is the same as calling push_back() for each hash in turn.
+    void push_back_range(const hash_type *new_leaf_hashes, uint64_t new_leaf_count, uint64_t concurrency = 1);
+
     /// \brief Appends a number of padding hashes to the tree
     /// \param leaf_count Number of padding hashes to append
     /// \details
@@ -137,6 +152,12 @@ public:
     proof_type get_next_leaf_proof(void) const;
 
 private:
+    /// \brief Appends the root hash of a complete subtree to the tree
+    /// \param subtree_hash Root hash of subtree
+    /// \param log2_leaf_count Log<sub>2</sub> of number of leaves in subtree
+    /// \details The number of leaves already in the tree must be a multiple of the subtree size.
+    void push_back_subtree(const hash_type &subtree_hash, int log2_leaf_count);
+
     int m_log2_root_size;                   ///< Log<sub>2</sub> of tree size
     int m_log2_leaf_size;                   ///< Log<sub>2</sub> of leaf size
     address_type m_leaf_count;              ///< Number of leaves already added
@@ -73,6 +73,7 @@ where options are:
 
   --ram-image=<filename>
     name of file containing RAM image (default: "linux.bin").
+    the file is mapped, not copied, unless --copy-images is given.
 
   --no-ram-image
     forget settings for RAM image.
@@ -83,6 +84,7 @@ where options are:
   --dtb-image=<filename>
     name of file containing DTB image
     (default: auto generated flattened device tree).
+    the file is mapped, not copied, unless --copy-images is given.
 
   --no-bootargs
     clear default bootargs.
@@ -234,12 +236,27 @@ where options are:
 
     <key>:<value> is one of
         update_merkle_tree:<number>
+        background_merkle_tree_interval:<number>
+        images:<number>
 
         update_merkle_tree (optional)
         defines the number of threads to use while calculating the merkle tree.
         when omitted or defined as 0, the number of hardware threads is used if
         it can be identified or else a single thread is used.
 
+        background_merkle_tree_interval (optional)
+        while the machine runs, every <number> cycles, copies the memory pages
+        modified since the last update and hashes them in background threads,
+        so the root hash is ready sooner when requested.
+        when omitted or defined as 0, pages are only hashed when needed.
+
+        images (optional)
+        defines the number of threads to use while storing and loading memory
+        images, including compressing and decompressing them (see
+        --compress-images).
+        when omitted or defined as 0, the number of hardware threads is used if
+        it can be identified or else a single thread is used.
+
   --htif-no-console-putchar
     suppress any console output during machine run.
     this includes anything written to machine's stdout or stderr.
@@ -258,6 +275,45 @@ where options are:
 
     DON'T USE THIS OPTION IN PRODUCTION
 
+  --use-page-hashes
+    store the merkle tree page hashes next to the memory images when storing
+    a machine, and use them instead of rehashing the images when loading.
+    installed page hashes are checked against the data by merkle tree verification.
+
+  --reclaim-pristine-pages
+    when updating the merkle tree, return the host memory backing pages that
+    are found to contain only zeros, so machines that free memory use less
+    host memory. the pages read as zeros and are allocated again when written.
+
+  --soft-dirty-tracking
+    use the soft-dirty bits of the host (linux only) to find which pages of
+    memory ranges were written to, instead of assuming every page in the
+    write tlb was. the option covers all memory ranges backed by host memory
+    (ram, flash drives, cmio buffers, etc.); ranges cannot be selected
+    individually. the bits belong to the whole process, so only one machine
+    per process can use them at a time; the others, and hosts without
+    support, silently keep the default scheme.
+
+  --huge-pages
+    ask the host (linux only) to back ram and the other memory ranges that are
+    not flash drive images with transparent huge pages, reducing tlb misses of
+    the host. pages are still tracked and hashed 4KiB at a time, but reclaiming
+    pristine pages splits the huge pages that hold them.
+
+  --compress-images
+    compress the images of memory ranges when storing the machine, except for
+    shared ranges. images are split in chunks that are compressed and, when
+    the machine is loaded, decompressed in parallel (see --concurrency).
+
+  --copy-images
+    read the ram and dtb images, and the memory images of stored machines,
+    into memory when the machine is created or loaded. by default they are
+    mapped privately from their files instead (linux only), so pages are only
+    read when first accessed. pages the machine never wrote keep following the
+    file, so a mapped image must not be rewritten or truncated while the
+    machine exists: later changes to the file show through, and truncating it
+    kills the process with SIGBUS.
+
   --skip-version-check
     skip emulator version check when loading a stored machine.
     i.e., assume the stored machine is compatible with current emulator version.
@@ -419,8 +475,18 @@ where options are:
     store machine to <directory>, where "%%h" is substituted by the
     state hash in the directory name.
 
+  --store-base=<directory>
+    when storing the machine, only store the pages of memory ranges that
+    differ from the machine previously stored in <directory>. loading the
+    stored machine applies them over it, so <directory> must be kept.
+
+  --store-file
+    store the machine given by --store into a single file instead of a
+    directory. memory ranges are mapped directly from the file when
+    it is loaded.
+
   --load=<directory>
-    load machine previously stored in <directory>.
+    load machine previously stored in <directory>, or in a single file.
 
   --initial-hash
     print initial state hash before running machine.
@@ -583,9 +649,17 @@ local cmio
 local cmio_advance
 local cmio_inspect
 local concurrency_update_merkle_tree = 0
+local concurrency_background_merkle_tree_interval = 0
+local concurrency_images = 0
 local skip_root_hash_check = false
 local skip_root_hash_store = false
 local skip_version_check = false
+local use_page_hashes = false
+local reclaim_pristine_pages = false
+local soft_dirty_tracking = false
+local huge_pages = false
+local compress_images = false
+local copy_images = false
 local htif_no_console_putchar = false
 local htif_console_getchar = false
 local htif_yield_automatic = true
@@ -603,6 +677,8 @@ local log_uarch_step = false
 local auto_uarch_reset = false
 local log_uarch_reset = false
 local store_dir
+local store_base_dir
+local store_file = false
 local load_dir
 local cmdline_opts_finished = false
 local store_config = false
@@ -1128,10 +1204,19 @@ local options = {
             if not opts then return false end
             local c = util.parse_options(opts, {
                 update_merkle_tree = true,
+                background_merkle_tree_interval = true,
+                images = true,
             })
             c.update_merkle_tree =
-                assert(util.parse_number(c.update_merkle_tree), "invalid update_merkle_tree number in " .. all)
+                assert(util.parse_number(c.update_merkle_tree or "0"), "invalid update_merkle_tree number in " .. all)
+            c.background_merkle_tree_interval = assert(
+                util.parse_number(c.background_merkle_tree_interval or "0"),
+                "invalid background_merkle_tree_interval number in " .. all
+            )
+            c.images = assert(util.parse_number(c.images or "0"), "invalid images number in " .. all)
             concurrency_update_merkle_tree = c.update_merkle_tree
+            concurrency_background_merkle_tree_interval = c.background_merkle_tree_interval
+            concurrency_images = c.images
             return true
         end,
     },
@@ -1159,6 +1244,54 @@ local options = {
             return true
         end,
     },
+    {
+        "^%-%-use%-page%-hashes$",
+        function(all)
+            if not all then return false end
+            use_page_hashes = true
+            return true
+        end,
+    },
+    {
+        "^%-%-reclaim%-pristine%-pages$",
+        function(all)
+            if not all then return false end
+            reclaim_pristine_pages = true
+            return true
+        end,
+    },
+    {
+        "^%-%-soft%-dirty%-tracking$",
+        function(all)
+            if not all then return false end
+            soft_dirty_tracking = true
+            return true
+        end,
+    },
+    {
+        "^%-%-huge%-pages$",
+        function(all)
+            if not all then return false end
+            huge_pages = true
+            return true
+        end,
+    },
+    {
+        "^%-%-compress%-images$",
+        function(all)
+            if not all then return false end
+            compress_images = true
+            return true
+        end,
+    },
+    {
+        "^%-%-copy%-images$",
+        function(all)
+            if not all then return false end
+            copy_images = true
+            return true
+        end,
+    },
     {
         "^%-%-skip%-version%-check$",
         function(all)
@@ -1295,6 +1428,22 @@ local options = {
             return true
         end,
     },
+    {
+        "^%-%-store%-base%=(.*)$",
+        function(o)
+            if not o or #o < 1 then return false end
+            store_base_dir = o
+            return true
+        end,
+    },
+    {
+        "^%-%-store%-file$",
+        function(all)
+            if not all then return false end
+            store_file = true
+            return true
+        end,
+    },
     {
         "^%-%-remote%-address%=(.*)$",
         function(o)
@@ -1752,8 +1901,13 @@ local function dump_value_proofs(machine, desired_proofs, config)
     if #desired_proofs > 0 then
         assert(config.processor.iunrep == 0, "proofs are meaningless in unreproducible mode")
     end
-    for _, desired in ipairs(desired_proofs) do
-        local proof = machine:get_proof(desired.address, desired.log2_size)
+    local addresses, log2_sizes = {}, {}
+    for i, desired in ipairs(desired_proofs) do
+        addresses[i], log2_sizes[i] = desired.address, desired.log2_size
+    end
+    local proofs = #desired_proofs > 0 and machine:get_proofs(addresses, log2_sizes) or {}
+    for i, desired in ipairs(desired_proofs) do
+        local proof = proofs[i]
         local out = desired.filename and assert(io.open(desired.filename, "wb")) or io.stdout
         out:write("{\n")
         util.dump_json_proof(proof, out, 1)
@@ -1788,6 +1942,8 @@ end
 local runtime = {
     concurrency = {
         update_merkle_tree = concurrency_update_merkle_tree,
+        background_merkle_tree_interval = concurrency_background_merkle_tree_interval,
+        images = concurrency_images,
     },
     htif = {
         no_console_putchar = htif_no_console_putchar,
@@ -1795,6 +1951,12 @@ local runtime = {
     skip_root_hash_check = skip_root_hash_check,
     skip_root_hash_store = skip_root_hash_store,
     skip_version_check = skip_version_check,
+    use_page_hashes = use_page_hashes,
+    reclaim_pristine_pages = reclaim_pristine_pages,
+    soft_dirty_tracking = soft_dirty_tracking,
+    huge_pages = huge_pages,
+    compress_images = compress_images,
+    copy_images = copy_images,
 }
 
 local main_machine
@@ -2081,7 +2243,12 @@ local function store_machine(machine, config, dir)
     local values = {}
     if dir:find("%%h") then values.h = util.hexhash(machine:get_root_hash()) end
     local name = instantiate_filename(dir, values)
-    machine:store(name)
+    if store_file then
+        assert(not store_base_dir, "--store-file cannot be combined with --store-base")
+        machine:store_file(name)
+    else
+        machine:store(name, store_base_dir)
+    end
 end
 
 local function dump_pmas(machine)
@@ -2109,7 +2276,10 @@ if config.processor.iunrep ~= 0 then stderr("Running in unreproducible mode!\n")
 if store_config == stderr then store_machine_config(config, stderr) end
 if cmio_advance or cmio_inspect then
     check_cmio_htif_config(config.htif)
-    assert(remote_address or not perform_rollbacks, "cmio requires --remote-address for snapshot/commit/rollback")
+    assert(
+        remote_address or not perform_rollbacks or #(config.virtio or {}) == 0,
+        "cmio with VirtIO devices requires --remote-address for snapshot/commit/rollback"
+    )
 end
 if initial_hash then
     assert(config.processor.iunrep == 0, "hashes are meaningless in unreproducible mode")
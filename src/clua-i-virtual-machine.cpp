@@ -17,6 +17,7 @@
 #include "clua-i-virtual-machine.h"
 
 #include <cinttypes>
+#include <vector>
 
 #include "clua-machine-util.h"
 #include "clua.h"
@@ -45,6 +46,45 @@ static int machine_obj_index_get_proof(lua_State *L) {
     return 1;
 }
 
+/// \brief This is the machine:get_proofs() method implementation.
+/// \param L Lua state.
+static int machine_obj_index_get_proofs(lua_State *L) {
+    lua_settop(L, 3);
+    auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    luaL_checktype(L, 3, LUA_TTABLE);
+    const auto count = static_cast<size_t>(luaL_len(L, 2));
+    if (static_cast<size_t>(luaL_len(L, 3)) != count) {
+        return luaL_argerror(L, 3, "expected as many log2 sizes as addresses");
+    }
+    std::vector<uint64_t> addresses(count);
+    std::vector<int> log2_sizes(count);
+    for (size_t i = 0; i < count; ++i) {
+        lua_geti(L, 2, static_cast<lua_Integer>(i + 1));
+        addresses[i] = luaL_checkinteger(L, -1);
+        lua_geti(L, 3, static_cast<lua_Integer>(i + 1));
+        log2_sizes[i] = static_cast<int>(luaL_checkinteger(L, -1));
+        lua_pop(L, 2);
+    }
+    std::vector<cm_merkle_tree_proof *> proofs(count);
+    TRY_EXECUTE(cm_get_proofs(m.get(), addresses.data(), log2_sizes.data(), count, proofs.data(), err_msg));
+    // Hand all proofs to managed pointers before anything else can fail
+    luaL_checkstack(L, static_cast<int>(count) + 3, nullptr);
+    for (auto *&proof : proofs) {
+        clua_push_to(L, clua_managed_cm_ptr<cm_merkle_tree_proof>(proof));
+        proof = nullptr;
+    }
+    lua_createtable(L, static_cast<int>(count), 0); // managed... proofs
+    for (size_t i = 0; i < count; ++i) {
+        const int managed_idx = 4 + static_cast<int>(i);
+        auto &managed_proof = clua_check<clua_managed_cm_ptr<cm_merkle_tree_proof>>(L, managed_idx);
+        clua_push_cm_proof(L, managed_proof.get()); // managed... proofs proof
+        managed_proof.reset();
+        lua_seti(L, -2, static_cast<lua_Integer>(i + 1)); // managed... proofs
+    }
+    return 1;
+}
+
 static int machine_obj_index_get_initial_config(lua_State *L) {
     auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
     auto &managed_config = clua_push_to(L, clua_managed_cm_ptr<const cm_machine_config>(nullptr));
@@ -406,10 +446,54 @@ static int machine_obj_index_log_uarch_step(lua_State *L) {
 /// \param L Lua state.
 static int machine_obj_index_store(lua_State *L) {
     auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
-    TRY_EXECUTE(cm_store(m.get(), luaL_checkstring(L, 2), err_msg));
+    const char *dir = luaL_checkstring(L, 2);
+    const char *base_dir = luaL_optstring(L, 3, nullptr);
+    if (base_dir != nullptr) {
+        TRY_EXECUTE(cm_store_delta(m.get(), dir, base_dir, err_msg));
+    } else {
+        TRY_EXECUTE(cm_store(m.get(), dir, err_msg));
+    }
+    return 0;
+}
+
+/// \brief This is the machine:store_file() method implementation.
+/// \param L Lua state.
+static int machine_obj_index_store_file(lua_State *L) {
+    auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
+    TRY_EXECUTE(cm_store_file(m.get(), luaL_checkstring(L, 2), err_msg));
     return 0;
 }
 
+/// \brief This is the machine:clone() method implementation.
+/// \param L Lua state.
+static int machine_obj_index_clone(lua_State *L) {
+    auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
+    auto &managed_machine = clua_push_to(L, clua_managed_cm_ptr<cm_machine>(nullptr));
+    TRY_EXECUTE(cm_clone_machine(m.get(), &managed_machine.get(), err_msg));
+    return 1;
+}
+
+/// \brief This is the machine:store_async() method implementation.
+/// \param L Lua state.
+static int machine_obj_index_store_async(lua_State *L) {
+    auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
+    const char *dir = luaL_checkstring(L, 2);
+    const char *base_dir = luaL_optstring(L, 3, nullptr);
+    TRY_EXECUTE(cm_store_async(m.get(), dir, base_dir, err_msg));
+    return 0;
+}
+
+/// \brief This is the machine:wait_store() method implementation.
+/// \param L Lua state.
+static int machine_obj_index_wait_store(lua_State *L) {
+    auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
+    const bool wait = lua_isnoneornil(L, 2) || lua_toboolean(L, 2) != 0;
+    bool done{};
+    TRY_EXECUTE(cm_wait_store(m.get(), wait, &done, err_msg));
+    lua_pushboolean(L, done);
+    return 1;
+}
+
 /// \brief This is the machine:verify_dirty_page_maps() method implementation.
 /// \param L Lua state.
 static int machine_obj_index_verify_dirty_page_maps(lua_State *L) {
@@ -513,8 +597,9 @@ static int machine_obj_index_translate_virtual_address(lua_State *L) {
 /// \brief Replaces a memory range.
 /// \param L Lua state.
 static int machine_obj_index_replace_memory_range(lua_State *L) {
-    lua_settop(L, 2);
+    lua_settop(L, 3);
     auto &m = clua_check<clua_managed_cm_ptr<cm_machine>>(L, 1);
+    const char *page_hashes_filename = luaL_optstring(L, 3, nullptr);
     cm_memory_range_config *memory_range_config{};
     try {
         memory_range_config = new cm_memory_range_config{};
@@ -524,7 +609,12 @@ static int machine_obj_index_replace_memory_range(lua_State *L) {
     auto &managed_memory_range_config =
         clua_push_to(L, clua_managed_cm_ptr<cm_memory_range_config>(memory_range_config));
     clua_check_cm_memory_range_config(L, 2, "replace", managed_memory_range_config.get());
-    TRY_EXECUTE(cm_replace_memory_range(m.get(), managed_memory_range_config.get(), err_msg));
+    if (page_hashes_filename != nullptr) {
+        TRY_EXECUTE(cm_replace_memory_range_with_page_hashes(m.get(), managed_memory_range_config.get(),
+            page_hashes_filename, err_msg));
+    } else {
+        TRY_EXECUTE(cm_replace_memory_range(m.get(), managed_memory_range_config.get(), err_msg));
+    }
     managed_memory_range_config.reset();
     return 0;
 }
@@ -593,6 +683,7 @@ static int machine_obj_index_log_send_cmio_response(lua_State *L) {
 /// \brief Contents of the machine object metatable __index table.
 static const auto machine_obj_index = cartesi::clua_make_luaL_Reg_array({
     {"get_proof", machine_obj_index_get_proof},
+    {"get_proofs", machine_obj_index_get_proofs},
     {"get_initial_config", machine_obj_index_get_initial_config},
     {"get_root_hash", machine_obj_index_get_root_hash},
     {"read_clint_mtimecmp", machine_obj_index_read_clint_mtimecmp},
@@ -658,6 +749,10 @@ static const auto machine_obj_index = cartesi::clua_make_luaL_Reg_array({
     {"run_uarch", machine_obj_index_run_uarch},
     {"log_uarch_step", machine_obj_index_log_uarch_step},
     {"store", machine_obj_index_store},
+    {"store_file", machine_obj_index_store_file},
+    {"clone", machine_obj_index_clone},
+    {"store_async", machine_obj_index_store_async},
+    {"wait_store", machine_obj_index_wait_store},
     {"verify_dirty_page_maps", machine_obj_index_verify_dirty_page_maps},
     {"verify_merkle_tree", machine_obj_index_verify_merkle_tree},
     {"write_clint_mtimecmp", machine_obj_index_write_clint_mtimecmp},
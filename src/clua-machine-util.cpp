@@ -1056,6 +1056,8 @@ void clua_push_cm_machine_config(lua_State *L, const cm_machine_config *c) {
 static void push_cm_concurrency_runtime_config(lua_State *L, const cm_concurrency_runtime_config *c) {
     lua_newtable(L);
     clua_setintegerfield(L, c->update_merkle_tree, "update_merkle_tree", -1);
+    clua_setintegerfield(L, c->background_merkle_tree_interval, "background_merkle_tree_interval", -1);
+    clua_setintegerfield(L, c->images, "images", -1);
 }
 
 void clua_push_cm_machine_runtime_config(lua_State *L, const cm_machine_runtime_config *r) {
@@ -1471,6 +1473,8 @@ static void check_cm_concurrency_runtime_config(lua_State *L, int tabidx, cm_con
         return;
     }
     c->update_merkle_tree = opt_uint_field(L, -1, "update_merkle_tree");
+    c->background_merkle_tree_interval = opt_uint_field(L, -1, "background_merkle_tree_interval");
+    c->images = opt_uint_field(L, -1, "images");
     lua_pop(L, 1);
 }
 
@@ -1497,6 +1501,12 @@ cm_machine_runtime_config *clua_check_cm_machine_runtime_config(lua_State *L, in
     config->skip_root_hash_store = opt_boolean_field(L, tabidx, "skip_root_hash_store");
     config->skip_version_check = opt_boolean_field(L, tabidx, "skip_version_check");
     config->soft_yield = opt_boolean_field(L, tabidx, "soft_yield");
+    config->use_page_hashes = opt_boolean_field(L, tabidx, "use_page_hashes");
+    config->reclaim_pristine_pages = opt_boolean_field(L, tabidx, "reclaim_pristine_pages");
+    config->soft_dirty_tracking = opt_boolean_field(L, tabidx, "soft_dirty_tracking");
+    config->huge_pages = opt_boolean_field(L, tabidx, "huge_pages");
+    config->compress_images = opt_boolean_field(L, tabidx, "compress_images");
+    config->copy_images = opt_boolean_field(L, tabidx, "copy_images");
     managed.release();
     lua_pop(L, 1);
     return config;
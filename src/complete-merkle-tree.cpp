@@ -16,6 +16,7 @@
 
 #include "complete-merkle-tree.h"
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
 #include <utility>
@@ -67,6 +68,26 @@ void complete_merkle_tree::push_back(const hash_type &hash) {
     bubble_up();
 }
 
+void complete_merkle_tree::set_leaf(address_type index, const hash_type &hash) {
+    auto &leaves = get_level(get_log2_leaf_size());
+    if (index >= leaves.size()) {
+        throw std::out_of_range{"leaf index is out of bounds"};
+    }
+    leaves[index] = hash;
+    m_dirty_leaves.push_back(index);
+}
+
+void complete_merkle_tree::set_leaves(address_type index, const level_type &hashes) {
+    auto &leaves = get_level(get_log2_leaf_size());
+    if (index > leaves.size() || hashes.size() > leaves.size() - index) {
+        throw std::out_of_range{"leaf index is out of bounds"};
+    }
+    std::copy(hashes.begin(), hashes.end(), leaves.begin() + static_cast<level_type::difference_type>(index));
+    for (address_type i = 0; i < hashes.size(); ++i) {
+        m_dirty_leaves.push_back(index + i);
+    }
+}
+
 void complete_merkle_tree::check_log2_sizes(int log2_root_size, int log2_leaf_size, int log2_word_size) {
     if (log2_root_size < 0) {
         throw std::out_of_range{"log2_root_size is negative"};
@@ -89,6 +110,7 @@ void complete_merkle_tree::check_log2_sizes(int log2_root_size, int log2_leaf_si
 }
 
 const complete_merkle_tree::hash_type &complete_merkle_tree::get_node_hash(address_type address, int log2_size) const {
+    update();
     const auto &level = get_level(log2_size);
     address >>= log2_size;
     if (address >= (address_type{1} << (get_log2_root_size() - log2_size))) {
@@ -128,6 +150,36 @@ void complete_merkle_tree::bubble_up(void) {
     }
 }
 
+void complete_merkle_tree::update(void) const {
+    if (m_dirty_leaves.empty()) {
+        return;
+    }
+    hasher_type h;
+    // Go bottom up, recomputing only parents of dirty nodes, each of them once
+    auto &dirty = m_dirty_leaves;
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    for (int log2_next_size = get_log2_leaf_size() + 1; log2_next_size <= get_log2_root_size(); ++log2_next_size) {
+        auto log2_prev_size = log2_next_size - 1;
+        const auto &prev = get_level(log2_prev_size);
+        auto &next = m_tree[m_log2_root_size - log2_next_size];
+        // Dirty nodes are sorted, so siblings are adjacent
+        auto last = dirty.begin();
+        for (auto index : dirty) {
+            index >>= 1;
+            if (last != dirty.begin() && *(last - 1) == index) {
+                continue;
+            }
+            const auto left = 2 * index;
+            const auto &right_hash = left + 1 < prev.size() ? prev[left + 1] : m_pristine.get_hash(log2_prev_size);
+            get_concat_hash(h, prev[left], right_hash, next[index]);
+            *last++ = index;
+        }
+        dirty.erase(last, dirty.end());
+    }
+    dirty.clear();
+}
+
 const complete_merkle_tree::level_type &complete_merkle_tree::get_level(int log2_size) const {
     if (log2_size < get_log2_leaf_size() || log2_size > get_log2_root_size()) {
         throw std::out_of_range{"log2_size is out of bounds"};
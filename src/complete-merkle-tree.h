@@ -88,6 +88,20 @@ public:
     /// \param hash Hash to append
     void push_back(const hash_type &hash);
 
+    /// \brief Replaces the hash of an existing leaf
+    /// \param index Index of leaf
+    /// \param hash New leaf hash
+    /// \details Only the leaf is changed. Hashes of nodes above it are
+    /// recomputed the next time any node hash is needed.
+    void set_leaf(address_type index, const hash_type &hash);
+
+    /// \brief Replaces the hashes of a run of existing leaves
+    /// \param index Index of first leaf
+    /// \param hashes New leaf hashes
+    /// \details Nodes shared by the paths of several leaves are only
+    /// recomputed once.
+    void set_leaves(address_type index, const level_type &hashes);
+
     /// \brief Returns number of leaves in tree
     address_type size(void) const {
         return get_level(get_log2_leaf_size()).size();
@@ -115,6 +129,9 @@ private:
     /// to the leaf level
     void bubble_up(void);
 
+    /// \brief Update hashes of nodes above leaves changed by set_leaf()
+    void update(void) const;
+
     ///< \brief Returns hashes at a given level
     ///< \param log2_size Log<sub>2</sub> of size subintended by each
     /// hash at level
@@ -125,10 +142,11 @@ private:
     /// hash at level
     level_type &get_level(int log2_size);
 
-    int m_log2_root_size;            ///< Log<sub>2</sub> of tree size
-    int m_log2_leaf_size;            ///< Log<sub>2</sub> of page size
-    pristine_merkle_tree m_pristine; ///< Pristine hashes for all levels
-    std::vector<level_type> m_tree;  ///< Merkle tree
+    int m_log2_root_size;                             ///< Log<sub>2</sub> of tree size
+    int m_log2_leaf_size;                             ///< Log<sub>2</sub> of page size
+    pristine_merkle_tree m_pristine;                  ///< Pristine hashes for all levels
+    mutable std::vector<level_type> m_tree;           ///< Merkle tree
+    mutable std::vector<address_type> m_dirty_leaves; ///< Leaves changed since last update
 };
 
 } // namespace cartesi
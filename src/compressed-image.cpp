@@ -0,0 +1,187 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "compressed-image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include <zlib.h>
+
+#include "is-pristine.h"
+#include "os.h"
+#include "unique-c-ptr.h"
+
+namespace cartesi {
+
+void store_compressed_image(const std::string &filename, const unsigned char *data, uint64_t length,
+    uint64_t concurrency) {
+    concurrency = std::max(concurrency, UINT64_C(1));
+    const uint64_t chunk_count = (length + COMPRESSED_IMAGE_CHUNK_SIZE - 1) / COMPRESSED_IMAGE_CHUNK_SIZE;
+    compressed_image_header header{};
+    header.magic = COMPRESSED_IMAGE_MAGIC;
+    header.version = COMPRESSED_IMAGE_VERSION;
+    header.length = length;
+    header.chunk_size = COMPRESSED_IMAGE_CHUNK_SIZE;
+    header.chunk_count = chunk_count;
+    std::vector<compressed_image_chunk> table(chunk_count);
+    auto fp = unique_fopen(filename.c_str(), "wb");
+    const auto write_at = [&](uint64_t offset, const void *buffer, uint64_t buffer_length) {
+        if (fseek(fp.get(), static_cast<long>(offset), SEEK_SET) != 0 ||
+            fwrite(buffer, 1, buffer_length, fp.get()) != buffer_length) {
+            throw std::system_error{errno, std::generic_category(), "error writing to '" + filename + "'"};
+        }
+    };
+    uint64_t offset = sizeof(header) + chunk_count * sizeof(compressed_image_chunk);
+    // Chunks are compressed a batch at a time, and then written in order
+    const uint64_t batch_size = concurrency * COMPRESSED_IMAGE_CHUNKS_PER_TASK;
+    std::vector<std::vector<unsigned char>> buffers(std::min(batch_size, chunk_count));
+    for (uint64_t first = 0; first < chunk_count; first += batch_size) {
+        const uint64_t count = std::min(batch_size, chunk_count - first);
+        os_parallel_for(concurrency, [&](uint64_t j, const parallel_for_mutex &) -> bool {
+            for (uint64_t k = j; k < count; k += concurrency) {
+                const uint64_t chunk_start = (first + k) * COMPRESSED_IMAGE_CHUNK_SIZE;
+                const uint64_t chunk_length = std::min<uint64_t>(COMPRESSED_IMAGE_CHUNK_SIZE, length - chunk_start);
+                auto &entry = table[first + k];
+                if (is_pristine(data + chunk_start, chunk_length)) {
+                    entry.encoding = compressed_image_encoding::pristine;
+                    continue;
+                }
+                auto &buffer = buffers[k];
+                uLongf compressed_length = compressBound(chunk_length);
+                buffer.resize(compressed_length);
+                // Snapshots are dominated by repetitive pages, which compress well even at the fastest level
+                if (compress2(buffer.data(), &compressed_length, data + chunk_start, chunk_length, Z_BEST_SPEED) ==
+                        Z_OK &&
+                    compressed_length < chunk_length) {
+                    entry.encoding = compressed_image_encoding::deflate;
+                    entry.length = compressed_length;
+                } else {
+                    entry.encoding = compressed_image_encoding::raw;
+                    entry.length = chunk_length;
+                    entry.crc32 = crc32_z(crc32_z(0, nullptr, 0), data + chunk_start, chunk_length);
+                }
+            }
+            return true;
+        });
+        for (uint64_t k = 0; k < count; ++k) {
+            auto &entry = table[first + k];
+            if (entry.encoding == compressed_image_encoding::pristine) {
+                continue;
+            }
+            entry.offset = offset;
+            const unsigned char *chunk = entry.encoding == compressed_image_encoding::deflate ?
+                buffers[k].data() :
+                data + (first + k) * COMPRESSED_IMAGE_CHUNK_SIZE;
+            write_at(entry.offset, chunk, entry.length);
+            offset += entry.length;
+        }
+    }
+    write_at(0, &header, sizeof(header));
+    write_at(sizeof(header), table.data(), table.size() * sizeof(compressed_image_chunk));
+}
+
+void load_compressed_image(const std::string &filename, unsigned char *data, uint64_t length, uint64_t concurrency,
+    const std::function<void(uint64_t offset, uint64_t length)> &pristine) {
+    concurrency = std::max(concurrency, UINT64_C(1));
+    auto fp = unique_fopen(filename.c_str(), "rb");
+    const auto read_at = [&](uint64_t offset, void *buffer, uint64_t buffer_length) {
+        if (fseek(fp.get(), static_cast<long>(offset), SEEK_SET) != 0 ||
+            fread(buffer, 1, buffer_length, fp.get()) != buffer_length) {
+            throw std::runtime_error{"error reading from '" + filename + "'"};
+        }
+    };
+    compressed_image_header header{};
+    read_at(0, &header, sizeof(header));
+    if (header.magic != COMPRESSED_IMAGE_MAGIC) {
+        throw std::runtime_error{"'" + filename + "' is not a compressed image"};
+    }
+    if (header.version != COMPRESSED_IMAGE_VERSION) {
+        throw std::runtime_error{"expected compressed image version " + std::to_string(COMPRESSED_IMAGE_VERSION) +
+            " (got " + std::to_string(header.version) + ") in '" + filename + "'"};
+    }
+    if (header.length != length || header.chunk_size == 0 ||
+        header.chunk_count != (length + header.chunk_size - 1) / header.chunk_size) {
+        throw std::runtime_error{"compressed image '" + filename + "' does not match memory range"};
+    }
+    // Check the header against the file before trusting it with an allocation
+    const uint64_t file_length = std::filesystem::file_size(filename);
+    if (header.chunk_count > (file_length - sizeof(header)) / sizeof(compressed_image_chunk)) {
+        throw std::runtime_error{"corrupt chunk table in '" + filename + "'"};
+    }
+    std::vector<compressed_image_chunk> table(header.chunk_count);
+    read_at(sizeof(header), table.data(), table.size() * sizeof(compressed_image_chunk));
+    for (uint64_t i = 0; i < header.chunk_count; ++i) {
+        const auto &entry = table[i];
+        const uint64_t chunk_start = i * header.chunk_size;
+        const uint64_t chunk_length = std::min(header.chunk_size, length - chunk_start);
+        const bool valid = (entry.encoding == compressed_image_encoding::pristine) ||
+            (entry.encoding == compressed_image_encoding::raw && entry.length == chunk_length) ||
+            (entry.encoding == compressed_image_encoding::deflate && entry.length <= compressBound(chunk_length));
+        if (!valid) {
+            throw std::runtime_error{"corrupt chunk table in '" + filename + "'"};
+        }
+        if (entry.encoding == compressed_image_encoding::pristine) {
+            pristine(chunk_start, chunk_length);
+        }
+    }
+    // Each task reads its chunks with positioned reads, so reading overlaps with decompressing.
+    // Each chunk carries a checksum, so corrupt chunks are caught here.
+    std::atomic<uint64_t> next_chunk{0};
+    std::atomic<bool> read_error{false};
+    const bool succeeded = os_parallel_for(concurrency, [&](uint64_t, const parallel_for_mutex &) -> bool {
+        std::vector<unsigned char> buffer;
+        for (uint64_t i = next_chunk++; i < header.chunk_count; i = next_chunk++) {
+            const auto &entry = table[i];
+            const uint64_t chunk_start = i * header.chunk_size;
+            const uint64_t chunk_length = std::min(header.chunk_size, length - chunk_start);
+            if (entry.encoding == compressed_image_encoding::raw) {
+                if (!os_read_at(fp.get(), data + chunk_start, chunk_length, entry.offset)) {
+                    read_error = true;
+                    return false;
+                }
+                if (crc32_z(crc32_z(0, nullptr, 0), data + chunk_start, chunk_length) != entry.crc32) {
+                    return false;
+                }
+            } else if (entry.encoding == compressed_image_encoding::deflate) {
+                buffer.resize(entry.length);
+                if (!os_read_at(fp.get(), buffer.data(), entry.length, entry.offset)) {
+                    read_error = true;
+                    return false;
+                }
+                uLongf decompressed_length = chunk_length;
+                if (uncompress(data + chunk_start, &decompressed_length, buffer.data(), entry.length) != Z_OK ||
+                    decompressed_length != chunk_length) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    });
+    if (read_error) {
+        throw std::runtime_error{"error reading from '" + filename + "'"};
+    }
+    if (!succeeded) {
+        throw std::runtime_error{"corrupt chunk in '" + filename + "'"};
+    }
+}
+
+} // namespace cartesi
@@ -0,0 +1,89 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef COMPRESSED_IMAGE_H
+#define COMPRESSED_IMAGE_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace cartesi {
+
+/// \file
+/// \brief Compressed images of memory ranges.
+/// \details The image starts with a header, followed by a table with one entry per chunk, and then
+/// the data of each chunk. Chunks are compressed independently with deflate, so they can be
+/// located through the table and compressed or decompressed in parallel. Chunks that hold only
+/// zeros have no data, and chunks that do not shrink are stored raw. Deflate data carries its own
+/// Adler-32 checksum, and raw chunks carry a CRC-32 in the table.
+/// All integers are in host byte order.
+
+/// \brief Compressed image constants.
+enum COMPRESSED_IMAGE_constants : uint64_t {
+    COMPRESSED_IMAGE_VERSION = 2,                    ///< Version of the layout
+    COMPRESSED_IMAGE_CHUNK_SIZE = UINT64_C(1) << 18, ///< Size of chunks before compression
+    COMPRESSED_IMAGE_CHUNKS_PER_TASK = 8,            ///< Chunks each thread compresses between writes
+};
+
+/// \brief Encodings of chunks in compressed images
+enum class compressed_image_encoding : uint64_t {
+    pristine = 0, ///< Chunk holds only zeros, and has no data
+    raw = 1,      ///< Chunk data is stored as is
+    deflate = 2,  ///< Chunk data is compressed with deflate, in the zlib format
+};
+
+/// \brief Magic bytes identifying compressed images
+static constexpr std::array<char, 8> COMPRESSED_IMAGE_MAGIC = {'C', 'M', 'I', 'M', 'A', 'G', 'E', 'Z'};
+
+/// \brief Header at the start of compressed images
+struct compressed_image_header {
+    std::array<char, 8> magic; ///< COMPRESSED_IMAGE_MAGIC
+    uint64_t version;          ///< COMPRESSED_IMAGE_VERSION
+    uint64_t length;           ///< Length of memory range
+    uint64_t chunk_size;       ///< Size of chunks before compression
+    uint64_t chunk_count;      ///< Number of entries in the chunk table that follows the header
+};
+
+/// \brief Entry in the chunk table of compressed images
+struct compressed_image_chunk {
+    uint64_t offset;                    ///< Offset of chunk data in the image
+    uint64_t length;                    ///< Length of chunk data in the image
+    compressed_image_encoding encoding; ///< Encoding of chunk data
+    uint64_t crc32;                     ///< CRC-32 of chunk data, if raw
+};
+
+/// \brief Stores a compressed image of a memory range
+/// \param filename Name of image file
+/// \param data Memory range contents
+/// \param length Length of memory range
+/// \param concurrency Number of threads compressing chunks
+void store_compressed_image(const std::string &filename, const unsigned char *data, uint64_t length,
+    uint64_t concurrency);
+
+/// \brief Loads a compressed image into a memory range
+/// \param filename Name of image file
+/// \param data Receives memory range contents. Must hold only zeros, since pristine chunks are not written.
+/// \param length Length of memory range, which must match the image
+/// \param concurrency Number of threads reading and decompressing chunks
+/// \param pristine Called with the offset and length of each chunk that holds only zeros
+void load_compressed_image(const std::string &filename, unsigned char *data, uint64_t length, uint64_t concurrency,
+    const std::function<void(uint64_t offset, uint64_t length)> &pristine);
+
+} // namespace cartesi
+
+#endif
@@ -16,8 +16,11 @@
 
 #include "full-merkle-tree.h"
 
+#include <algorithm>
 #include <limits>
 
+#include "os-parallel.h"
+
 /// \file
 /// \brief Full Merkle tree implementation.
 
@@ -29,11 +32,11 @@ full_merkle_tree::full_merkle_tree(int log2_root_size, int log2_leaf_size, int l
     m_max_leaves{address_type{1} << std::max(0, log2_root_size - log2_leaf_size)} {
     check_log2_sizes(log2_root_size, log2_leaf_size, log2_word_size);
     m_tree.resize(2 * m_max_leaves);
-    init_pristine_subtree(pristine_merkle_tree{log2_root_size, log2_word_size}, 1, log2_root_size);
+    init_pristine_tree(pristine_merkle_tree{log2_root_size, log2_word_size});
 }
 
 full_merkle_tree::full_merkle_tree(int log2_root_size, int log2_leaf_size, int log2_word_size,
-    const std::vector<hash_type> &leaves) :
+    const std::vector<hash_type> &leaves, uint64_t concurrency) :
     m_log2_root_size(log2_root_size),
     m_log2_leaf_size(log2_leaf_size),
     m_max_leaves{address_type{1} << std::max(0, log2_root_size - log2_leaf_size)} {
@@ -42,7 +45,9 @@ full_merkle_tree::full_merkle_tree(int log2_root_size, int log2_leaf_size, int l
         throw std::out_of_range{"too many leaves"};
     }
     m_tree.resize(2 * m_max_leaves);
-    init_tree(pristine_merkle_tree{log2_root_size, log2_word_size}, leaves);
+    init_pristine_tree(pristine_merkle_tree{log2_root_size, log2_word_size});
+    std::copy(leaves.begin(), leaves.end(), m_tree.begin() + static_cast<std::ptrdiff_t>(m_max_leaves));
+    update_levels(0, leaves.size(), concurrency);
 }
 
 full_merkle_tree::proof_type full_merkle_tree::get_proof(address_type address, int log2_size) const {
@@ -90,28 +95,46 @@ void full_merkle_tree::check_log2_sizes(int log2_root_size, int log2_leaf_size,
     }
 }
 
-void full_merkle_tree::init_pristine_subtree(const pristine_merkle_tree &pristine, int index, int log2_size) {
-    if (log2_size >= get_log2_leaf_size()) {
-        m_tree[index] = pristine.get_hash(log2_size);
-        init_pristine_subtree(pristine, left_child_index(index), log2_size - 1);
-        init_pristine_subtree(pristine, right_child_index(index), log2_size - 1);
+void full_merkle_tree::set_leaves(address_type index, const std::vector<hash_type> &leaves, uint64_t concurrency) {
+    if (index > m_max_leaves || leaves.size() > m_max_leaves - index) {
+        throw std::out_of_range{"too many leaves"};
     }
+    std::copy(leaves.begin(), leaves.end(), m_tree.begin() + static_cast<std::ptrdiff_t>(m_max_leaves + index));
+    update_levels(index, index + leaves.size(), concurrency);
 }
 
-void full_merkle_tree::init_subtree(hasher_type &h, int index, int log2_size) {
-    if (log2_size > get_log2_leaf_size()) {
-        init_subtree(h, left_child_index(index), log2_size - 1);
-        init_subtree(h, right_child_index(index), log2_size - 1);
-        get_concat_hash(h, m_tree[left_child_index(index)], m_tree[right_child_index(index)], m_tree[index]);
+void full_merkle_tree::init_pristine_tree(const pristine_merkle_tree &pristine) {
+    for (int log2_size = get_log2_leaf_size(); log2_size <= get_log2_root_size(); ++log2_size) {
+        const address_type base = address_type{1} << (get_log2_root_size() - log2_size);
+        std::fill_n(m_tree.begin() + static_cast<std::ptrdiff_t>(base), base, pristine.get_hash(log2_size));
     }
 }
 
-void full_merkle_tree::init_tree(const pristine_merkle_tree &pristine, const std::vector<hash_type> &leaves) {
-    std::copy(leaves.begin(), leaves.end(), &m_tree[m_max_leaves]);
-    std::fill_n(&m_tree[m_max_leaves + leaves.size()], m_max_leaves - leaves.size(),
-        pristine.get_hash(get_log2_leaf_size()));
-    hasher_type h;
-    init_subtree(h, 1, get_log2_root_size());
+void full_merkle_tree::update_levels(address_type first_leaf, address_type last_leaf, uint64_t concurrency) {
+    // Below this many nodes in a level, the cost of dispatching threads is not worth it
+    constexpr address_type min_nodes_per_thread = 1024;
+    const uint64_t n = concurrency > 0 ? concurrency : std::max(os_get_concurrency(), UINT64_C(1));
+    address_type first = first_leaf;
+    address_type last = last_leaf;
+    for (int log2_size = get_log2_leaf_size() + 1; log2_size <= get_log2_root_size() && first < last; ++log2_size) {
+        // Parents of nodes in [first, last) in the level below
+        first >>= 1;
+        last = (last + 1) >> 1;
+        const address_type base = address_type{1} << (get_log2_root_size() - log2_size);
+        const address_type count = last - first;
+        const uint64_t threads = std::clamp(count / min_nodes_per_thread, UINT64_C(1), n);
+        const address_type chunk = (count + threads - 1) / threads;
+        // Thread j is responsible for a contiguous chunk of nodes in the level
+        os_parallel_for(threads, [this, base, first, last, chunk](uint64_t j, const parallel_for_mutex &) -> bool {
+            hasher_type h;
+            const address_type begin = base + first + j * chunk;
+            const address_type end = base + std::min(last, first + (j + 1) * chunk);
+            for (address_type index = begin; index < end; ++index) {
+                get_concat_hash(h, m_tree[2 * index], m_tree[2 * index + 1], m_tree[index]);
+            }
+            return true;
+        });
+    }
 }
 
 full_merkle_tree::address_type full_merkle_tree::get_node_index(address_type address, int log2_size) const {
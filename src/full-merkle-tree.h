@@ -53,7 +53,10 @@ public:
     /// \param log2_leaf_size Log<sub>2</sub> of leaf node
     /// \param log2_word_size Log<sub>2</sub> of word
     /// \param leaves List of leaf hashes
-    full_merkle_tree(int log2_root_size, int log2_leaf_size, int log2_word_size, const std::vector<hash_type> &leaves);
+    /// \param concurrency Number of threads to use, or 0 to use all host threads
+    /// \details Subtrees holding only pristine leaves are not hashed.
+    full_merkle_tree(int log2_root_size, int log2_leaf_size, int log2_word_size, const std::vector<hash_type> &leaves,
+        uint64_t concurrency = 0);
 
     /// \brief Returns log<sub>2</sub> of size of tree
     int get_log2_root_size(void) const {
@@ -84,6 +87,13 @@ public:
     /// \returns Proof, or throws exception
     proof_type get_proof(address_type address, int log2_size) const;
 
+    /// \brief Replaces the hashes of a run of leaves
+    /// \param index Index of first leaf
+    /// \param leaves New leaf hashes
+    /// \param concurrency Number of threads to use, or 0 to use all host threads
+    /// \details Only nodes above the run of leaves are hashed again.
+    void set_leaves(address_type index, const std::vector<hash_type> &leaves, uint64_t concurrency = 0);
+
 private:
     /// \brief Throws exception if log<sub>2</sub> sizes are inconsistent
     ///  with one another
@@ -92,37 +102,16 @@ private:
     /// \param log2_word_size Log<sub>2</sub> of word
     static void check_log2_sizes(int log2_root_size, int log2_leaf_size, int log2_word_size);
 
-    /// \brief Returns the index of the left child of node at given index
-    static constexpr int left_child_index(int index) {
-        return 2 * index;
-    }
-
-    /// \brief Returns the index of the right child of node at given index
-    static constexpr int right_child_index(int index) {
-        return 2 * index + 1;
-    }
-
-    /// \brief Initialize all nodes for the pristine subtree with root
-    /// at a given index
+    /// \brief Initialize all nodes with pristine hashes
     /// \param pristine Hashes for pristine subtree nodes of all sizes
-    /// \param index Index of root for subtree to initialize
-    /// \param log2_size Log<sub>2</sub> size of root at index
-    void init_pristine_subtree(const pristine_merkle_tree &pristine, int index, int log2_size);
-
-    /// \brief Initialize all nodes for the subtree with root at a given index
-    /// \param h Hasher object
-    /// \param index Index of root for subtree to initialize
-    /// \param log2_size Log<sub>2</sub> size of root at index
-    /// \details The nodes corresponding to subtrees of size log2_leaf_size
-    /// are assumed to have already been set prior to calling this function
-    void init_subtree(hasher_type &h, int index, int log2_size);
-
-    /// \brief Initialize tree from a list of consecutive page hashes
-    /// \param leaves List of page hashes
-    /// \details The page hashes in leaves are copied to the appropriate
-    /// subtree nodes, in order, and the rest are filled with pristine
-    /// page hashes
-    void init_tree(const pristine_merkle_tree &pristine, const std::vector<hash_type> &leaves);
+    void init_pristine_tree(const pristine_merkle_tree &pristine);
+
+    /// \brief Updates the hashes of all nodes above a run of leaves
+    /// \param first_leaf Index of first leaf in run
+    /// \param last_leaf Index of one past last leaf in run
+    /// \param concurrency Number of threads to use, or 0 to use all host threads
+    /// \details Each level is split among threads, from the leaves up.
+    void update_levels(address_type first_leaf, address_type last_leaf, uint64_t concurrency);
 
     /// \brief Returns index of a node in the tree array
     /// \param address Node address
@@ -56,9 +56,37 @@ public:
         return do_run(mcycle_end);
     }
 
+    /// \brief Creates an independent copy of the machine
+    /// \returns Pointer to new machine, to be deleted by the caller
+    i_virtual_machine *clone(void) const {
+        return do_clone();
+    }
+
     /// \brief Serialize entire state to directory
-    void store(const std::string &dir) {
-        do_store(dir);
+    /// \param dir Directory to store machine into.
+    /// \param base_dir Optional directory holding a previously stored machine, to store only what differs from it.
+    void store(const std::string &dir, const std::string &base_dir = {}) {
+        do_store(dir, base_dir);
+    }
+
+    /// \brief Serialize entire state to a single machine file
+    /// \param filename Name of file to store machine into.
+    void store_file(const std::string &filename) {
+        do_store_file(filename);
+    }
+
+    /// \brief Starts serializing entire state to directory in the background
+    /// \param dir Directory to store machine into.
+    /// \param base_dir Optional directory holding a previously stored machine, to store only what differs from it.
+    void store_async(const std::string &dir, const std::string &base_dir = {}) {
+        do_store_async(dir, base_dir);
+    }
+
+    /// \brief Checks whether the store started by store_async() is done
+    /// \param wait True to block until it is.
+    /// \returns True if no store is in progress anymore.
+    bool wait_store(bool wait = true) {
+        return do_wait_store(wait);
     }
 
     /// \brief Runs the machine for one micro cycle logging all accesses to the state.
@@ -71,6 +99,12 @@ public:
         return do_get_proof(address, log2_size);
     }
 
+    /// \brief Obtains the proofs for several nodes in the Merkle tree.
+    std::vector<machine_merkle_tree::proof_type> get_proofs(const std::vector<uint64_t> &addresses,
+        const std::vector<int> &log2_sizes) const {
+        return do_get_proofs(addresses, log2_sizes);
+    }
+
     /// \brief Obtains the root hash of the Merkle tree.
     void get_root_hash(hash_type &hash) const {
         do_get_root_hash(hash);
@@ -137,8 +171,10 @@ public:
     }
 
     /// \brief Replaces a flash drive.
-    void replace_memory_range(const memory_range_config &new_range) {
-        do_replace_memory_range(new_range);
+    /// \param new_range Configuration of the new memory range.
+    /// \param page_hashes_filename Optional file with precomputed page hashes for the new range.
+    void replace_memory_range(const memory_range_config &new_range, const std::string &page_hashes_filename = {}) {
+        do_replace_memory_range(new_range, page_hashes_filename);
     }
 
     /// \brief Read the value of a word in the machine state.
@@ -698,9 +734,15 @@ public:
 
 private:
     virtual interpreter_break_reason do_run(uint64_t mcycle_end) = 0;
-    virtual void do_store(const std::string &dir) = 0;
+    virtual i_virtual_machine *do_clone(void) const = 0;
+    virtual void do_store(const std::string &dir, const std::string &base_dir) = 0;
+    virtual void do_store_file(const std::string &filename) = 0;
+    virtual void do_store_async(const std::string &dir, const std::string &base_dir) = 0;
+    virtual bool do_wait_store(bool wait) = 0;
     virtual access_log do_log_uarch_step(const access_log::type &log_type, bool one_based = false) = 0;
     virtual machine_merkle_tree::proof_type do_get_proof(uint64_t address, int log2_size) const = 0;
+    virtual std::vector<machine_merkle_tree::proof_type> do_get_proofs(const std::vector<uint64_t> &addresses,
+        const std::vector<int> &log2_sizes) const = 0;
     virtual void do_get_root_hash(hash_type &hash) const = 0;
     virtual bool do_verify_merkle_tree(void) const = 0;
     virtual uint64_t do_read_csr(csr r) const = 0;
@@ -801,7 +843,8 @@ private:
     virtual void do_write_plic_girqpend(uint64_t val) = 0;
     virtual uint64_t do_read_plic_girqsrvd(void) const = 0;
     virtual void do_write_plic_girqsrvd(uint64_t val) = 0;
-    virtual void do_replace_memory_range(const memory_range_config &new_range) = 0;
+    virtual void do_replace_memory_range(const memory_range_config &new_range,
+        const std::string &page_hashes_filename) = 0;
     virtual uint64_t do_read_word(uint64_t address) const = 0;
     virtual bool do_verify_dirty_page_maps(void) const = 0;
     virtual machine_config do_get_initial_config(void) const = 0;
@@ -0,0 +1,71 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef IS_PRISTINE_H
+#define IS_PRISTINE_H
+
+#include <cstdint>
+#include <cstring>
+
+/// \file
+/// \brief Detection of ranges filled with zeros
+
+namespace cartesi {
+
+/// \brief Checks if a range of memory is filled with zeros.
+/// \param data Start of range.
+/// \param length Length of range.
+/// \returns True if all bytes are zero, false otherwise.
+/// \details Each block is combined without branches, in vector registers when the compiler
+/// supports vector extensions, and the check stops at the first block that is not pristine.
+static inline bool is_pristine(const unsigned char *data, uint64_t length) {
+#ifdef __GNUC__
+    // 128-bit vectors map to native registers on common hosts (SSE2, NEON)
+    using word_type = uint64_t __attribute__((vector_size(16)));
+#else
+    using word_type = uint64_t;
+#endif
+    constexpr uint64_t block_words = 16;
+    constexpr uint64_t block_size = block_words * sizeof(word_type);
+    uint64_t offset = 0;
+    for (; offset + block_size <= length; offset += block_size) {
+        word_type acc{};
+        for (uint64_t i = 0; i < block_words; ++i) {
+            word_type word{};
+            memcpy(&word, data + offset + i * sizeof(word_type), sizeof(word_type));
+            acc |= word;
+        }
+        uint64_t lanes[sizeof(word_type) / sizeof(uint64_t)]{};
+        memcpy(lanes, &acc, sizeof(acc));
+        uint64_t any = 0;
+        for (auto lane : lanes) {
+            any |= lane;
+        }
+        if (any != 0) {
+            return false;
+        }
+    }
+    for (; offset < length; ++offset) {
+        if (data[offset] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace cartesi
+
+#endif
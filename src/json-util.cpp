@@ -433,6 +433,9 @@ void ju_get_opt_field(const nlohmann::json &j, const K &key, concurrency_runtime
         return;
     }
     ju_get_opt_field(j[key], "update_merkle_tree"s, value.update_merkle_tree, path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "background_merkle_tree_interval"s, value.background_merkle_tree_interval,
+        path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "images"s, value.images, path + to_string(key) + "/");
 }
 
 template void ju_get_opt_field<uint64_t>(const nlohmann::json &j, const uint64_t &key,
@@ -466,6 +469,12 @@ void ju_get_opt_field(const nlohmann::json &j, const K &key, machine_runtime_con
     ju_get_opt_field(j[key], "skip_root_hash_store"s, value.skip_root_hash_store, path + to_string(key) + "/");
     ju_get_opt_field(j[key], "skip_version_check"s, value.skip_version_check, path + to_string(key) + "/");
     ju_get_opt_field(j[key], "soft_yield"s, value.soft_yield, path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "use_page_hashes"s, value.use_page_hashes, path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "reclaim_pristine_pages"s, value.reclaim_pristine_pages, path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "soft_dirty_tracking"s, value.soft_dirty_tracking, path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "huge_pages"s, value.huge_pages, path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "compress_images"s, value.compress_images, path + to_string(key) + "/");
+    ju_get_opt_field(j[key], "copy_images"s, value.copy_images, path + to_string(key) + "/");
 }
 
 template void ju_get_opt_field<uint64_t>(const nlohmann::json &j, const uint64_t &key, machine_runtime_config &value,
@@ -568,6 +577,29 @@ template void ju_get_opt_field<uint64_t>(const nlohmann::json &j, const uint64_t
 template void ju_get_opt_field<std::string>(const nlohmann::json &j, const std::string &key,
     not_default_constructible<machine_merkle_tree::proof_type> &value, const std::string &path);
 
+template <typename K>
+void ju_get_opt_field(const nlohmann::json &j, const K &key, std::vector<machine_merkle_tree::proof_type> &value,
+    const std::string &path) {
+    ju_get_opt_vector_like_field(j, key, value, path);
+}
+
+template void ju_get_opt_field<uint64_t>(const nlohmann::json &j, const uint64_t &key,
+    std::vector<machine_merkle_tree::proof_type> &value, const std::string &path);
+
+template void ju_get_opt_field<std::string>(const nlohmann::json &j, const std::string &key,
+    std::vector<machine_merkle_tree::proof_type> &value, const std::string &path);
+
+template <typename K>
+void ju_get_opt_field(const nlohmann::json &j, const K &key, std::vector<uint64_t> &value, const std::string &path) {
+    ju_get_opt_vector_like_field(j, key, value, path);
+}
+
+template void ju_get_opt_field<uint64_t>(const nlohmann::json &j, const uint64_t &key, std::vector<uint64_t> &value,
+    const std::string &path);
+
+template void ju_get_opt_field<std::string>(const nlohmann::json &j, const std::string &key,
+    std::vector<uint64_t> &value, const std::string &path);
+
 template <typename K>
 void ju_get_opt_field(const nlohmann::json &j, const K &key, access_type &value, const std::string &path) {
     if (!contains(j, key)) {
@@ -1184,6 +1216,13 @@ void to_json(nlohmann::json &j, const machine_merkle_tree::proof_type &p) {
         {"root_hash", encode_base64(p.get_root_hash())}, {"sibling_hashes", s}};
 }
 
+void to_json(nlohmann::json &j, const std::vector<machine_merkle_tree::proof_type> &ps) {
+    j = nlohmann::json::array();
+    for (const auto &p : ps) {
+        j.push_back(p);
+    }
+}
+
 void to_json(nlohmann::json &j, const access &a) {
     j = nlohmann::json{
         {"type", access_type_name(a.get_type())},
@@ -1368,6 +1407,8 @@ void to_json(nlohmann::json &j, const machine_config &config) {
 void to_json(nlohmann::json &j, const concurrency_runtime_config &config) {
     j = nlohmann::json{
         {"update_merkle_tree", config.update_merkle_tree},
+        {"background_merkle_tree_interval", config.background_merkle_tree_interval},
+        {"images", config.images},
     };
 }
 
@@ -1385,6 +1426,12 @@ void to_json(nlohmann::json &j, const machine_runtime_config &runtime) {
         {"skip_root_hash_store", runtime.skip_root_hash_store},
         {"skip_version_check", runtime.skip_version_check},
         {"soft_yield", runtime.soft_yield},
+        {"use_page_hashes", runtime.use_page_hashes},
+        {"reclaim_pristine_pages", runtime.reclaim_pristine_pages},
+        {"soft_dirty_tracking", runtime.soft_dirty_tracking},
+        {"huge_pages", runtime.huge_pages},
+        {"compress_images", runtime.compress_images},
+        {"copy_images", runtime.copy_images},
     };
 }
 
@@ -204,6 +204,26 @@ template <typename K>
 void ju_get_opt_field(const nlohmann::json &j, const K &key,
     not_default_constructible<machine_merkle_tree::proof_type> &value, const std::string &path = "params/");
 
+/// \brief Attempts to load an array of Merkle tree proof objects from a field in a JSON object
+/// \tparam K Key type (explicit extern declarations for uint64_t and std::string are provided)
+/// \param j JSON object to load from
+/// \param key Key to load value from
+/// \param value Object to store value
+/// \param path Path to j
+template <typename K>
+void ju_get_opt_field(const nlohmann::json &j, const K &key, std::vector<machine_merkle_tree::proof_type> &value,
+    const std::string &path = "params/");
+
+/// \brief Attempts to load an array of unsigned integers from a field in a JSON object
+/// \tparam K Key type (explicit extern declarations for uint64_t and std::string are provided)
+/// \param j JSON object to load from
+/// \param key Key to load value from
+/// \param value Object to store value
+/// \param path Path to j
+template <typename K>
+void ju_get_opt_field(const nlohmann::json &j, const K &key, std::vector<uint64_t> &value,
+    const std::string &path = "params/");
+
 /// \brief Attempts to load an access_type name from a field in a JSON object
 /// \tparam K Key type (explicit extern declarations for uint64_t and std::string are provided)
 /// \param j JSON object to load from
@@ -569,6 +589,7 @@ void to_json(nlohmann::json &j, const access_log::type &log_type);
 void to_json(nlohmann::json &j, const machine_merkle_tree::hash_type &h);
 void to_json(nlohmann::json &j, const std::vector<machine_merkle_tree::hash_type> &hs);
 void to_json(nlohmann::json &j, const machine_merkle_tree::proof_type &p);
+void to_json(nlohmann::json &j, const std::vector<machine_merkle_tree::proof_type> &ps);
 void to_json(nlohmann::json &j, const access &a);
 void to_json(nlohmann::json &j, const bracket_note &b);
 void to_json(nlohmann::json &j, const std::vector<bracket_note> &bs);
@@ -647,6 +668,14 @@ extern template void ju_get_opt_field(const nlohmann::json &j, const uint64_t &k
     not_default_constructible<machine_merkle_tree::proof_type> &value, const std::string &base = "params/");
 extern template void ju_get_opt_field(const nlohmann::json &j, const std::string &key,
     not_default_constructible<machine_merkle_tree::proof_type> &value, const std::string &base = "params/");
+extern template void ju_get_opt_field(const nlohmann::json &j, const uint64_t &key,
+    std::vector<machine_merkle_tree::proof_type> &value, const std::string &base = "params/");
+extern template void ju_get_opt_field(const nlohmann::json &j, const std::string &key,
+    std::vector<machine_merkle_tree::proof_type> &value, const std::string &base = "params/");
+extern template void ju_get_opt_field(const nlohmann::json &j, const uint64_t &key, std::vector<uint64_t> &value,
+    const std::string &base = "params/");
+extern template void ju_get_opt_field(const nlohmann::json &j, const std::string &key, std::vector<uint64_t> &value,
+    const std::string &base = "params/");
 extern template void ju_get_opt_field(const nlohmann::json &j, const uint64_t &key, access_type &value,
     const std::string &base = "params/");
 extern template void ju_get_opt_field(const nlohmann::json &j, const std::string &key, access_type &value,
@@ -882,12 +882,73 @@ static json jsonrpc_machine_store_handler(const json &j, const std::shared_ptr<h
     if (!session->handler->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
-    static const char *param_name[] = {"directory"};
+    static const char *param_name[] = {"directory", "base_directory"};
+    auto args = parse_args<std::string, cartesi::optional_param<std::string>>(j, param_name);
+    switch (count_args(args)) {
+        case 1:
+            session->handler->machine->store(std::get<0>(args));
+            break;
+        case 2:
+            session->handler->machine->store(std::get<0>(args),
+                std::get<1>(args).value()); // NOLINT(bugprone-unchecked-optional-access)
+            break;
+        default:
+            throw std::runtime_error{"error detecting number of arguments"};
+    }
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief JSONRPC handler for the machine.store_file method
+/// \param j JSON request object
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_store_file_handler(const json &j, const std::shared_ptr<http_session> &session) {
+    if (!session->handler->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"filename"};
     auto args = parse_args<std::string>(j, param_name);
-    session->handler->machine->store(std::get<0>(args));
+    session->handler->machine->store_file(std::get<0>(args));
     return jsonrpc_response_ok(j);
 }
 
+/// \brief JSONRPC handler for the machine.store_async method
+/// \param j JSON request object
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_store_async_handler(const json &j, const std::shared_ptr<http_session> &session) {
+    if (!session->handler->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"directory", "base_directory"};
+    auto args = parse_args<std::string, cartesi::optional_param<std::string>>(j, param_name);
+    switch (count_args(args)) {
+        case 1:
+            session->handler->machine->store_async(std::get<0>(args));
+            break;
+        case 2:
+            session->handler->machine->store_async(std::get<0>(args),
+                std::get<1>(args).value()); // NOLINT(bugprone-unchecked-optional-access)
+            break;
+        default:
+            throw std::runtime_error{"error detecting number of arguments"};
+    }
+    return jsonrpc_response_ok(j);
+}
+
+/// \brief JSONRPC handler for the machine.wait_store method
+/// \param j JSON request object
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_wait_store_handler(const json &j, const std::shared_ptr<http_session> &session) {
+    if (!session->handler->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"wait"};
+    auto args = parse_args<bool>(j, param_name);
+    return jsonrpc_response_ok(j, session->handler->machine->wait_store(std::get<0>(args)));
+}
+
 /// \brief Translate an interpret_break_reason value to string
 /// \param reason interpret_break_reason value to translate
 /// \returns String representation of value
@@ -1158,6 +1219,27 @@ static json jsonrpc_machine_get_proof_handler(const json &j, const std::shared_p
         session->handler->machine->get_proof(std::get<0>(args), static_cast<int>(std::get<1>(args))));
 }
 
+/// \brief JSONRPC handler for the machine.get_proofs method
+/// \param j JSON request object
+/// \param session HTTP session
+/// \returns JSON response object
+static json jsonrpc_machine_get_proofs_handler(const json &j, const std::shared_ptr<http_session> &session) {
+    if (!session->handler->machine) {
+        return jsonrpc_response_invalid_request(j, "no machine");
+    }
+    static const char *param_name[] = {"addresses", "log2_sizes"};
+    auto args = parse_args<std::vector<uint64_t>, std::vector<uint64_t>>(j, param_name);
+    std::vector<int> log2_sizes;
+    log2_sizes.reserve(std::get<1>(args).size());
+    for (const auto log2_size : std::get<1>(args)) {
+        if (log2_size > INT_MAX) {
+            throw std::domain_error("log2_size is out of range");
+        }
+        log2_sizes.push_back(static_cast<int>(log2_size));
+    }
+    return jsonrpc_response_ok(j, session->handler->machine->get_proofs(std::get<0>(args), log2_sizes));
+}
+
 /// \brief JSONRPC handler for the machine.verify_merkle_tree method
 /// \param j JSON request object
 /// \param session HTTP session
@@ -1289,9 +1371,19 @@ static json jsonrpc_machine_replace_memory_range_handler(const json &j, const st
     if (!session->handler->machine) {
         return jsonrpc_response_invalid_request(j, "no machine");
     }
-    static const char *param_name[] = {"range"};
-    auto args = parse_args<cartesi::memory_range_config>(j, param_name);
-    session->handler->machine->replace_memory_range(std::get<0>(args));
+    static const char *param_name[] = {"range", "page_hashes_filename"};
+    auto args = parse_args<cartesi::memory_range_config, cartesi::optional_param<std::string>>(j, param_name);
+    switch (count_args(args)) {
+        case 1:
+            session->handler->machine->replace_memory_range(std::get<0>(args));
+            break;
+        case 2:
+            session->handler->machine->replace_memory_range(std::get<0>(args),
+                std::get<1>(args).value()); // NOLINT(bugprone-unchecked-optional-access)
+            break;
+        default:
+            throw std::runtime_error{"error detecting number of arguments"};
+    }
     return jsonrpc_response_ok(j);
 }
 
@@ -1860,6 +1952,9 @@ static json jsonrpc_dispatch_method(const json &j, const std::shared_ptr<http_se
         {"machine.machine.directory", jsonrpc_machine_machine_directory_handler},
         {"machine.destroy", jsonrpc_machine_destroy_handler},
         {"machine.store", jsonrpc_machine_store_handler},
+        {"machine.store_file", jsonrpc_machine_store_file_handler},
+        {"machine.store_async", jsonrpc_machine_store_async_handler},
+        {"machine.wait_store", jsonrpc_machine_wait_store_handler},
         {"machine.run", jsonrpc_machine_run_handler},
         {"machine.run_uarch", jsonrpc_machine_run_uarch_handler},
         {"machine.log_uarch_step", jsonrpc_machine_log_uarch_step_handler},
@@ -1870,6 +1965,7 @@ static json jsonrpc_dispatch_method(const json &j, const std::shared_ptr<http_se
         {"machine.verify_uarch_step_log", jsonrpc_machine_verify_uarch_step_log_handler},
         {"machine.verify_uarch_step_state_transition", jsonrpc_machine_verify_uarch_step_state_transition_handler},
         {"machine.get_proof", jsonrpc_machine_get_proof_handler},
+        {"machine.get_proofs", jsonrpc_machine_get_proofs_handler},
         {"machine.get_root_hash", jsonrpc_machine_get_root_hash_handler},
         {"machine.read_word", jsonrpc_machine_read_word_handler},
         {"machine.read_memory", jsonrpc_machine_read_memory_handler},
@@ -440,9 +440,41 @@ interpreter_break_reason jsonrpc_virtual_machine::do_run(uint64_t mcycle_end) {
     return result;
 }
 
-void jsonrpc_virtual_machine::do_store(const std::string &directory) {
+i_virtual_machine *jsonrpc_virtual_machine::do_clone(void) const {
+    throw std::runtime_error("cloning is not supported by remote machines, fork the remote server instead");
+}
+
+void jsonrpc_virtual_machine::do_store(const std::string &directory, const std::string &base_directory) {
+    bool result = false;
+    if (base_directory.empty()) {
+        jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.store", std::tie(directory),
+            result);
+    } else {
+        jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.store",
+            std::tie(directory, base_directory), result);
+    }
+}
+
+void jsonrpc_virtual_machine::do_store_file(const std::string &filename) {
     bool result = false;
-    jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.store", std::tie(directory), result);
+    jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.store_file", std::tie(filename), result);
+}
+
+void jsonrpc_virtual_machine::do_store_async(const std::string &directory, const std::string &base_directory) {
+    bool result = false;
+    if (base_directory.empty()) {
+        jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.store_async", std::tie(directory),
+            result);
+    } else {
+        jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.store_async",
+            std::tie(directory, base_directory), result);
+    }
+}
+
+bool jsonrpc_virtual_machine::do_wait_store(bool wait) {
+    bool result = false;
+    jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.wait_store", std::tie(wait), result);
+    return result;
 }
 
 uint64_t jsonrpc_virtual_machine::do_read_csr(csr r) const {
@@ -957,10 +989,27 @@ machine_merkle_tree::proof_type jsonrpc_virtual_machine::do_get_proof(uint64_t a
     return std::move(result).value();
 }
 
-void jsonrpc_virtual_machine::do_replace_memory_range(const memory_range_config &new_range) {
+std::vector<machine_merkle_tree::proof_type> jsonrpc_virtual_machine::do_get_proofs(
+    const std::vector<uint64_t> &addresses, const std::vector<int> &log2_sizes) const {
+    std::vector<machine_merkle_tree::proof_type> result;
+    jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.get_proofs",
+        std::tie(addresses, log2_sizes), result);
+    if (result.size() != addresses.size()) {
+        throw std::runtime_error("jsonrpc server error: wrong number of proofs");
+    }
+    return result;
+}
+
+void jsonrpc_virtual_machine::do_replace_memory_range(const memory_range_config &new_range,
+    const std::string &page_hashes_filename) {
     bool result = false;
-    jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.replace_memory_range",
-        std::tie(new_range), result);
+    if (page_hashes_filename.empty()) {
+        jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.replace_memory_range",
+            std::tie(new_range), result);
+    } else {
+        jsonrpc_request(m_mgr->get_stream(), m_mgr->get_remote_address(), "machine.replace_memory_range",
+            std::tie(new_range, page_hashes_filename), result);
+    }
 }
 
 access_log jsonrpc_virtual_machine::do_log_uarch_step(const access_log::type &log_type, bool one_based) {
@@ -84,7 +84,11 @@ private:
     machine_config do_get_initial_config(void) const override;
 
     interpreter_break_reason do_run(uint64_t mcycle_end) override;
-    void do_store(const std::string &dir) override;
+    i_virtual_machine *do_clone(void) const override;
+    void do_store(const std::string &dir, const std::string &base_dir) override;
+    void do_store_file(const std::string &filename) override;
+    void do_store_async(const std::string &dir, const std::string &base_dir) override;
+    bool do_wait_store(bool wait) override;
     uint64_t do_read_csr(csr r) const override;
     void do_write_csr(csr w, uint64_t val) override;
     uint64_t do_read_x(int i) const override;
@@ -189,7 +193,10 @@ private:
     void do_write_plic_girqsrvd(uint64_t val) override;
     void do_get_root_hash(hash_type &hash) const override;
     machine_merkle_tree::proof_type do_get_proof(uint64_t address, int log2_size) const override;
-    void do_replace_memory_range(const memory_range_config &new_range) override;
+    std::vector<machine_merkle_tree::proof_type> do_get_proofs(const std::vector<uint64_t> &addresses,
+        const std::vector<int> &log2_sizes) const override;
+    void do_replace_memory_range(const memory_range_config &new_range,
+        const std::string &page_hashes_filename) override;
     access_log do_log_uarch_step(const access_log::type &log_type, bool /*one_based = false*/) override;
     void do_destroy() override;
     void do_snapshot() override;
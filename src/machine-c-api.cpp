@@ -32,6 +32,7 @@
 #include "i-virtual-machine.h"
 #include "machine-config.h"
 #include "machine.h"
+#include "os.h"
 #include "semantic-version.h"
 #include "virtual-machine.h"
 
@@ -482,12 +483,19 @@ cartesi::machine_runtime_config convert_from_c(const cm_machine_runtime_config *
     }
     cartesi::machine_runtime_config new_cpp_machine_runtime_config{};
     new_cpp_machine_runtime_config.concurrency =
-        cartesi::concurrency_runtime_config{c_config->concurrency.update_merkle_tree};
+        cartesi::concurrency_runtime_config{c_config->concurrency.update_merkle_tree,
+            c_config->concurrency.background_merkle_tree_interval, c_config->concurrency.images};
     new_cpp_machine_runtime_config.htif = cartesi::htif_runtime_config{c_config->htif.no_console_putchar};
     new_cpp_machine_runtime_config.skip_root_hash_check = c_config->skip_root_hash_check;
     new_cpp_machine_runtime_config.skip_root_hash_store = c_config->skip_root_hash_store;
     new_cpp_machine_runtime_config.skip_version_check = c_config->skip_version_check;
     new_cpp_machine_runtime_config.soft_yield = c_config->soft_yield;
+    new_cpp_machine_runtime_config.use_page_hashes = c_config->use_page_hashes;
+    new_cpp_machine_runtime_config.reclaim_pristine_pages = c_config->reclaim_pristine_pages;
+    new_cpp_machine_runtime_config.soft_dirty_tracking = c_config->soft_dirty_tracking;
+    new_cpp_machine_runtime_config.huge_pages = c_config->huge_pages;
+    new_cpp_machine_runtime_config.compress_images = c_config->compress_images;
+    new_cpp_machine_runtime_config.copy_images = c_config->copy_images;
     return new_cpp_machine_runtime_config;
 }
 
@@ -939,6 +947,18 @@ int cm_create_machine(const cm_machine_config *config, const cm_machine_runtime_
     return cm_result_failure(err_msg);
 }
 
+int cm_clone_machine(const cm_machine *m, cm_machine **new_machine, char **err_msg) try {
+    if (new_machine == nullptr) {
+        throw std::invalid_argument("invalid new machine output");
+    }
+    const auto *cpp_machine = convert_from_c(m);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    *new_machine = reinterpret_cast<cm_machine *>(cpp_machine->clone());
+    return cm_result_success(err_msg);
+} catch (...) {
+    return cm_result_failure(err_msg);
+}
+
 int cm_load_machine(const char *dir, const cm_machine_runtime_config *runtime_config, cm_machine **new_machine,
     char **err_msg) try {
     if (new_machine == nullptr) {
@@ -968,6 +988,44 @@ int cm_store(cm_machine *m, const char *dir, char **err_msg) try {
     return cm_result_failure(err_msg);
 }
 
+int cm_store_delta(cm_machine *m, const char *dir, const char *base_dir, char **err_msg) try {
+    if (base_dir == nullptr || *base_dir == '\0') {
+        throw std::invalid_argument("invalid base directory");
+    }
+    auto *cpp_machine = convert_from_c(m);
+    cpp_machine->store(null_to_empty(dir), base_dir);
+    return cm_result_success(err_msg);
+} catch (...) {
+    return cm_result_failure(err_msg);
+}
+
+int cm_store_file(cm_machine *m, const char *filename, char **err_msg) try {
+    auto *cpp_machine = convert_from_c(m);
+    cpp_machine->store_file(null_to_empty(filename));
+    return cm_result_success(err_msg);
+} catch (...) {
+    return cm_result_failure(err_msg);
+}
+
+int cm_store_async(cm_machine *m, const char *dir, const char *base_dir, char **err_msg) try {
+    auto *cpp_machine = convert_from_c(m);
+    cpp_machine->store_async(null_to_empty(dir), null_to_empty(base_dir));
+    return cm_result_success(err_msg);
+} catch (...) {
+    return cm_result_failure(err_msg);
+}
+
+int cm_wait_store(cm_machine *m, bool wait, bool *done, char **err_msg) try {
+    if (done == nullptr) {
+        throw std::invalid_argument("invalid done output");
+    }
+    auto *cpp_machine = convert_from_c(m);
+    *done = cpp_machine->wait_store(wait);
+    return cm_result_success(err_msg);
+} catch (...) {
+    return cm_result_failure(err_msg);
+}
+
 int cm_machine_run(cm_machine *m, uint64_t mcycle_end, CM_BREAK_REASON *break_reason_result, char **err_msg) try {
     auto *cpp_machine = convert_from_c(m);
     cartesi::interpreter_break_reason break_reason = cpp_machine->run(mcycle_end);
@@ -1146,6 +1204,35 @@ int cm_get_proof(const cm_machine *m, uint64_t address, int log2_size, cm_merkle
     return cm_result_failure(err_msg);
 }
 
+int cm_get_proofs(const cm_machine *m, const uint64_t *addresses, const int *log2_sizes, size_t count,
+    cm_merkle_tree_proof **proofs, char **err_msg) try {
+    if (count > 0 && (addresses == nullptr || log2_sizes == nullptr)) {
+        throw std::invalid_argument("invalid targets");
+    }
+    if (count > 0 && proofs == nullptr) {
+        throw std::invalid_argument("invalid proofs output");
+    }
+    const auto *cpp_machine = convert_from_c(m);
+    const std::vector<uint64_t> cpp_addresses(addresses, addresses + count);
+    const std::vector<int> cpp_log2_sizes(log2_sizes, log2_sizes + count);
+    const auto cpp_proofs = cpp_machine->get_proofs(cpp_addresses, cpp_log2_sizes);
+    size_t converted = 0;
+    try {
+        for (; converted < count; ++converted) {
+            proofs[converted] = convert_to_c(cpp_proofs[converted]);
+        }
+    } catch (...) {
+        for (size_t i = 0; i < converted; ++i) {
+            cm_delete_merkle_tree_proof(proofs[i]);
+            proofs[i] = nullptr;
+        }
+        throw;
+    }
+    return cm_result_success(err_msg);
+} catch (...) {
+    return cm_result_failure(err_msg);
+}
+
 void cm_delete_merkle_tree_proof(cm_merkle_tree_proof *proof) {
     if (proof == nullptr) {
         return;
@@ -1528,6 +1615,19 @@ int cm_replace_memory_range(cm_machine *m, const cm_memory_range_config *new_ran
     return cm_result_failure(err_msg);
 }
 
+int cm_replace_memory_range_with_page_hashes(cm_machine *m, const cm_memory_range_config *new_range,
+    const char *page_hashes_filename, char **err_msg) try {
+    if (page_hashes_filename == nullptr) {
+        throw std::invalid_argument("invalid page hashes filename");
+    }
+    auto *cpp_machine = convert_from_c(m);
+    cartesi::memory_range_config cpp_range = convert_from_c(new_range);
+    cpp_machine->replace_memory_range(cpp_range, page_hashes_filename);
+    return cm_result_success(err_msg);
+} catch (...) {
+    return cm_result_failure(err_msg);
+}
+
 void cm_delete_memory_range_config(const cm_memory_range_config *config) {
     if (config == nullptr) {
         return;
@@ -1674,3 +1774,24 @@ int cm_verify_send_cmio_response_state_transition(uint16_t reason, const unsigne
 } catch (...) {
     return cm_result_failure(err_msg);
 }
+
+int cm_configure_thread_pool(uint64_t threads, bool pin_threads, char **err_msg) try {
+    cartesi::os_configure_thread_pool(threads, pin_threads);
+    return cm_result_success(err_msg);
+} catch (...) {
+    return cm_result_failure(err_msg);
+}
+
+int cm_get_thread_pool_stats(cm_thread_pool_stats *stats, char **err_msg) try {
+    if (stats == nullptr) {
+        throw std::invalid_argument("invalid stats output");
+    }
+    const cartesi::os_thread_pool_stats cpp_stats = cartesi::os_get_thread_pool_stats();
+    stats->threads = cpp_stats.threads;
+    stats->batches = cpp_stats.batches;
+    stats->tasks = cpp_stats.tasks;
+    stats->steals = cpp_stats.steals;
+    return cm_result_success(err_msg);
+} catch (...) {
+    return cm_result_failure(err_msg);
+}
@@ -188,6 +188,10 @@ typedef struct {                        // NOLINT(modernize-use-using)
 } cm_processor_config;
 
 /// \brief RAM state configuration
+/// \details Unless copy_images is set in the runtime configuration, the RAM and DTB images, and the
+/// memory images of stored machines, are mapped privately from their files. Pages the machine never
+/// wrote keep reading from the file, so the file must not be rewritten or truncated while the machine
+/// exists: later changes show through, and truncating the file raises SIGBUS in the process.
 typedef struct {                // NOLINT(modernize-use-using)
     uint64_t length;            ///< RAM length
     const char *image_filename; ///< RAM image file name
@@ -426,6 +430,8 @@ typedef struct {                    // NOLINT(modernize-use-using)
 /// \brief Concurrency runtime configuration
 typedef struct { // NOLINT(modernize-use-using)
     uint64_t update_merkle_tree;
+    uint64_t background_merkle_tree_interval; ///< Cycles between background Merkle tree updates while running
+    uint64_t images;                          ///< Threads storing and loading memory images
 } cm_concurrency_runtime_config;
 
 /// \brief HTIF runtime configuration
@@ -441,8 +447,22 @@ typedef struct { // NOLINT(modernize-use-using)
     bool skip_root_hash_store;
     bool skip_version_check;
     bool soft_yield;
+    bool use_page_hashes;
+    bool reclaim_pristine_pages;
+    bool soft_dirty_tracking; ///< Track writes to all memory ranges with host soft-dirty bits, one machine per process
+    bool huge_pages;
+    bool compress_images;
+    bool copy_images; ///< Read memory images instead of mapping them privately, see cm_ram_config
 } cm_machine_runtime_config;
 
+/// \brief Thread pool statistics
+typedef struct { // NOLINT(modernize-use-using)
+    uint64_t threads; ///< Number of worker threads
+    uint64_t batches; ///< Number of parallel loops dispatched to the pool
+    uint64_t tasks;   ///< Number of tasks executed
+    uint64_t steals;  ///< Number of tasks executed by a thread other than the worker they were queued to
+} cm_thread_pool_stats;
+
 /// \brief Machine instance handle
 /// \details cm_machine* is handle used from C api users
 /// to pass the machine object when calling C api functions. Currently,
@@ -501,6 +521,21 @@ CM_API void cm_delete_machine_config(const cm_machine_config *config);
 CM_API int cm_create_machine(const cm_machine_config *config, const cm_machine_runtime_config *runtime_config,
     cm_machine **new_machine, char **err_msg);
 
+/// \brief Create an independent copy of a machine instance in the same process
+/// \param m Pointer to valid machine instance
+/// \param new_machine Receives the pointer to new machine instance
+/// \param err_msg Receives the error message if function execution fails
+/// or NULL in case of successful function execution. In case of failure error_msg
+/// must be deleted by the function caller using cm_delete_cstring.
+/// err_msg can be NULL, meaning the error message won't be received.
+/// \details The copy is eager, not copy-on-write: all memory of the original that is not pristine is copied
+/// before the function returns. The copy reuses the page hashes of the original, so only pages dirty in the
+/// original are hashed again. Its initial config, as returned by cm_get_initial_config, describes the state of
+/// the original at the time of the call, without image files. Machines with VirtIO devices and remote machines
+/// cannot be cloned. Remote machines are copied by forking their server with cm_jsonrpc_fork.
+/// \returns 0 for success, non zero code for error
+CM_API int cm_clone_machine(const cm_machine *m, cm_machine **new_machine, char **err_msg);
+
 /// \brief Create machine instance from previously serialized directory
 /// \param dir Directory where previous machine is serialized
 /// \param runtime_config Machine runtime configuration. Must be pointer to valid object
@@ -524,6 +559,60 @@ CM_API int cm_load_machine(const char *dir, const cm_machine_runtime_config *run
 /// \returns 0 for success, non zero code for error
 CM_API int cm_store(cm_machine *m, const char *dir, char **err_msg);
 
+/// \brief Serialize only the pages of memory ranges that differ from a previously stored machine
+/// \param m Pointer to valid machine instance
+/// \param dir Directory where the machine will be serialized
+/// \param base_dir Directory where a machine was previously serialized, in full or as a delta itself
+/// \param err_msg Receives the error message if function execution fails
+/// or NULL in case of successful function execution. In case of failure error_msg
+/// must be deleted by the function caller using cm_delete_cstring.
+/// err_msg can be NULL, meaning the error message won't be received.
+/// \details cm_load_machine applies the delta over the base machine, which must be left in place.
+/// Memory ranges shared with their image files are stored in full.
+/// \returns 0 for success, non zero code for error
+CM_API int cm_store_delta(cm_machine *m, const char *dir, const char *base_dir, char **err_msg);
+
+/// \brief Serialize entire state to a single machine file
+/// \param m Pointer to valid machine instance
+/// \param filename Name of file where the machine will be serialized
+/// \param err_msg Receives the error message if function execution fails
+/// or NULL in case of successful function execution. In case of failure error_msg
+/// must be deleted by the function caller using cm_delete_cstring.
+/// err_msg can be NULL, meaning the error message won't be received.
+/// \details cm_load_machine loads the machine back when given the file name instead of a directory.
+/// Memory ranges are mapped from the file, and the page hashes stored with them are used when
+/// use_page_hashes is set in the runtime config.
+/// \returns 0 for success, non zero code for error
+CM_API int cm_store_file(cm_machine *m, const char *filename, char **err_msg);
+
+/// \brief Starts serializing entire state to a directory in the background
+/// \param m Pointer to valid machine instance
+/// \param dir Directory where the machine will be serialized
+/// \param base_dir Directory where a machine was previously serialized, to store only what differs from it
+/// as in cm_store_delta, or NULL to store the machine in full
+/// \param err_msg Receives the error message if function execution fails
+/// or NULL in case of successful function execution. In case of failure error_msg
+/// must be deleted by the function caller using cm_delete_cstring.
+/// err_msg can be NULL, meaning the error message won't be received.
+/// \details The state is captured when called, and stored by a child process while the machine keeps running.
+/// Machines with memory ranges shared with their image files are refused, since the child would not see
+/// those ranges as they were when called. Each store must be waited for with cm_wait_store before the next
+/// one starts.
+/// \returns 0 for success, non zero code for error
+CM_API int cm_store_async(cm_machine *m, const char *dir, const char *base_dir, char **err_msg);
+
+/// \brief Checks whether the store started by cm_store_async is done
+/// \param m Pointer to valid machine instance
+/// \param wait True to block until the store is done
+/// \param done Receives true if no store is in progress anymore, false if it is still running
+/// \param err_msg Receives the error message if function execution fails
+/// or NULL in case of successful function execution. In case of failure error_msg
+/// must be deleted by the function caller using cm_delete_cstring.
+/// err_msg can be NULL, meaning the error message won't be received.
+/// \details Fails with the error of the store if the store failed.
+/// \returns 0 for success, non zero code for error
+CM_API int cm_wait_store(cm_machine *m, bool wait, bool *done, char **err_msg);
+
 /// \brief Deletes machine instance
 /// \param m Valid pointer to the existing machine instance
 CM_API void cm_delete_machine(cm_machine *m);
@@ -624,7 +713,26 @@ CM_API int cm_verify_uarch_reset_log(const cm_access_log *log, const cm_machine_
 CM_API int cm_get_proof(const cm_machine *m, uint64_t address, int log2_size, cm_merkle_tree_proof **proof,
     char **err_msg);
 
-/// \brief  Deletes the instance of cm_merkle_tree_proof acquired from cm_get_proof
+/// \brief Obtains the proofs for several nodes in the Merkle tree
+/// \param m Pointer to valid machine instance
+/// \param addresses Array with the address of each target node. Each must be aligned to a 2<sup>log2_size</sup>
+/// boundary
+/// \param log2_sizes Array with log<sub>2</sub> of size subintended by each target node.
+/// Each must be between 3 (for a word) and 64 (for the entire address space), inclusive
+/// \param count Number of target nodes
+/// \param proofs Array of count entries that receive the proofs, in the same order
+/// each proof must be deleted with the function cm_delete_merkle_tree_proof
+/// \param err_msg Receives the error message if function execution fails
+/// or NULL in case of successful function execution. In case of failure error_msg
+/// must be deleted by the function caller using cm_delete_cstring.
+/// err_msg can be NULL, meaning the error message won't be received.
+/// \returns 0 for success, non zero code for error
+/// \details The Merkle tree is updated once for all proofs, and nodes inside the same page share most of the work.
+/// In case of failure, no proofs are returned.
+CM_API int cm_get_proofs(const cm_machine *m, const uint64_t *addresses, const int *log2_sizes, size_t count,
+    cm_merkle_tree_proof **proofs, char **err_msg);
+
+/// \brief  Deletes the instance of cm_merkle_tree_proof acquired from cm_get_proof or cm_get_proofs
 /// \param proof Valid pointer to cm_merkle_tree_proof object
 CM_API void cm_delete_merkle_tree_proof(cm_merkle_tree_proof *proof);
 
@@ -1726,6 +1834,21 @@ CM_API int cm_get_default_config(const cm_machine_config **config, char **err_ms
 /// \details The machine must contain an existing memory range matching the start and length specified in new_range
 CM_API int cm_replace_memory_range(cm_machine *m, const cm_memory_range_config *new_range, char **err_msg);
 
+/// \brief Replaces a memory range, installing precomputed hashes for its pages
+/// \param m Pointer to valid machine instance
+/// \param new_range Configuration of the new memory range
+/// \param page_hashes_filename File with one raw 32-byte hash per page of the new range,
+/// as produced by merkle-tree-hash --page-hashes-output
+/// \param err_msg Receives the error message if function execution fails
+/// or NULL in case of successful function execution. In case of failure error_msg
+/// must be deleted by the function caller using cm_delete_cstring.
+/// err_msg can be NULL, meaning the error message won't be received.
+/// \returns 0 for success, non zero code for error
+/// \details The page hashes are trusted until cm_verify_merkle_tree checks them.
+/// If the file does not match the range, the machine is left unchanged.
+CM_API int cm_replace_memory_range_with_page_hashes(cm_machine *m, const cm_memory_range_config *new_range,
+    const char *page_hashes_filename, char **err_msg);
+
 /// \brief Deletes a machine memory range config
 /// \returns void
 CM_API void cm_delete_memory_range_config(const cm_memory_range_config *config);
@@ -1766,6 +1889,8 @@ CM_API int cm_destroy(cm_machine *m, char **err_msg);
 /// or NULL in case of successful function execution. In case of failure error_msg
 /// must be deleted by the function caller using cm_delete_cstring.
 /// err_msg can be NULL, meaning the error message won't be received.
+/// \details Remote machines fork the server. Local machines save their pages to a journal when first
+/// written to after the snapshot, and do not support snapshots if they have VirtIO devices.
 /// \returns 0 for success, non zero code for error
 CM_API int cm_snapshot(cm_machine *m, char **err_msg);
 
@@ -1971,6 +2096,24 @@ CM_API int cm_verify_send_cmio_response_state_transition(uint16_t reason, const
     const cm_hash *root_hash_before, const cm_access_log *log, const cm_hash *root_hash_after,
     const cm_machine_runtime_config *runtime_config, bool one_based, char **err_msg);
 
+/// \brief Configures the process-wide thread pool used by parallel machine operations
+/// \param threads Number of worker threads, or 0 to use one less than the number of hardware threads
+/// \param pin_threads Pin each worker thread to a different CPU, when supported
+/// \param err_msg Receives the error message if function execution fails
+/// or NULL in case of successfull function execution. In case of failure error_msg
+/// must be deleted by the function caller using cm_delete_cstring
+/// \returns 0 for success, non zero code for error
+/// \details Must not be called while another thread is using a machine.
+CM_API int cm_configure_thread_pool(uint64_t threads, bool pin_threads, char **err_msg);
+
+/// \brief Obtains statistics for the process-wide thread pool used by parallel machine operations
+/// \param stats Receives the statistics
+/// \param err_msg Receives the error message if function execution fails
+/// or NULL in case of successfull function execution. In case of failure error_msg
+/// must be deleted by the function caller using cm_delete_cstring
+/// \returns 0 for success, non zero code for error
+CM_API int cm_get_thread_pool_stats(cm_thread_pool_stats *stats, char **err_msg);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,7 @@
 
 #include "machine-config.h"
 
+#include <filesystem>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -23,7 +24,9 @@
 #include <stdexcept>
 
 #include "json-util.h"
+#include "machine-file.h"
 #include "pma-constants.h"
+#include "unique-c-ptr.h"
 
 static constexpr uint32_t archive_version = 5;
 
@@ -39,23 +42,138 @@ std::string machine_config::get_image_filename(const std::string &dir, const mem
     return get_image_filename(dir, c.start, c.length);
 }
 
+std::string machine_config::get_compressed_image_filename(const std::string &dir, uint64_t start, uint64_t length) {
+    return get_image_filename(dir, start, length) + ".z";
+}
+
+std::string machine_config::get_page_hashes_filename(const std::string &dir, uint64_t start, uint64_t length) {
+    std::ostringstream sout;
+    sout << dir << "/" << std::hex << std::setw(16) << std::setfill('0') << start << "-" << length << ".hashes";
+    return sout.str();
+}
+
+std::string machine_config::get_delta_filename(const std::string &dir, uint64_t start, uint64_t length) {
+    std::ostringstream sout;
+    sout << dir << "/" << std::hex << std::setw(16) << std::setfill('0') << start << "-" << length << ".delta";
+    return sout.str();
+}
+
 std::string machine_config::get_config_filename(const std::string &dir) {
     return dir + "/config.json";
 }
 
+std::string machine_config::get_base_filename(const std::string &dir) {
+    return dir + "/base";
+}
+
+void machine_config::store_base_directory(const std::string &dir, const std::string &base_dir) {
+    auto name = get_base_filename(dir);
+    std::ofstream ofs(name, std::ios::binary);
+    if (!ofs) {
+        throw std::system_error{errno, std::generic_category(), "unable to open '" + name + "' for writing"};
+    }
+    // Relative paths would break as soon as the current directory changes
+    ofs << std::filesystem::absolute(base_dir).string();
+}
+
+std::string machine_config::load_base_directory(const std::string &dir) {
+    std::ifstream ifs(get_base_filename(dir), std::ios::binary);
+    if (!ifs) {
+        return {};
+    }
+    std::string base_dir{std::istreambuf_iterator<char>{ifs}, std::istreambuf_iterator<char>{}};
+    if (base_dir.empty()) {
+        throw std::runtime_error{"empty base directory in '" + get_base_filename(dir) + "'"};
+    }
+    return base_dir;
+}
+
+std::string machine_config::find_image_filename(const std::string &dir, uint64_t start, uint64_t length) {
+    for (auto d = dir; !d.empty(); d = load_base_directory(d)) {
+        auto name = get_image_filename(d, start, length);
+        if (std::filesystem::exists(name)) {
+            return name;
+        }
+        // The machine decompresses the image into the range after creating it
+        if (std::filesystem::exists(get_compressed_image_filename(d, start, length))) {
+            return {};
+        }
+    }
+    return get_image_filename(dir, start, length);
+}
+
 static void adjust_image_filenames(machine_config &c, const std::string &dir) {
-    c.dtb.image_filename = c.get_image_filename(dir, PMA_DTB_START, PMA_DTB_LENGTH);
-    c.ram.image_filename = c.get_image_filename(dir, PMA_RAM_START, c.ram.length);
+    // Memory ranges of a delta start from the nearest full image, and the delta pages are applied on top
+    c.dtb.image_filename = c.find_image_filename(dir, PMA_DTB_START, PMA_DTB_LENGTH);
+    c.ram.image_filename = c.find_image_filename(dir, PMA_RAM_START, c.ram.length);
     c.tlb.image_filename = c.get_image_filename(dir, PMA_SHADOW_TLB_START, PMA_SHADOW_TLB_LENGTH);
     for (auto &f : c.flash_drive) {
-        f.image_filename = c.get_image_filename(dir, f);
+        f.image_filename = c.find_image_filename(dir, f.start, f.length);
+    }
+    c.uarch.ram.image_filename = c.find_image_filename(dir, PMA_UARCH_RAM_START, PMA_UARCH_RAM_LENGTH);
+    c.cmio.rx_buffer.image_filename = c.find_image_filename(dir, PMA_CMIO_RX_BUFFER_START, PMA_CMIO_RX_BUFFER_LENGTH);
+    c.cmio.tx_buffer.image_filename = c.find_image_filename(dir, PMA_CMIO_TX_BUFFER_START, PMA_CMIO_TX_BUFFER_LENGTH);
+}
+
+static void check_archive_version(const nlohmann::json &j) {
+    if (!j.contains("archive_version")) {
+        throw std::runtime_error("missing field \"archive_version\"");
+    }
+    const auto &jv = j["archive_version"];
+    if (!jv.is_number_integer()) {
+        throw std::runtime_error("expected integer field \"archive_version\"");
+    }
+    if (jv.get<int>() != archive_version) {
+        throw std::runtime_error("expected \"archive_version\" " + std::to_string(archive_version) + " (got " +
+            std::to_string(jv.get<int>()) + ")");
+    }
+}
+
+// Machine files hold the images themselves, and their ranges are never shared with image files
+static void clear_image_filenames(machine_config &c) {
+    c.dtb.image_filename.clear();
+    c.ram.image_filename.clear();
+    c.tlb.image_filename.clear();
+    for (auto &f : c.flash_drive) {
+        f.image_filename.clear();
+        f.shared = false;
     }
-    c.uarch.ram.image_filename = c.get_image_filename(dir, PMA_UARCH_RAM_START, PMA_UARCH_RAM_LENGTH);
-    c.cmio.rx_buffer.image_filename = c.get_image_filename(dir, PMA_CMIO_RX_BUFFER_START, PMA_CMIO_RX_BUFFER_LENGTH);
-    c.cmio.tx_buffer.image_filename = c.get_image_filename(dir, PMA_CMIO_TX_BUFFER_START, PMA_CMIO_TX_BUFFER_LENGTH);
+    c.uarch.ram.image_filename.clear();
+    c.cmio.rx_buffer.image_filename.clear();
+    c.cmio.rx_buffer.shared = false;
+    c.cmio.tx_buffer.image_filename.clear();
+    c.cmio.tx_buffer.shared = false;
+}
+
+static machine_config load_file(const std::string &filename) {
+    auto fp = unique_fopen(filename.c_str(), "rb");
+    const auto header = read_machine_file_header(fp.get(), filename);
+    // Check the header against the file before trusting it with an allocation
+    const uint64_t file_length = std::filesystem::file_size(filename);
+    if (header.config_offset > file_length || header.config_length > file_length - header.config_offset) {
+        throw std::runtime_error{"corrupt config in '" + filename + "'"};
+    }
+    std::string config(header.config_length, '\0');
+    if (fseek(fp.get(), static_cast<long>(header.config_offset), SEEK_SET) != 0 ||
+        fread(config.data(), 1, config.size(), fp.get()) != config.size()) {
+        throw std::system_error{errno, std::generic_category(), "error reading config of '" + filename + "'"};
+    }
+    machine_config c;
+    try {
+        auto j = nlohmann::json::parse(config);
+        check_archive_version(j);
+        ju_get_field(j, std::string("config"), c, "");
+        clear_image_filenames(c);
+    } catch (std::exception &e) {
+        throw std::runtime_error{e.what()};
+    }
+    return c;
 }
 
 machine_config machine_config::load(const std::string &dir) {
+    if (is_machine_file(dir)) {
+        return load_file(dir);
+    }
     machine_config c;
     auto name = machine_config::get_config_filename(dir);
     std::ifstream ifs(name, std::ios::binary);
@@ -64,17 +182,7 @@ machine_config machine_config::load(const std::string &dir) {
     }
     try {
         auto j = nlohmann::json::parse(ifs);
-        if (!j.contains("archive_version")) {
-            throw std::runtime_error("missing field \"archive_version\"");
-        }
-        auto jv = j["archive_version"];
-        if (!jv.is_number_integer()) {
-            throw std::runtime_error("expected integer field \"archive_version\"");
-        }
-        if (jv.get<int>() != archive_version) {
-            throw std::runtime_error("expected \"archive_version\" " + std::to_string(archive_version) + " (got " +
-                std::to_string(jv.get<int>()) + ")");
-        }
+        check_archive_version(j);
         ju_get_field(j, std::string("config"), c, "");
         adjust_image_filenames(c, dir);
     } catch (std::exception &e) {
@@ -83,16 +191,20 @@ machine_config machine_config::load(const std::string &dir) {
     return c;
 }
 
-void machine_config::store(const std::string &dir) const {
-    auto name = get_config_filename(dir);
+std::string machine_config::to_archive_json(void) const {
     nlohmann::json j;
     j["archive_version"] = archive_version;
     j["config"] = *this;
+    return j.dump();
+}
+
+void machine_config::store(const std::string &dir) const {
+    auto name = get_config_filename(dir);
     std::ofstream ofs(name, std::ios::binary);
     if (!ofs) {
         throw std::system_error{errno, std::generic_category(), "unable to open '" + name + "' for writing"};
     }
-    ofs << j;
+    ofs << to_archive_json();
 }
 
 } // namespace cartesi
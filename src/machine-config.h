@@ -77,6 +77,8 @@ struct processor_config final {
 };
 
 /// \brief RAM state configuration
+/// \details The image is mapped privately unless machine_runtime_config::copy_images is set, so it must
+/// not be rewritten or truncated while the machine exists (the same holds for the DTB image).
 struct ram_config final {         // NOLINT(bugprone-exception-escape)
     uint64_t length{0};           ///< RAM length
     std::string image_filename{}; ///< RAM image file name
@@ -201,11 +203,46 @@ struct machine_config final {
     static std::string get_image_filename(const std::string &dir, uint64_t start, uint64_t length);
     static std::string get_image_filename(const std::string &dir, const memory_range_config &c);
 
+    /// \brief Get the name where the compressed image of a memory range will be stored in a directory
+    static std::string get_compressed_image_filename(const std::string &dir, uint64_t start, uint64_t length);
+
+    /// \brief Get the name where the page hashes of a memory range will be stored in a directory
+    static std::string get_page_hashes_filename(const std::string &dir, uint64_t start, uint64_t length);
+
+    /// \brief Get the name where the pages of a memory range that differ from the base machine will be stored
+    static std::string get_delta_filename(const std::string &dir, uint64_t start, uint64_t length);
+
+    /// \brief Get the name where the base directory of a delta will be stored
+    static std::string get_base_filename(const std::string &dir);
+
+    /// \brief Stores the base directory a delta was stored over
+    /// \param dir Directory holding the delta
+    /// \param base_dir Directory holding the base machine
+    static void store_base_directory(const std::string &dir, const std::string &base_dir);
+
+    /// \brief Loads the base directory a delta was stored over
+    /// \param dir Directory holding the delta
+    /// \returns Base directory, or an empty string if dir holds a full machine
+    static std::string load_base_directory(const std::string &dir);
+
+    /// \brief Finds the image of a memory range in a chain of deltas
+    /// \param dir Directory holding the machine
+    /// \param start Start of memory range
+    /// \param length Length of memory range
+    /// \returns Name of the image in the first directory, following base directories from dir,
+    /// that holds one. If that directory holds a compressed image instead, an empty string, so the range
+    /// starts out zeroed. If none does, the name the image would have in dir.
+    static std::string find_image_filename(const std::string &dir, uint64_t start, uint64_t length);
+
     /// \brief Loads a machine config from a directory
-    /// \param dir Directory from whence "config" will be loaded
+    /// \param dir Directory from whence "config" will be loaded, or machine file
     /// \returns The config loaded
+    /// \details Configs loaded from machine files have no image files, and no shared ranges.
     static machine_config load(const std::string &dir);
 
+    /// \brief Serializes the machine config, as stored by store()
+    std::string to_archive_json(void) const;
+
     /// \brief Stores the machine config to a directory
     /// \param dir Directory where "config" will be stored
     void store(const std::string &dir) const;
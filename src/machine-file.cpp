@@ -0,0 +1,53 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "machine-file.h"
+
+#include <cerrno>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#include "unique-c-ptr.h"
+
+namespace cartesi {
+
+bool is_machine_file(const std::string &path) {
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec)) {
+        return false;
+    }
+    auto fp = unique_fopen(path.c_str(), "rb", std::nothrow_t{});
+    std::array<char, MACHINE_FILE_MAGIC.size()> magic{};
+    return fp && fread(magic.data(), 1, magic.size(), fp.get()) == magic.size() && magic == MACHINE_FILE_MAGIC;
+}
+
+machine_file_header read_machine_file_header(FILE *fp, const std::string &filename) {
+    machine_file_header header{};
+    if (fseek(fp, 0, SEEK_SET) != 0 || fread(&header, sizeof(header), 1, fp) != 1) {
+        throw std::system_error{errno, std::generic_category(), "error reading header of '" + filename + "'"};
+    }
+    if (header.magic != MACHINE_FILE_MAGIC) {
+        throw std::runtime_error{"'" + filename + "' is not a machine file"};
+    }
+    if (header.version != MACHINE_FILE_VERSION) {
+        throw std::runtime_error{"expected machine file version " + std::to_string(MACHINE_FILE_VERSION) +
+            " (got " + std::to_string(header.version) + ") in '" + filename + "'"};
+    }
+    return header;
+}
+
+} // namespace cartesi
@@ -0,0 +1,84 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef MACHINE_FILE_H
+#define MACHINE_FILE_H
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "pma-constants.h"
+
+namespace cartesi {
+
+/// \file
+/// \brief Layout of machines stored in a single file.
+/// \details The file starts with a header, followed by the machine config in JSON, the table of
+/// stored ranges, and the page index and page hashes of each range. The data of each range comes
+/// last, in a region of its own that starts at a page boundary and holds page i of the range at
+/// offset i * MACHINE_FILE_PAGE_SIZE, so it can be mapped directly into memory. Pristine pages
+/// and pages that repeat an earlier page are not written to the region, leaving holes in the file.
+/// All integers are in host byte order.
+
+/// \brief Machine file constants.
+enum MACHINE_FILE_constants : uint64_t {
+    MACHINE_FILE_VERSION = 1,               ///< Version of the layout
+    MACHINE_FILE_PAGE_SIZE = PMA_PAGE_SIZE, ///< Size of pages, and alignment of data regions
+    MACHINE_FILE_PRISTINE_PAGE = 0,         ///< Page index entry of pages that hold only zeros
+    MACHINE_FILE_HASH_SIZE = 32,            ///< Size of root and page hashes
+};
+
+/// \brief Magic bytes identifying machine files
+static constexpr std::array<char, 8> MACHINE_FILE_MAGIC = {'C', 'M', 'A', 'C', 'H', 'I', 'N', 'E'};
+
+/// \brief Header at the start of machine files
+struct machine_file_header {
+    std::array<char, 8> magic;                                   ///< MACHINE_FILE_MAGIC
+    uint64_t version;                                            ///< MACHINE_FILE_VERSION
+    uint64_t config_offset;                                      ///< Offset of machine config in JSON
+    uint64_t config_length;                                      ///< Length of machine config
+    uint64_t range_count;                                        ///< Number of stored ranges
+    uint64_t ranges_offset;                                      ///< Offset of table of stored ranges
+    uint64_t has_root_hash;                                      ///< Non-zero if root_hash was stored
+    std::array<unsigned char, MACHINE_FILE_HASH_SIZE> root_hash; ///< Root hash of the machine
+};
+
+/// \brief Entry in the table of stored ranges
+struct machine_file_range {
+    uint64_t start;         ///< Start of range
+    uint64_t length;        ///< Length of range
+    uint64_t index_offset;  ///< Offset of page index, with the offset in the file of the data of each page,
+                            ///< or MACHINE_FILE_PRISTINE_PAGE
+    uint64_t hashes_offset; ///< Offset of page hashes, one per page
+    uint64_t data_offset;   ///< Offset of data region
+};
+
+/// \brief Checks if a path names a machine file, rather than a machine directory
+/// \param path Path to check
+/// \returns True if path names a regular file starting with MACHINE_FILE_MAGIC
+bool is_machine_file(const std::string &path);
+
+/// \brief Reads and checks the header of a machine file
+/// \param fp Machine file
+/// \param filename Name of machine file, for error messages
+/// \returns Header
+machine_file_header read_machine_file_header(FILE *fp, const std::string &filename);
+
+} // namespace cartesi
+
+#endif
@@ -16,10 +16,16 @@
 
 #include "machine-merkle-tree.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <optional>
+
+#include "os-parallel.h"
 
 /// \file
 /// \brief Merkle tree implementation.
@@ -33,6 +39,9 @@ const cartesi::pristine_merkle_tree &machine_merkle_tree::pristine_hashes() {
     return tree;
 }
 
+// Value of dense subtree entries that were never written
+static const machine_merkle_tree::hash_type dense_unset_hash{};
+
 constexpr machine_merkle_tree::address_type machine_merkle_tree::get_page_index(address_type address) {
     return address & m_page_index_mask;
 }
@@ -47,6 +56,17 @@ machine_merkle_tree::tree_node *machine_merkle_tree::get_page_node(address_type
     }
 }
 
+machine_merkle_tree::dense_subtree *machine_merkle_tree::get_dense_subtree(address_type page_index) const {
+    // The only candidate is the last subtree starting at or before the page
+    auto it = m_dense_subtrees.upper_bound(page_index);
+    if (it == m_dense_subtrees.begin()) {
+        return nullptr;
+    }
+    --it;
+    dense_subtree *d = it->second.get();
+    return ((page_index - d->start) >> d->log2_size) == 0 ? d : nullptr;
+}
+
 constexpr machine_merkle_tree::address_type machine_merkle_tree::get_offset_in_page(address_type address) {
     return address & m_page_offset_mask;
 }
@@ -131,6 +151,12 @@ void machine_merkle_tree::get_page_node_hash(hasher_type &h, const unsigned char
 
 void machine_merkle_tree::get_page_node_hash(address_type page_index, hash_type &hash) const {
     assert(page_index == get_page_index(page_index));
+    const dense_subtree *d = get_dense_subtree(page_index);
+    if (d) {
+        const int depth = d->log2_size - get_log2_page_size();
+        hash = get_dense_hash(*d, (UINT64_C(1) << depth) + ((page_index - d->start) >> get_log2_page_size()));
+        return;
+    }
     tree_node *node = get_page_node(page_index);
     if (!node) {
         hash = get_pristine_hash(get_log2_page_size());
@@ -149,6 +175,120 @@ void machine_merkle_tree::update_inner_node_hash(hasher_type &h, int log2_size,
     get_concat_hash(h, get_child_hash(log2_size - 1, node, 0), get_child_hash(log2_size - 1, node, 1), node->hash);
 }
 
+void machine_merkle_tree::enqueue_parent(tree_node *node, int log2_size) {
+    if (node->parent && node->parent->mark != m_merkle_update_nonce) {
+        m_merkle_update_levels[log2_size + 1].push_back(node->parent);
+        node->parent->mark = m_merkle_update_nonce;
+    }
+}
+
+machine_merkle_tree::dense_subtree::~dense_subtree() {
+    std::free(hashes); // NOLINT(cppcoreguidelines-no-malloc)
+}
+
+const machine_merkle_tree::hash_type &machine_merkle_tree::get_dense_hash(const dense_subtree &d, uint64_t index) {
+    const hash_type &hash = d.hashes[index];
+    if (hash != dense_unset_hash) {
+        return hash;
+    }
+    // Node i is at level floor(log2(i)) below the subtree root
+    const int level = std::numeric_limits<uint64_t>::digits - 1 - __builtin_clzll(index);
+    return get_pristine_hash(d.log2_size - level);
+}
+
+void machine_merkle_tree::update_dense_subtree(hasher_type &h, dense_subtree &d) {
+    auto &dirty = d.dirty;
+    // Indices are visited in increasing order, so parents of
+    // duplicates end up adjacent to each other
+    std::sort(dirty.begin(), dirty.end());
+    while (!dirty.empty()) {
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        size_t parents = 0;
+        for (const uint64_t i : dirty) {
+            // Leave pristine nodes unwritten, so their memory is never touched
+            if (d.hashes[i] != dense_unset_hash || d.hashes[2 * i] != dense_unset_hash ||
+                d.hashes[2 * i + 1] != dense_unset_hash) {
+                get_concat_hash(h, get_dense_hash(d, 2 * i), get_dense_hash(d, 2 * i + 1), d.hashes[i]);
+            }
+            if (i > 1) {
+                dirty[parents++] = i >> 1;
+            }
+        }
+        dirty.resize(parents);
+    }
+}
+
+bool machine_merkle_tree::verify_dense_subtree(hasher_type &h, const dense_subtree &d, uint64_t first, uint64_t last,
+    std::atomic<bool> &failed) {
+    hash_type hash;
+    for (uint64_t i = first; i < last; ++i) {
+        // Check for mismatches found by other threads every now and then
+        if ((i & 0xff) == 0 && failed.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        // A node that was never written is pristine, and so must be its children
+        if (d.hashes[i] == dense_unset_hash) {
+            if (d.hashes[2 * i] != dense_unset_hash || d.hashes[2 * i + 1] != dense_unset_hash) {
+                failed.store(true, std::memory_order_relaxed);
+                return false;
+            }
+            continue;
+        }
+        get_concat_hash(h, get_dense_hash(d, 2 * i), get_dense_hash(d, 2 * i + 1), hash);
+        if (hash != d.hashes[i]) {
+            failed.store(true, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool machine_merkle_tree::add_dense_subtree(address_type start, int log2_size) {
+    if (log2_size < get_log2_page_size() || log2_size >= get_log2_root_size()) {
+        return false;
+    }
+    if (start & ((UINT64_C(1) << log2_size) - 1)) {
+        return false;
+    }
+    auto d = std::make_unique<dense_subtree>();
+    d->start = start;
+    d->log2_size = log2_size;
+    // Large blocks are obtained from the OS already zeroed, and their pages are only backed when
+    // first written, so large ranges that stay mostly pristine cost little
+    const int depth = log2_size - get_log2_page_size();
+    // NOLINTNEXTLINE(cppcoreguidelines-no-malloc)
+    d->hashes = static_cast<hash_type *>(std::calloc(UINT64_C(2) << depth, sizeof(hash_type)));
+    if (!d->hashes) {
+        return false;
+    }
+    // Descend tree until we reach the node that will mirror the subtree root,
+    // creating the needed nodes along the way
+    tree_node *node = m_root;
+    for (int log2_node_size = get_log2_root_size(); log2_node_size > log2_size; --log2_node_size) {
+        // Range must not be inside an existing dense subtree
+        if (node->dense) {
+            return false;
+        }
+        const int bit = (start & (UINT64_C(1) << (log2_node_size - 1))) != 0;
+        tree_node *child = node->child[bit];
+        if (!child) {
+            child = create_node();
+            child->hash = get_pristine_hash(log2_node_size - 1);
+            child->parent = node;
+            node->child[bit] = child;
+        } else if (log2_node_size - 1 == log2_size) {
+            // Range must not contain existing page nodes or dense subtrees
+            return false;
+        }
+        node = child;
+    }
+    d->node = node;
+    node->hash = get_pristine_hash(log2_size);
+    node->dense = d.get();
+    m_dense_subtrees.emplace(start, std::move(d));
+    return true;
+}
+
 void machine_merkle_tree::dump_hash(const hash_type &hash) {
     auto f = std::cerr.flags();
     for (const auto &b : hash) {
@@ -170,7 +310,9 @@ void machine_merkle_tree::dump_merkle_tree(tree_node *node, uint64_t address, in
               << std::setw(2) << std::dec << log2_size << ' ';
     if (node) {
         dump_hash(node->hash);
-        if (log2_size > get_log2_page_size()) {
+        if (node->dense) {
+            dump_dense_subtree(*node->dense, 1, address, log2_size);
+        } else if (log2_size > get_log2_page_size()) {
             dump_merkle_tree(node->child[0], address, log2_size - 1);
             dump_merkle_tree(node->child[1], address + (UINT64_C(1) << (log2_size - 1)), log2_size - 1);
         }
@@ -179,6 +321,25 @@ void machine_merkle_tree::dump_merkle_tree(tree_node *node, uint64_t address, in
     }
 }
 
+void machine_merkle_tree::dump_dense_subtree(const dense_subtree &d, uint64_t index, uint64_t address,
+    int log2_size) const {
+    if (log2_size <= get_log2_page_size()) {
+        return;
+    }
+    const int log2_child_size = log2_size - 1;
+    for (int bit = 0; bit < 2; ++bit) {
+        const uint64_t child_index = 2 * index + bit;
+        const uint64_t child_address = address + (static_cast<uint64_t>(bit) << log2_child_size);
+        for (int i = 0; i < get_log2_root_size() - log2_child_size; i++) {
+            std::cerr << ' ';
+        }
+        std::cerr << "0x" << std::setfill('0') << std::setw(16) << std::hex << child_address << ":"
+                  << std::setfill('0') << std::setw(2) << std::dec << log2_child_size << ' ';
+        dump_hash(get_dense_hash(d, child_index));
+        dump_dense_subtree(d, child_index, child_address, log2_child_size);
+    }
+}
+
 void machine_merkle_tree::destroy_merkle_tree(tree_node *node, int log2_size) {
     if (node) {
         // If this is an inner node, invoke recursively
@@ -245,12 +406,40 @@ void machine_merkle_tree::dump_merkle_tree(void) const {
 }
 
 bool machine_merkle_tree::begin_update(void) {
-    m_merkle_update_fifo.clear();
+    for (auto &level : m_merkle_update_levels) {
+        level.clear();
+    }
+    for (auto &[start, d] : m_dense_subtrees) {
+        d->dirty.clear();
+    }
     return true;
 }
 
 bool machine_merkle_tree::update_page_node_hash(address_type page_index, const hash_type &hash) {
     assert(get_page_index(page_index) == page_index);
+    // Consecutive updates tend to hit the same dense subtree
+    dense_subtree *d = m_last_dense;
+    if (!d || ((page_index - d->start) >> d->log2_size) != 0) {
+        d = get_dense_subtree(page_index);
+    }
+    if (d) {
+        m_last_dense = d;
+        const int depth = d->log2_size - get_log2_page_size();
+        const uint64_t index = (UINT64_C(1) << depth) + ((page_index - d->start) >> get_log2_page_size());
+        // Pristine pages that were never written need no update
+        if (d->hashes[index] == dense_unset_hash && hash == get_pristine_hash(get_log2_page_size())) {
+            return true;
+        }
+        d->hashes[index] = hash;
+        if (index > 1) {
+            d->dirty.push_back(index >> 1);
+        } else {
+            // Dense subtree with a single page
+            d->node->hash = hash;
+            enqueue_parent(d->node, d->log2_size);
+        }
+        return true;
+    }
     tree_node *node = get_page_node(page_index);
     // If there is no page node for this page index, allocate a fresh one
     if (!node) {
@@ -262,33 +451,39 @@ bool machine_merkle_tree::update_page_node_hash(address_type page_index, const h
     }
     // Copy new hash value to node
     node->hash = hash;
-    // Add parent to fifo so we propagate changes
-    if (node->parent && node->parent->mark != m_merkle_update_nonce) {
-        m_merkle_update_fifo.emplace_back(get_log2_page_size() + 1, node->parent);
-        node->parent->mark = m_merkle_update_nonce;
-    }
+    // Enqueue parent so we propagate changes
+    enqueue_parent(node, get_log2_page_size());
     return true;
 }
 
 bool machine_merkle_tree::end_update(hasher_type &h) {
-    // Now go over the queue of inner nodes updating their hashes and
-    // enqueueing their parents until the queue is empty
-    while (!m_merkle_update_fifo.empty()) {
-        int log2_size{};
-        tree_node *node{};
-        std::tie(log2_size, node) = m_merkle_update_fifo.front();
-        update_inner_node_hash(h, log2_size, node);
-        m_merkle_update_fifo.pop_front();
-        if (node->parent && node->parent->mark != m_merkle_update_nonce) {
-            m_merkle_update_fifo.emplace_back(log2_size + 1, node->parent);
-            node->parent->mark = m_merkle_update_nonce;
+    // First bring the roots of dense subtrees up to date
+    for (auto &[start, d] : m_dense_subtrees) {
+        if (!d->dirty.empty()) {
+            update_dense_subtree(h, *d);
+            d->node->hash = get_dense_hash(*d, 1);
+            enqueue_parent(d->node, d->log2_size);
+        }
+    }
+    // Now go over the inner nodes level by level, updating their hashes and
+    // enqueueing their parents, until we reach the root
+    for (int log2_size = get_log2_page_size() + 1; log2_size <= get_log2_root_size(); ++log2_size) {
+        auto &level = m_merkle_update_levels[log2_size];
+        for (tree_node *node : level) {
+            update_inner_node_hash(h, log2_size, node);
+            enqueue_parent(node, log2_size);
         }
+        level.clear();
     }
     ++m_merkle_update_nonce;
     return true;
 }
 
-machine_merkle_tree::machine_merkle_tree(void) : m_root_storage{}, m_root{&m_root_storage}, m_merkle_update_nonce{1} {
+machine_merkle_tree::machine_merkle_tree(void) :
+    m_last_dense{nullptr},
+    m_root_storage{},
+    m_root{&m_root_storage},
+    m_merkle_update_nonce{1} {
     m_root->hash = get_pristine_hash(get_log2_root_size());
 #ifdef MERKLE_DUMP_STATS
     m_num_nodes = 0;
@@ -311,21 +506,106 @@ void machine_merkle_tree::get_root_hash(hash_type &hash) const {
     hash = m_root->hash;
 }
 
-bool machine_merkle_tree::verify_tree(void) const {
+bool machine_merkle_tree::verify_tree(uint64_t concurrency) const {
+    const uint64_t n = concurrency > 0 ? concurrency : std::max(os_get_concurrency(), UINT64_C(1));
+    std::atomic<bool> failed{false};
     hasher_type h;
-    return verify_tree(h, m_root, get_log2_root_size());
+    if (n <= 1) {
+        return verify_tree(h, m_root, get_log2_root_size(), failed);
+    }
+    // Descend breadth first until there are a few subtrees for each thread.
+    // Nodes above them are verified here, and dense subtrees are split into runs of nodes.
+    struct verify_task {
+        tree_node *node;            ///< Root of subtree, if not dense.
+        int log2_size;              ///< log<sub>2</sub> of size subintended by node.
+        const dense_subtree *dense; ///< Dense subtree, if any.
+        uint64_t first;             ///< Index of first dense subtree node in run.
+        uint64_t last;              ///< Index of one past last dense subtree node in run.
+    };
+    const uint64_t target = 4 * n;
+    std::vector<std::pair<tree_node *, int>> frontier{{m_root, get_log2_root_size()}};
+    std::vector<std::pair<tree_node *, int>> above;
+    for (bool split = true; split && frontier.size() < target;) {
+        split = false;
+        std::vector<std::pair<tree_node *, int>> next;
+        for (const auto &[node, log2_size] : frontier) {
+            if (!node->dense && log2_size > get_log2_page_size()) {
+                above.emplace_back(node, log2_size);
+                // Missing children are pristine subtrees, which need no verification
+                for (tree_node *child : node->child) {
+                    if (child) {
+                        next.emplace_back(child, log2_size - 1);
+                    }
+                }
+                split = true;
+            } else {
+                next.emplace_back(node, log2_size);
+            }
+        }
+        frontier = std::move(next);
+    }
+    std::vector<verify_task> tasks;
+    for (const auto &[node, log2_size] : frontier) {
+        if (!node->dense) {
+            tasks.push_back({node, log2_size, nullptr, 0, 0});
+            continue;
+        }
+        const dense_subtree &d = *node->dense;
+        if (node->hash != get_dense_hash(d, 1)) {
+            return false;
+        }
+        const uint64_t inner = UINT64_C(1) << (d.log2_size - get_log2_page_size());
+        const uint64_t run = std::max(inner / target, UINT64_C(1024));
+        for (uint64_t first = 1; first < inner; first += run) {
+            tasks.push_back({nullptr, log2_size, &d, first, std::min(first + run, inner)});
+        }
+    }
+    // Thread j is responsible for task i if i % n == j
+    os_parallel_for(n, [this, &tasks, &failed, n](uint64_t j, const parallel_for_mutex &) -> bool {
+        hasher_type h;
+        for (uint64_t i = j; i < tasks.size() && !failed.load(std::memory_order_relaxed); i += n) {
+            const auto &t = tasks[i];
+            if (t.dense) {
+                verify_dense_subtree(h, *t.dense, t.first, t.last, failed);
+            } else if (!verify_tree(h, t.node, t.log2_size, failed)) {
+                failed.store(true, std::memory_order_relaxed);
+            }
+        }
+        return true;
+    });
+    if (failed.load()) {
+        return false;
+    }
+    hash_type hash;
+    for (const auto &[node, log2_size] : above) {
+        const int child_log2_size = log2_size - 1;
+        get_concat_hash(h, get_child_hash(child_log2_size, node, 0), get_child_hash(child_log2_size, node, 1), hash);
+        if (hash != node->hash) {
+            return false;
+        }
+    }
+    return true;
 }
 
-bool machine_merkle_tree::verify_tree(hasher_type &h, tree_node *node, int log2_size) const {
+bool machine_merkle_tree::verify_tree(hasher_type &h, tree_node *node, int log2_size, std::atomic<bool> &failed) const {
     // pristine node is always correct
     if (!node) {
         return true;
     }
+    // give up if another thread found a mismatch
+    if (failed.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    // verify dense subtree and its mirror node
+    if (node->dense) {
+        const uint64_t inner = UINT64_C(1) << (node->dense->log2_size - get_log2_page_size());
+        return verify_dense_subtree(h, *node->dense, 1, inner, failed) && node->hash == get_dense_hash(*node->dense, 1);
+    }
     // verify inner node
     if (log2_size > get_log2_page_size()) {
         const int child_log2_size = log2_size - 1;
-        auto first_ok = verify_tree(h, node->child[0], child_log2_size);
-        auto second_ok = verify_tree(h, node->child[1], child_log2_size);
+        auto first_ok = verify_tree(h, node->child[0], child_log2_size, failed);
+        auto second_ok = verify_tree(h, node->child[1], child_log2_size, failed);
         if (!first_ok || !second_ok) {
             return false;
         }
@@ -357,17 +637,32 @@ machine_merkle_tree::proof_type machine_merkle_tree::get_proof(address_type targ
     int log2_node_size = get_log2_root_size();
     const tree_node *node = m_root;
     // Copy non-pristine siblings hashes directly from tree nodes
-    while (node && log2_node_size > log2_stop_size) {
+    while (node && !node->dense && log2_node_size > log2_stop_size) {
         const int log2_child_size = log2_node_size - 1;
         const int path_bit = (target_address & (UINT64_C(1) << (log2_child_size))) != 0;
         proof.set_sibling_hash(get_child_hash(log2_child_size, node, !path_bit), log2_child_size);
         node = node->child[path_bit];
         log2_node_size = log2_child_size;
     }
+    const hash_type *node_hash = node ? &node->hash : nullptr;
+    // If we hit a dense subtree, continue descending inside its array
+    if (node && node->dense) {
+        const dense_subtree &d = *node->dense;
+        uint64_t index = 1;
+        while (log2_node_size > log2_stop_size) {
+            const int log2_child_size = log2_node_size - 1;
+            const uint64_t path_bit = (target_address & (UINT64_C(1) << (log2_child_size))) != 0;
+            index = 2 * index;
+            proof.set_sibling_hash(get_dense_hash(d, index + (path_bit ^ 1)), log2_child_size);
+            index += path_bit;
+            log2_node_size = log2_child_size;
+        }
+        node_hash = &get_dense_hash(d, index);
+    }
     // At this point, there are three alternatives
     // Case 1
     // We hit a pristine node along the path to the target node
-    if (!node) {
+    if (!node_hash) {
         if (page_data) {
             throw std::runtime_error{"inconsistent merkle tree"};
         }
@@ -380,7 +675,6 @@ machine_merkle_tree::proof_type machine_merkle_tree::get_proof(address_type targ
         // Case 2
         // We hit a page node along the path to the target node
     } else if (log2_node_size == get_log2_page_size()) {
-        assert(node);
         hash_type page_hash;
         // If target node is smaller than page size
         if (log2_target_size < get_log2_page_size()) {
@@ -397,21 +691,21 @@ machine_merkle_tree::proof_type machine_merkle_tree::get_proof(address_type targ
                 proof.set_target_hash(get_pristine_hash(log2_target_size));
             }
             // Check if hash stored in node matches what we just computed
-            if (node->hash != page_hash) {
+            if (*node_hash != page_hash) {
                 // Caller probably forgot to update the Merkle tree
                 throw std::runtime_error{"inconsistent merkle tree"};
             }
             // If target node is the page itself
         } else {
             // Simply copy hash
-            proof.set_target_hash(node->hash);
+            proof.set_target_hash(*node_hash);
         }
         // Case 3
         // We hit the target node itself
     } else {
-        assert(node && (log2_node_size == log2_target_size));
+        assert(log2_node_size == log2_target_size);
         // Copy target node hash and nothing else to do
-        proof.set_target_hash(node->hash);
+        proof.set_target_hash(*node_hash);
     }
     // Copy remaining proof values
     proof.set_target_address(target_address);
@@ -425,6 +719,151 @@ machine_merkle_tree::proof_type machine_merkle_tree::get_proof(address_type targ
     return proof;
 }
 
+void machine_merkle_tree::collect_proofs(hasher_type &h, const tree_node *node, const dense_subtree *dense,
+    uint64_t dense_index, address_type address, int log2_size, const proof_target *first, const proof_target *last,
+    std::vector<hash_type> &siblings,
+    const std::function<const unsigned char *(address_type page_address)> &get_page_data,
+    std::vector<std::optional<proof_type>> &proofs) const {
+    const auto add_proof = [&](const proof_target &target, const hash_type &target_hash) {
+        proof_type proof{get_log2_root_size(), target.log2_size};
+        for (int i = target.log2_size; i < get_log2_root_size(); ++i) {
+            proof.set_sibling_hash(siblings[i], i);
+        }
+        proof.set_target_hash(target_hash);
+        proof.set_target_address(target.address);
+        proof.set_root_hash(m_root->hash); // NOLINT: m_root can't be nullptr
+#ifndef NDEBUG
+        // Return proof only if it passes verification
+        if (!proof.verify(hasher_type{})) {
+            throw std::runtime_error{"proof failed verification"};
+        }
+#endif
+        proofs[target.index] = std::move(proof);
+    };
+    const auto get_hash = [](const tree_node *n, const dense_subtree *d, uint64_t index,
+                              int n_log2_size) -> const hash_type & {
+        if (d) {
+            return get_dense_hash(*d, index);
+        }
+        return n ? n->hash : get_pristine_hash(n_log2_size);
+    };
+    const hash_type &hash = get_hash(node, dense, dense_index, log2_size);
+    // A target for the node itself sorts before the targets inside it
+    for (; first != last && first->log2_size == log2_size; ++first) {
+        add_proof(*first, hash);
+    }
+    if (first == last) {
+        return;
+    }
+    // Remaining targets are inside the page, so compute the hashes of all nodes inside it at once
+    if (log2_size == get_log2_page_size()) {
+        // Hashes of nodes inside page, in heap order: index 1 is the page, words are at the end
+        std::vector<hash_type> page_hashes;
+        const unsigned char *page_data = get_page_data(address);
+        if (page_data) {
+            const uint64_t words = UINT64_C(1) << (get_log2_page_size() - get_log2_word_size());
+            page_hashes.resize(2 * words);
+            for (uint64_t k = 0; k < words; ++k) {
+                h.begin();
+                h.add_data(page_data + (k << get_log2_word_size()), get_word_size());
+                h.end(page_hashes[words + k]);
+            }
+            for (uint64_t k = words - 1; k > 0; --k) {
+                get_concat_hash(h, page_hashes[2 * k], page_hashes[2 * k + 1], page_hashes[k]);
+            }
+        }
+        // Check if hash stored in tree matches what we just computed
+        if (hash != (page_data ? page_hashes[1] : get_pristine_hash(get_log2_page_size()))) {
+            // Caller probably forgot to update the Merkle tree
+            throw std::runtime_error{"inconsistent merkle tree"};
+        }
+        for (; first != last; ++first) {
+            if (page_hashes.empty()) {
+                for (int i = first->log2_size; i < get_log2_page_size(); ++i) {
+                    siblings[i] = get_pristine_hash(i);
+                }
+                add_proof(*first, get_pristine_hash(first->log2_size));
+                continue;
+            }
+            const address_type offset = first->address - address;
+            for (int i = first->log2_size; i < get_log2_page_size(); ++i) {
+                const uint64_t index = (UINT64_C(1) << (get_log2_page_size() - i)) + (offset >> i);
+                siblings[i] = page_hashes[index ^ 1];
+            }
+            add_proof(*first,
+                page_hashes[(UINT64_C(1) << (get_log2_page_size() - first->log2_size)) + (offset >> first->log2_size)]);
+        }
+        return;
+    }
+    // Find both children, which may lie in the pointer tree, inside a dense subtree, or be pristine
+    const int log2_child_size = log2_size - 1;
+    std::array<const tree_node *, 2> child{};
+    const dense_subtree *child_dense = dense;
+    uint64_t child_index = 2 * dense_index;
+    if (!dense && node) {
+        if (node->dense) {
+            child_dense = node->dense;
+            child_index = 2;
+        } else {
+            child = {node->child[0], node->child[1]};
+        }
+    }
+    const address_type middle = address + (UINT64_C(1) << log2_child_size);
+    const proof_target *split =
+        std::partition_point(first, last, [middle](const proof_target &target) { return target.address < middle; });
+    if (first != split) {
+        siblings[log2_child_size] = get_hash(child[1], child_dense, child_index + 1, log2_child_size);
+        collect_proofs(h, child[0], child_dense, child_index, address, log2_child_size, first, split, siblings,
+            get_page_data, proofs);
+    }
+    if (split != last) {
+        siblings[log2_child_size] = get_hash(child[0], child_dense, child_index, log2_child_size);
+        collect_proofs(h, child[1], child_dense, child_index + 1, middle, log2_child_size, split, last, siblings,
+            get_page_data, proofs);
+    }
+}
+
+std::vector<machine_merkle_tree::proof_type> machine_merkle_tree::get_proofs(
+    const std::vector<address_type> &target_addresses, const std::vector<int> &log2_target_sizes,
+    const std::function<const unsigned char *(address_type page_address)> &get_page_data) const {
+    if (target_addresses.size() != log2_target_sizes.size()) {
+        throw std::runtime_error{"number of target addresses and sizes differ"};
+    }
+    std::vector<proof_target> targets(target_addresses.size());
+    for (size_t i = 0; i < targets.size(); ++i) {
+        const address_type target_address = target_addresses[i];
+        const int log2_target_size = log2_target_sizes[i];
+        if (log2_target_size > get_log2_root_size() || log2_target_size < get_log2_word_size()) {
+            throw std::runtime_error{"log2_target_size is out of bounds"};
+        }
+        if (target_address & ((~UINT64_C(0)) >> (get_log2_root_size() - log2_target_size))) {
+            throw std::runtime_error{"misaligned target address"};
+        }
+        targets[i] = proof_target{target_address, log2_target_size, i};
+    }
+    // Targets sharing an address are visited from the largest, which the traversal reaches first
+    std::sort(targets.begin(), targets.end(), [](const proof_target &a, const proof_target &b) {
+        if (a.address != b.address) {
+            return a.address < b.address;
+        }
+        if (a.log2_size != b.log2_size) {
+            return a.log2_size > b.log2_size;
+        }
+        return a.index < b.index;
+    });
+    std::vector<std::optional<proof_type>> proofs(targets.size());
+    std::vector<hash_type> siblings(get_log2_root_size());
+    hasher_type h;
+    collect_proofs(h, m_root, nullptr, 0, 0, get_log2_root_size(), targets.data(), targets.data() + targets.size(),
+        siblings, get_page_data, proofs);
+    std::vector<proof_type> result;
+    result.reserve(proofs.size());
+    for (auto &proof : proofs) {
+        result.push_back(std::move(proof).value());
+    }
+    return result;
+}
+
 std::ostream &operator<<(std::ostream &out, const machine_merkle_tree::hash_type &hash) {
     auto f = out.flags();
     for (const unsigned b : hash) {
@@ -21,10 +21,15 @@
 /// \brief Merkle tree interface.
 
 #include <array>
+#include <atomic>
 #include <cstdint>
-#include <deque>
+#include <functional>
 #include <iosfwd>
+#include <map>
+#include <memory>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
 #include "keccak-256-hasher.h"
 #include "merkle-tree-proof.h"
@@ -51,6 +56,12 @@ namespace cartesi {
 /// bits of address space.
 /// Tree leaves contain Keccak-256 hashes of individual words.
 ///
+/// Address ranges registered with machine_merkle_tree#add_dense_subtree
+/// (typically, large memory PMAs) are not represented by pointer nodes.
+/// Instead, all nodes from the range root down to its pages are stored
+/// in a single array, in heap order. The sparse pointer tree is only used
+/// above these ranges and for pages that fall outside of them.
+///
 /// Tree contents are updated page-by-page using calls to
 /// machine_merkle_tree#begin_update, machine_merkle_tree#update_page, ...,
 /// machine_merkle_tree#update_page, machine_merkle_tree#end_update.
@@ -127,17 +138,43 @@ private:
     /// \details A node is known to be an inner-node or a page-node implicitly
     /// based on its height in the tree.
     //??D This is assumed to be a POD type in the implementation
+    struct dense_subtree;
     struct tree_node {
         hash_type hash;                   ///< Hash of subintended data.
         tree_node *parent;                ///< Pointer to parent node (nullptr for root).
         std::array<tree_node *, 2> child; ///< Children nodes.
         uint64_t mark;                    ///< Helper for traversal algorithms.
+        dense_subtree *dense;             ///< Dense subtree rooted at node (nullptr if none).
+    };
+
+    /// \brief Subtree stored as an implicit array of hashes.
+    /// \details Node i has children 2i and 2i+1. The subtree root is at index 1,
+    /// and its page nodes are at indices [2<sup>depth</sup>, 2<sup>depth+1</sup>).
+    /// The array is allocated zeroed, and the OS only backs the parts of large arrays that were written.
+    /// Entries that were never written are zero, and stand for the pristine hash of their level.
+    struct dense_subtree {
+        address_type start;          ///< Start of range subintended by subtree.
+        int log2_size;               ///< log<sub>2</sub> of size subintended by subtree.
+        hash_type *hashes;           ///< Node hashes in heap order (index 0 is unused).
+        std::vector<uint64_t> dirty; ///< Indices of inner nodes that must be updated.
+        tree_node *node;             ///< Pointer-tree node that mirrors the subtree root.
+
+        dense_subtree(void) = default;
+        dense_subtree(const dense_subtree &) = delete;
+        dense_subtree &operator=(const dense_subtree &) = delete;
+        dense_subtree(dense_subtree &&) = delete;
+        dense_subtree &operator=(dense_subtree &&) = delete;
+        ~dense_subtree();
     };
 
     // Sparse map from virtual page index to the
     // corresponding page node in the Merkle tree.
     std::unordered_map<address_type, tree_node *> m_page_node_map;
 
+    // Dense subtrees keyed by start address, and the last one hit by an update.
+    std::map<address_type, std::unique_ptr<dense_subtree>> m_dense_subtrees;
+    dense_subtree *m_last_dense;
+
     // Root of the Merkle tree.
     tree_node m_root_storage;
     tree_node *m_root;
@@ -146,8 +183,9 @@ private:
     // bottom up in breadth to propagate changes from dirty
     // pages all the way up to the tree root.
     uint64_t m_merkle_update_nonce;
-    // FIFO to process pages in bottom-up order.
-    std::deque<std::pair<int, tree_node *>> m_merkle_update_fifo;
+    // Inner nodes pending update, bucketed by log2_size, so children
+    // are always processed before their parents.
+    std::array<std::vector<tree_node *>, LOG2_ROOT_SIZE + 1> m_merkle_update_levels;
 
     // For statistics.
 #ifdef MERKLE_DUMP_STATS
@@ -175,6 +213,44 @@ private:
     /// Maps new node to the page index.
     tree_node *new_page_node(address_type page_index);
 
+    /// \brief Enqueues the parent of a node for update, unless it is already enqueued.
+    /// \param node Node whose parent changed.
+    /// \param log2_size log<sub>2</sub> of size subintended by \p node.
+    void enqueue_parent(tree_node *node, int log2_size);
+
+    /// \brief Returns the dense subtree containing a page, if any.
+    /// \param page_index Page index.
+    /// \return Pointer to dense subtree, or nullptr if page is not in any.
+    dense_subtree *get_dense_subtree(address_type page_index) const;
+
+    /// \brief Returns the hash of a node in a dense subtree.
+    /// \param d Dense subtree.
+    /// \param index Index of node in dense subtree.
+    /// \return Reference to hash stored in subtree, or to pristine hash if entry was never written.
+    static const hash_type &get_dense_hash(const dense_subtree &d, uint64_t index);
+
+    /// \brief Propagates pending changes in a dense subtree up to its root.
+    /// \param h Hasher object.
+    /// \param d Dense subtree.
+    static void update_dense_subtree(hasher_type &h, dense_subtree &d);
+
+    /// \brief Verifies a run of inner nodes in a dense subtree.
+    /// \param h Hasher object.
+    /// \param d Dense subtree.
+    /// \param first Index of first inner node to verify.
+    /// \param last Index of one past last inner node to verify.
+    /// \param failed Set by any thread that finds a mismatch, so the others can stop early.
+    /// \returns True if nodes are consistent, false otherwise.
+    static bool verify_dense_subtree(hasher_type &h, const dense_subtree &d, uint64_t first, uint64_t last,
+        std::atomic<bool> &failed);
+
+    /// \brief Dumps part of a dense subtree to std::cerr.
+    /// \param d Dense subtree.
+    /// \param index Index of node in dense subtree.
+    /// \param address start of range subintended by node.
+    /// \param log2_size log<sub>2</sub> of size of range subintended by node.
+    void dump_dense_subtree(const dense_subtree &d, uint64_t index, uint64_t address, int log2_size) const;
+
     /// \brief Updates an inner node hash from its children.
     /// \param h Hasher object.
     /// \param log2_size log<sub>2</sub> of size subintended by node.
@@ -214,8 +290,9 @@ private:
     /// \param h Hasher object.
     /// \param node Root of subtree.
     /// \param  log2_size log<sub>2</sub> of size subintended by \p node.
+    /// \param failed Set by any thread that finds a mismatch, so the others can stop early.
     /// \returns True if tree is consistent, false otherwise.
-    bool verify_tree(hasher_type &h, tree_node *node, int log2_size) const;
+    bool verify_tree(hasher_type &h, tree_node *node, int log2_size, std::atomic<bool> &failed) const;
 
     /// \brief Computes the page index for a memory address.
     /// \param address Memory address.
@@ -272,6 +349,31 @@ private:
     void get_inside_page_sibling_hashes(address_type address, int log2_size, hash_type &hash,
         const unsigned char *page_data, hash_type &page_hash, proof_type &proof) const;
 
+    /// \brief Target node of get_proofs().
+    struct proof_target {
+        address_type address; ///< Address of target node.
+        int log2_size;        ///< log<sub>2</sub> of size subintended by target node.
+        size_t index;         ///< Position of target node, and of its proof, in the request.
+    };
+
+    /// \brief Collects the proofs for all target nodes inside a node, descending towards them together.
+    /// \param h Hasher object.
+    /// \param node Node in the pointer tree, or nullptr if inside a dense subtree or pristine.
+    /// \param dense Dense subtree holding the node, or nullptr if none.
+    /// \param dense_index Index of the node in \p dense.
+    /// \param address Start of range subintended by node.
+    /// \param log2_size log<sub>2</sub> of size subintended by node.
+    /// \param first First target inside node. Targets are sorted by address, then by decreasing size.
+    /// \param last One past last target inside node.
+    /// \param siblings Sibling hashes along the path from the root to node, indexed by log<sub>2</sub> of size.
+    /// \param get_page_data See get_proofs().
+    /// \param proofs Receives the proof for each target, at its position in the request.
+    void collect_proofs(hasher_type &h, const tree_node *node, const dense_subtree *dense, uint64_t dense_index,
+        address_type address, int log2_size, const proof_target *first, const proof_target *last,
+        std::vector<hash_type> &siblings,
+        const std::function<const unsigned char *(address_type page_address)> &get_page_data,
+        std::vector<std::optional<proof_type>> &proofs) const;
+
     // Precomputed hashes of spans of zero bytes with
     // increasing power-of-two sizes, from 2^LOG2_WORD_SIZE
     // to 2^LOG2_ROOT_SIZE bytes.
@@ -279,8 +381,11 @@ private:
 
 public:
     /// \brief Verifies the entire Merkle tree.
+    /// \param concurrency Number of threads to use, or 0 to use all host threads.
     /// \return True if tree is consistent, false otherwise.
-    bool verify_tree(void) const;
+    /// \details The tree is split into subtrees, and runs of nodes within dense subtrees,
+    /// that are verified in parallel. All threads stop at the first mismatch.
+    bool verify_tree(uint64_t concurrency = 0) const;
 
     /// \brief Default constructor.
     /// \details Initializes memory to zero.
@@ -303,6 +408,17 @@ public:
     /// \param hash Receives the hash.
     void get_root_hash(hash_type &hash) const;
 
+    /// \brief Stores an address range as a dense subtree.
+    /// \param start Start of range. Must be aligned to a 2<sup>log2_size</sup> boundary.
+    /// \param log2_size log<sub>2</sub> of size of range. Must be at least LOG2_PAGE_SIZE
+    /// and smaller than LOG2_ROOT_SIZE.
+    /// \returns True if succeeded, false if the range overlaps pages or dense
+    /// subtrees already in the tree, or if the host cannot map memory lazily
+    /// (in which case the range stays sparse).
+    /// \details Must be called before any page in the range is updated.
+    /// Pages in the range start pristine.
+    bool add_dense_subtree(address_type start, int log2_size);
+
     /// \brief Start tree update.
     /// \returns True.
     /// \details This method is not thread safe, so be careful when using
@@ -336,6 +452,19 @@ public:
     /// \returns Proof if successful, otherwise throws exception.
     proof_type get_proof(address_type target_address, int log2_target_size, const unsigned char *page_data) const;
 
+    /// \brief Returns the proofs for several nodes in the tree.
+    /// \param target_addresses Address of each target node.
+    /// \param log2_target_sizes log<sub>2</sub> of size subintended by each target node.
+    /// \param get_page_data Returns a pointer to the start of contiguous data for a page,
+    /// or nullptr if the page is pristine. It is called once for each page containing
+    /// target nodes smaller than LOG2_PAGE_SIZE, and the pointer is only used until the next call.
+    /// \returns Proofs for each target node, in the same order, if successful, otherwise throws exception.
+    /// \details Targets are visited in a single top-down traversal in address order, so nodes and sibling
+    /// hashes shared by their paths are fetched once, and the hashes of nodes inside each page are computed once.
+    std::vector<proof_type> get_proofs(const std::vector<address_type> &target_addresses,
+        const std::vector<int> &log2_target_sizes,
+        const std::function<const unsigned char *(address_type page_address)> &get_page_data) const;
+
     /// \brief Recursively builds hash for page node from contiguous memory.
     /// \param h Hasher object.
     /// \param page_data Pointer to start of contiguous page data.
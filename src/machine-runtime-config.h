@@ -27,6 +27,8 @@ namespace cartesi {
 /// \brief Concurrency runtime configuration
 struct concurrency_runtime_config {
     uint64_t update_merkle_tree{};
+    uint64_t background_merkle_tree_interval{}; ///< Cycles between background Merkle tree updates in run() (0 disables)
+    uint64_t images{};                          ///< Threads storing and loading memory images
 };
 
 /// \brief HTIF runtime configuration
@@ -42,6 +44,15 @@ struct machine_runtime_config {
     bool skip_root_hash_store{};
     bool skip_version_check{};
     bool soft_yield{};
+    bool use_page_hashes{}; ///< Store page hashes next to memory images, and install them when loading
+    bool reclaim_pristine_pages{}; ///< Return host memory of pristine pages found while updating the Merkle tree
+    /// \brief Track writes with host soft-dirty bits, when available
+    /// \details Applies to every memory range backed by host memory; there is no per-range selection.
+    /// The bits are process-wide, so only the first machine in the process that asks for them gets them.
+    bool soft_dirty_tracking{};
+    bool huge_pages{};             ///< Back anonymous memory ranges with transparent huge pages, when available
+    bool compress_images{};        ///< Store memory images compressed, in chunks that are processed in parallel
+    bool copy_images{};            ///< Read memory images into memory instead of mapping them privately
 };
 
 /// \brief CONCURRENCY constants
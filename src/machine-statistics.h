@@ -56,6 +56,9 @@ struct machine_statistics {
     uint64_t tlb_flush_fence_vma_asid;       ///< Counts TLB flush originated from SFENCE.VMA (asid)
     uint64_t tlb_flush_fence_vma_vaddr;      ///< Counts TLB flush originated from SFENCE.VMA (vaddr)
     uint64_t tlb_flush_fence_vma_asid_vaddr; ///< Counts TLB flush originated originated from SFENCE.VMA (vaddr,asid)
+    uint64_t tlb_wpage_unchanged;            ///< Counts write TLB pages found unchanged since last Merkle tree update
+    uint64_t tlb_wpage_dirty;                ///< Counts write TLB pages marked dirty for Merkle tree update
+    uint64_t tlb_wpage_copied;               ///< Counts write TLB pages copied after Merkle tree update
 };
 
 #ifdef DUMP_COUNTERS
@@ -16,17 +16,24 @@
 
 #include "machine.h"
 
+#include <atomic>
 #include <boost/range/adaptor/sliced.hpp>
 #include <cstdio>
 #include <cstring>
+#include <filesystem>
 #include <iomanip>
 #include <iostream>
+#include <map>
 
 #include "clint-factory.h"
+#include "compressed-image.h"
 #include "dtb.h"
 #include "htif-factory.h"
 #include "htif.h"
 #include "interpret.h"
+#include "is-pristine.h"
+#include "machine-file.h"
+#include "machine-statistics.h"
 #include "plic-factory.h"
 #include "record-state-access.h"
 #include "replay-state-access.h"
@@ -178,6 +185,32 @@ pma_entry &machine::register_pma_entry(pma_entry &&pma) {
     return m_s.pmas.back();
 }
 
+/// \brief Marks as clean the pages of a memory range that fall in holes of its image file, or past its end
+/// \param pma Memory range loaded from image file
+/// \param image_filename Path to image file (nothing is done if empty)
+/// \details These pages are zero, so they are neither read nor hashed. This is only valid while
+/// the Merkle tree still holds pristine hashes for the range, i.e., when the machine is being created.
+static void mark_image_holes_clean(pma_entry &pma, const std::string &image_filename) {
+    if (image_filename.empty()) {
+        return;
+    }
+    std::vector<std::pair<uint64_t, uint64_t>> extents;
+    if (!os_get_file_data_extents(image_filename.c_str(), pma.get_length(),
+            [&extents](uint64_t offset, uint64_t length) { extents.emplace_back(offset, length); })) {
+        return;
+    }
+    extents.emplace_back(pma.get_length(), 0);
+    uint64_t hole_start = 0;
+    for (const auto &[offset, length] : extents) {
+        // Only pages entirely inside the hole are known to be zero
+        const uint64_t first = (hole_start + PMA_PAGE_SIZE - 1) & ~(PMA_PAGE_SIZE - 1);
+        for (uint64_t page = first; page + PMA_PAGE_SIZE <= offset; page += PMA_PAGE_SIZE) {
+            pma.mark_clean_page(page);
+        }
+        hole_start = offset + length;
+    }
+}
+
 static bool DID_is_protected(PMA_ISTART_DID DID) {
     switch (DID) {
         case PMA_ISTART_DID::flash_drive:
@@ -191,15 +224,48 @@ static bool DID_is_protected(PMA_ISTART_DID DID) {
     }
 }
 
-void machine::replace_memory_range(const memory_range_config &range) {
+/// \brief Reads a file with one page hash per page of a memory range
+/// \param filename Name of file
+/// \param length Length of memory range
+/// \returns Page hashes
+static std::vector<machine::hash_type> read_page_hashes(const std::string &filename, uint64_t length) {
+    const uint64_t pages = (length + PMA_PAGE_SIZE - 1) / PMA_PAGE_SIZE;
+    std::vector<machine::hash_type> hashes(pages);
+    auto fp = unique_fopen(filename.c_str(), "rb");
+    if (fread(hashes.data(), sizeof(machine::hash_type), pages, fp.get()) != pages || fgetc(fp.get()) != EOF) {
+        throw std::runtime_error{"page hashes in '" + filename + "' do not match memory range"};
+    }
+    return hashes;
+}
+
+void machine::replace_memory_range(const memory_range_config &range, const std::string &page_hashes_filename) {
+    if (m_snapshot) {
+        throw std::runtime_error{"cannot replace memory ranges while a snapshot is pending"};
+    }
+    if (!finish_background_merkle_update()) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
     for (auto &pma : m_s.pmas) {
         if (pma.get_start() == range.start && pma.get_length() == range.length) {
             const auto curr = pma.get_istart_DID();
             if (DID_is_protected(curr)) {
                 throw std::invalid_argument{"attempt to replace a protected range "s + pma.get_description()};
             }
-            // replace range preserving original flags
+            // read page hashes before touching the range, so a bad file leaves the machine unchanged
+            std::vector<hash_type> hashes;
+            if (!page_hashes_filename.empty()) {
+                hashes = read_page_hashes(page_hashes_filename, range.length);
+            }
+            // replace range preserving original flags and dirty page tracking
+            const bool soft_dirty = pma.is_soft_dirty_tracked();
             pma = make_memory_range_pma_entry(pma.get_description(), range).set_flags(pma.get_flags());
+            pma.set_soft_dirty_tracked(soft_dirty && pma.get_memory().get_host_memory());
+            if (m_r.huge_pages) {
+                pma.get_memory().advise_huge_pages();
+            }
+            if (!hashes.empty()) {
+                install_page_hashes(pma, hashes);
+            }
             return;
         }
     }
@@ -326,15 +392,20 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) :
     if (m_c.ram.image_filename.empty()) {
         register_pma_entry(make_callocd_memory_pma_entry("RAM"s, PMA_RAM_START, m_c.ram.length).set_flags(m_ram_flags));
     } else {
-        register_pma_entry(make_callocd_memory_pma_entry("RAM"s, PMA_RAM_START, m_c.ram.length, m_c.ram.image_filename)
-                               .set_flags(m_ram_flags));
+        pma_entry &ram = register_pma_entry(
+            make_callocd_memory_pma_entry("RAM"s, PMA_RAM_START, m_c.ram.length, m_c.ram.image_filename,
+                !m_r.copy_images)
+                .set_flags(m_ram_flags));
+        mark_image_holes_clean(ram, m_c.ram.image_filename);
     }
 
     // Register DTB
     pma_entry &dtb = register_pma_entry((m_c.dtb.image_filename.empty() ?
             make_callocd_memory_pma_entry("DTB"s, PMA_DTB_START, PMA_DTB_LENGTH) :
-            make_callocd_memory_pma_entry("DTB"s, PMA_DTB_START, PMA_DTB_LENGTH, m_c.dtb.image_filename))
+            make_callocd_memory_pma_entry("DTB"s, PMA_DTB_START, PMA_DTB_LENGTH, m_c.dtb.image_filename,
+                !m_r.copy_images))
                                             .set_flags(m_dtb_flags));
+    mark_image_holes_clean(dtb, m_c.dtb.image_filename);
 
     // Register all flash drives
     int i = 0;
@@ -356,12 +427,15 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) :
             }
             f.length = length;
         }
-        register_pma_entry(make_flash_drive_pma_entry(flash_description, f));
+        mark_image_holes_clean(register_pma_entry(make_flash_drive_pma_entry(flash_description, f)),
+            f.image_filename);
     }
 
     // Register cmio memory ranges
-    register_pma_entry(make_cmio_tx_buffer_pma_entry(m_c.cmio));
-    register_pma_entry(make_cmio_rx_buffer_pma_entry(m_c.cmio));
+    mark_image_holes_clean(register_pma_entry(make_cmio_tx_buffer_pma_entry(m_c.cmio)),
+        m_c.cmio.tx_buffer.image_filename);
+    mark_image_holes_clean(register_pma_entry(make_cmio_rx_buffer_pma_entry(m_c.cmio)),
+        m_c.cmio.rx_buffer.image_filename);
 
     // Register HTIF device
     register_pma_entry(make_htif_pma_entry(PMA_HTIF_START, PMA_HTIF_LENGTH, &m_r.htif));
@@ -475,6 +549,9 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) :
     // Last, add sentinel
     m_pmas.push_back(&m_s.empty_pma);
 
+    // Store large memory ranges as dense subtrees in the Merkle tree
+    add_dense_merkle_subtrees();
+
     // Initialize TLB device
     // this must be done after all PMA entries are already registered, so we can lookup page addresses
     if (!m_c.tlb.image_filename.empty()) {
@@ -517,6 +594,26 @@ machine::machine(const machine_config &c, const machine_runtime_config &r) :
     // when calling write() on closed file descriptors.
     // This can happen with the stdout console file descriptors or network file descriptors.
     os_disable_sigpipe();
+
+    // Back memory ranges with huge pages, if the host lets us
+    if (m_r.huge_pages) {
+        for (auto &pma : m_s.pmas) {
+            if (pma.get_istart_M()) {
+                pma.get_memory().advise_huge_pages();
+            }
+        }
+    }
+
+    // Track writes to memory ranges with soft-dirty bits, if the host lets us.
+    // This must come last, since the destructor is responsible for giving them up.
+    if (m_r.soft_dirty_tracking && os_soft_dirty_acquire()) {
+        m_soft_dirty = true;
+        for (auto &pma : m_s.pmas) {
+            if (pma.get_istart_M() && pma.get_memory().get_host_memory()) {
+                pma.set_soft_dirty_tracked(true);
+            }
+        }
+    }
 }
 
 static void load_hash(const std::string &dir, machine::hash_type &h) {
@@ -528,12 +625,34 @@ static void load_hash(const std::string &dir, machine::hash_type &h) {
 }
 
 machine::machine(const std::string &dir, const machine_runtime_config &r) : machine{machine_config::load(dir), r} {
-    if (r.skip_root_hash_check) {
-        return;
-    }
     hash_type hstored;
+    if (is_machine_file(dir)) {
+        const bool has_root_hash = load_file(dir, hstored);
+        if (r.skip_root_hash_check) {
+            return;
+        }
+        if (!has_root_hash) {
+            throw std::runtime_error{"no root hash stored in '" + dir + "'"};
+        }
+    } else {
+        // Checking the root hash reads all images, so the host reads them ahead while earlier pages are hashed
+        if (!r.skip_root_hash_check && !r.use_page_hashes) {
+            for (auto *pma : m_pmas) {
+                if (pma->get_istart_M()) {
+                    (void) pma->get_memory().advise_will_need();
+                }
+            }
+        }
+        load_memory_images(dir);
+        if (r.use_page_hashes) {
+            load_page_hashes(dir);
+        }
+        if (r.skip_root_hash_check) {
+            return;
+        }
+        load_hash(dir, hstored);
+    }
     hash_type hrestored;
-    load_hash(dir, hstored);
     if (!update_merkle_tree()) {
         throw std::runtime_error{"error updating Merkle tree"};
     }
@@ -582,6 +701,10 @@ machine_config machine::get_serialization_config(void) const {
     if (read_iunrep()) {
         throw std::runtime_error{"cannot serialize configuration of unreproducible machines"};
     }
+    return get_state_config();
+}
+
+machine_config machine::get_state_config(void) const {
     // Initialize with copy of original config
     machine_config c = m_c;
     // Copy current processor state to config
@@ -657,40 +780,127 @@ machine_config machine::get_serialization_config(void) const {
     return c;
 }
 
-static void store_device_pma(const machine &m, const pma_entry &pma, const std::string &dir) {
+/// \brief Reads the contents of a device PMA through its peek function
+static std::vector<unsigned char> peek_device_pma(const machine &m, const pma_entry &pma) {
     if (!pma.get_istart_IO()) {
         throw std::runtime_error{"attempt to save non-device PMA"};
     }
-    auto scratch = unique_calloc<unsigned char>(PMA_PAGE_SIZE); // will throw if it fails
-    auto name = machine_config::get_image_filename(dir, pma.get_start(), pma.get_length());
-    auto fp = unique_fopen(name.c_str(), "wb");
+    std::vector<unsigned char> data(pma.get_length());
+    auto peek = pma.get_peek();
     for (uint64_t page_start_in_range = 0; page_start_in_range < pma.get_length();
          page_start_in_range += PMA_PAGE_SIZE) {
+        unsigned char *scratch = data.data() + page_start_in_range;
         const unsigned char *page_data = nullptr;
-        auto peek = pma.get_peek();
-        if (!peek(pma, m, page_start_in_range, &page_data, scratch.get())) {
+        if (!peek(pma, m, page_start_in_range, &page_data, scratch)) {
             throw std::runtime_error{"peek failed"};
-        } else {
-            if (!page_data) {
-                memset(scratch.get(), 0, PMA_PAGE_SIZE);
-                page_data = scratch.get();
-            }
-            if (fwrite(page_data, 1, PMA_PAGE_SIZE, fp.get()) != PMA_PAGE_SIZE) {
-                throw std::system_error{errno, std::generic_category(), "error writing to '" + name + "'"};
-            }
+        }
+        if (!page_data) {
+            memset(scratch, 0, PMA_PAGE_SIZE);
+        } else if (page_data != scratch) {
+            memcpy(scratch, page_data, PMA_PAGE_SIZE);
         }
     }
+    return data;
 }
 
-static void store_memory_pma(const pma_entry &pma, const std::string &dir) {
-    if (!pma.get_istart_M()) {
-        throw std::runtime_error{"attempt to save non-memory PMA"};
-    }
+static uint64_t get_task_concurrency(uint64_t value) {
+    const uint64_t concurrency = value > 0 ? value : std::max(os_get_concurrency(), UINT64_C(1));
+    return std::min(concurrency, static_cast<uint64_t>(THREADS_MAX));
+}
+
+static void store_device_pma(const machine &m, const pma_entry &pma, const std::string &dir) {
+    const auto data = peek_device_pma(m, pma);
     auto name = machine_config::get_image_filename(dir, pma.get_start(), pma.get_length());
     auto fp = unique_fopen(name.c_str(), "wb");
-    const pma_memory &mem = pma.get_memory();
-    if (fwrite(mem.get_host_memory(), 1, pma.get_length(), fp.get()) != pma.get_length()) {
-        throw std::runtime_error{"error writing to '" + name + "'"};
+    if (fwrite(data.data(), 1, data.size(), fp.get()) != data.size()) {
+        throw std::system_error{errno, std::generic_category(), "error writing to '" + name + "'"};
+    }
+}
+
+/// \brief Length of the chunks of memory images written by each task in store_memory_pmas()
+static constexpr uint64_t STORE_IMAGE_CHUNK_SIZE = UINT64_C(1) << 22;
+
+void machine::store_memory_pmas(const std::vector<const pma_entry *> &pmas, const std::string &dir,
+    bool merkle_tree_updated) const {
+    // Images are created at full length up front, so pristine pages are holes, and then all of their chunks
+    // are written concurrently
+    struct image_chunk {
+        const pma_entry *pma; ///< Memory PMA
+        size_t image;         ///< Index of image in names and files
+        uint64_t offset;      ///< Offset of chunk in PMA
+    };
+    std::vector<std::string> names;
+    std::vector<unique_file_ptr> files;
+    std::vector<image_chunk> chunks;
+    for (const auto *pma : pmas) {
+        if (!pma->get_istart_M()) {
+            throw std::runtime_error{"attempt to save non-memory PMA"};
+        }
+        names.push_back(machine_config::get_image_filename(dir, pma->get_start(), pma->get_length()));
+        files.push_back(unique_fopen(names.back().c_str(), "wb"));
+        std::error_code ec;
+        std::filesystem::resize_file(names.back(), pma->get_length(), ec);
+        if (ec) {
+            throw std::system_error{ec, "error writing to '" + names.back() + "'"};
+        }
+        for (uint64_t offset = 0; offset < pma->get_length(); offset += STORE_IMAGE_CHUNK_SIZE) {
+            chunks.push_back(image_chunk{pma, files.size() - 1, offset});
+        }
+    }
+    const auto &pristine_page_hash = machine_merkle_tree::get_pristine_hash(machine_merkle_tree::get_log2_page_size());
+    // Chunks that are mostly pristine take much less time, so tasks take the next chunk as they finish
+    std::atomic<uint64_t> next_chunk{0};
+    int error = 0;
+    size_t failed_image = 0;
+    const bool succeeded = os_parallel_for(get_task_concurrency(m_r.concurrency.images),
+        [&](uint64_t, const parallel_for_mutex &mutex) -> bool {
+            for (uint64_t i = next_chunk++; i < chunks.size(); i = next_chunk++) {
+                const auto &chunk = chunks[i];
+                const unsigned char *host_memory = chunk.pma->get_memory().get_host_memory();
+                const uint64_t chunk_end = std::min(chunk.offset + STORE_IMAGE_CHUNK_SIZE, chunk.pma->get_length());
+                // Runs of non-pristine pages are written at once
+                uint64_t run_start = chunk.offset;
+                uint64_t run_end = chunk.offset;
+                const auto write_run = [&]() {
+                    if (run_start == run_end ||
+                        os_write_at(files[chunk.image].get(), host_memory + run_start, run_end - run_start,
+                            run_start)) {
+                        return true;
+                    }
+                    const parallel_for_mutex_guard lock(mutex);
+                    error = errno;
+                    failed_image = chunk.image;
+                    return false;
+                };
+                for (uint64_t offset = chunk.offset; offset < chunk_end; offset += PMA_PAGE_SIZE) {
+                    const uint64_t length = std::min<uint64_t>(PMA_PAGE_SIZE, chunk_end - offset);
+                    bool pristine = false;
+                    // Hashes in an up to date Merkle tree tell pristine pages apart without reading them,
+                    // unless they were installed and not yet checked against the data
+                    if (merkle_tree_updated && length == PMA_PAGE_SIZE && !chunk.pma->is_page_unverified(offset)) {
+                        hash_type hash;
+                        m_t.get_page_node_hash(chunk.pma->get_start() + offset, hash);
+                        pristine = hash == pristine_page_hash;
+                    } else {
+                        pristine = is_pristine(host_memory + offset, length);
+                    }
+                    if (pristine) {
+                        if (!write_run()) {
+                            return false;
+                        }
+                        run_start = run_end = offset + length;
+                    } else {
+                        run_end = offset + length;
+                    }
+                }
+                if (!write_run()) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    if (!succeeded) {
+        throw std::system_error{error, std::generic_category(), "error writing to '" + names[failed_image] + "'"};
     }
 }
 
@@ -738,23 +948,197 @@ static inline T &deref(T *t) {
     return *t;
 }
 
-void machine::store_pmas(const machine_config &c, const std::string &dir) const {
+void machine::store_memory_pma_delta(const pma_entry &pma, const std::string &dir, const std::string &base_dir) const {
+    if (!pma.get_istart_M()) {
+        throw std::runtime_error{"attempt to save non-memory PMA"};
+    }
+    // Compare against the page hashes of the base, or against its image if it has none
+    std::vector<hash_type> base_hashes;
+    unique_file_ptr base_image;
+    auto hashes_name = machine_config::get_page_hashes_filename(base_dir, pma.get_start(), pma.get_length());
+    if (unique_fopen(hashes_name.c_str(), "rb", std::nothrow_t{})) {
+        base_hashes = read_page_hashes(hashes_name, pma.get_length());
+    } else {
+        auto image_name = machine_config::get_image_filename(base_dir, pma.get_start(), pma.get_length());
+        base_image = unique_fopen(image_name.c_str(), "rb", std::nothrow_t{});
+        if (!base_image) {
+            throw std::runtime_error{"base machine in '" + base_dir + "' has neither image nor page hashes for " +
+                pma.get_description()};
+        }
+    }
+    std::vector<unsigned char> base_page(base_image ? PMA_PAGE_SIZE : 0);
+    auto name = machine_config::get_delta_filename(dir, pma.get_start(), pma.get_length());
+    auto fp = unique_fopen(name.c_str(), "wb");
+    const unsigned char *host_memory = pma.get_memory().get_host_memory();
+    // Each page that differs is stored as its offset within the PMA followed by its data
+    for (uint64_t offset = 0; offset < pma.get_length(); offset += PMA_PAGE_SIZE) {
+        const unsigned char *page = host_memory + offset;
+        bool changed = true;
+        if (!base_hashes.empty()) {
+            hash_type hash;
+            m_t.get_page_node_hash(pma.get_start() + offset, hash);
+            changed = hash != base_hashes[offset / PMA_PAGE_SIZE];
+        } else {
+            changed = fread(base_page.data(), 1, PMA_PAGE_SIZE, base_image.get()) != PMA_PAGE_SIZE ||
+                memcmp(base_page.data(), page, PMA_PAGE_SIZE) != 0;
+        }
+        if (!changed) {
+            continue;
+        }
+        if (fwrite(&offset, sizeof(offset), 1, fp.get()) != 1 ||
+            fwrite(page, 1, PMA_PAGE_SIZE, fp.get()) != PMA_PAGE_SIZE) {
+            throw std::system_error{errno, std::generic_category(), "error writing to '" + name + "'"};
+        }
+    }
+}
+
+static void load_memory_pma_delta(pma_entry &pma, const std::string &name) {
+    auto fp = unique_fopen(name.c_str(), "rb");
+    unsigned char *host_memory = pma.get_memory().get_host_memory();
+    uint64_t offset = 0;
+    size_t read = 0;
+    while ((read = fread(&offset, 1, sizeof(offset), fp.get())) == sizeof(offset)) {
+        if (offset % PMA_PAGE_SIZE != 0 || offset >= pma.get_length() ||
+            fread(host_memory + offset, 1, PMA_PAGE_SIZE, fp.get()) != PMA_PAGE_SIZE) {
+            throw std::runtime_error{"corrupt delta in '" + name + "'"};
+        }
+        pma.mark_dirty_page(offset);
+    }
+    if (ferror(fp.get())) {
+        throw std::system_error{errno, std::generic_category(), "error reading from '" + name + "'"};
+    }
+    if (read != 0) {
+        throw std::runtime_error{"corrupt delta in '" + name + "'"};
+    }
+}
+
+void machine::load_memory_images(const std::string &dir) {
+    for (auto *pma : m_pmas) {
+        if (!pma->get_istart_M()) {
+            continue;
+        }
+        // Collect the deltas stored over the image the PMA was loaded from
+        std::vector<std::string> deltas;
+        for (auto d = dir; !d.empty(); d = machine_config::load_base_directory(d)) {
+            auto image_name = machine_config::get_image_filename(d, pma->get_start(), pma->get_length());
+            if (unique_fopen(image_name.c_str(), "rb", std::nothrow_t{})) {
+                break;
+            }
+            // Compressed images were left out of the config, so the range is still zeroed
+            image_name = machine_config::get_compressed_image_filename(d, pma->get_start(), pma->get_length());
+            if (unique_fopen(image_name.c_str(), "rb", std::nothrow_t{})) {
+                load_compressed_image(image_name, pma->get_memory().get_host_memory(), pma->get_length(),
+                    get_task_concurrency(m_r.concurrency.images), [pma](uint64_t offset, uint64_t length) {
+                        // The Merkle tree still holds the pristine hash for these pages
+                        for (uint64_t page = 0; page < length; page += PMA_PAGE_SIZE) {
+                            pma->mark_clean_page(offset + page);
+                        }
+                    });
+                break;
+            }
+            auto name = machine_config::get_delta_filename(d, pma->get_start(), pma->get_length());
+            if (unique_fopen(name.c_str(), "rb", std::nothrow_t{})) {
+                deltas.push_back(std::move(name));
+            }
+        }
+        for (auto it = deltas.rbegin(); it != deltas.rend(); ++it) {
+            load_memory_pma_delta(*pma, *it);
+        }
+    }
+}
+
+void machine::store_pmas(const machine_config &c, const std::string &dir, const std::string &base_dir,
+    bool merkle_tree_updated) const {
     if (read_iunrep()) {
         throw std::runtime_error{"cannot store PMAs of unreproducible machines"};
     }
-    store_memory_pma(find_pma_entry<uint64_t>(PMA_DTB_START), dir);
-    store_memory_pma(find_pma_entry<uint64_t>(PMA_RAM_START), dir);
+    // Full images are written together at the end, so they can be written concurrently.
+    // The DTB and the uarch RAM are filled in by the constructor when they have no image, so they are never
+    // compressed.
+    std::vector<const pma_entry *> full_images;
+    const auto store_memory = [&](const pma_entry &pma, bool shared, bool compressible) {
+        // Shared ranges are always stored in full, since loading maps their image for writing
+        if (shared) {
+            full_images.push_back(&pma);
+        } else if (!base_dir.empty()) {
+            store_memory_pma_delta(pma, dir, base_dir);
+        } else if (m_r.compress_images && compressible) {
+            store_compressed_image(
+                machine_config::get_compressed_image_filename(dir, pma.get_start(), pma.get_length()),
+                pma.get_memory().get_host_memory(), pma.get_length(), get_task_concurrency(m_r.concurrency.images));
+        } else {
+            full_images.push_back(&pma);
+        }
+    };
+    store_memory(find_pma_entry<uint64_t>(PMA_DTB_START), false, false);
+    store_memory(find_pma_entry<uint64_t>(PMA_RAM_START), false, true);
     store_device_pma(*this, find_pma_entry<uint64_t>(PMA_SHADOW_TLB_START), dir);
     // Could iterate over PMAs checking for those with a drive DID
     // but this is easier
     for (const auto &f : c.flash_drive) {
-        store_memory_pma(find_pma_entry<uint64_t>(f.start), dir);
+        store_memory(find_pma_entry<uint64_t>(f.start), f.shared, true);
     }
-    store_memory_pma(find_pma_entry<uint64_t>(PMA_CMIO_RX_BUFFER_START), dir);
-    store_memory_pma(find_pma_entry<uint64_t>(PMA_CMIO_TX_BUFFER_START), dir);
+    store_memory(find_pma_entry<uint64_t>(PMA_CMIO_RX_BUFFER_START), c.cmio.rx_buffer.shared, true);
+    store_memory(find_pma_entry<uint64_t>(PMA_CMIO_TX_BUFFER_START), c.cmio.tx_buffer.shared, true);
     if (!m_uarch.get_state().ram.get_istart_E()) {
-        store_memory_pma(m_uarch.get_state().ram, dir);
+        store_memory(m_uarch.get_state().ram, false, false);
+    }
+    store_memory_pmas(full_images, dir, merkle_tree_updated);
+}
+
+void machine::store_page_hashes(const std::string &dir) const {
+    for (const auto *pma : m_pmas) {
+        if (!pma->get_istart_M()) {
+            continue;
+        }
+        const uint64_t pages = (pma->get_length() + PMA_PAGE_SIZE - 1) / PMA_PAGE_SIZE;
+        std::vector<hash_type> hashes(pages);
+        for (uint64_t i = 0; i < pages; ++i) {
+            m_t.get_page_node_hash(pma->get_start() + i * PMA_PAGE_SIZE, hashes[i]);
+        }
+        auto name = machine_config::get_page_hashes_filename(dir, pma->get_start(), pma->get_length());
+        auto fp = unique_fopen(name.c_str(), "wb");
+        if (fwrite(hashes.data(), sizeof(hash_type), pages, fp.get()) != pages) {
+            throw std::runtime_error{"error writing to '" + name + "'"};
+        }
+    }
+}
+
+void machine::load_page_hashes(const std::string &dir) {
+    for (auto *pma : m_pmas) {
+        if (!pma->get_istart_M()) {
+            continue;
+        }
+        auto name = machine_config::get_page_hashes_filename(dir, pma->get_start(), pma->get_length());
+        if (unique_fopen(name.c_str(), "rb", std::nothrow_t{})) {
+            install_page_hashes(*pma, read_page_hashes(name, pma->get_length()));
+        }
+    }
+}
+
+void machine::install_page_hashes(pma_entry &pma, const std::vector<hash_type> &hashes) {
+    if (!pma.get_istart_M()) {
+        throw std::invalid_argument{"page hashes can only be installed for memory ranges"};
+    }
+    const uint64_t pages = (pma.get_length() + PMA_PAGE_SIZE - 1) / PMA_PAGE_SIZE;
+    if (hashes.size() != pages) {
+        throw std::invalid_argument{"page hashes do not match memory range"};
+    }
+    // Hashes still being computed in the background must not overwrite the installed ones
+    if (!finish_background_merkle_update()) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
+    machine_merkle_tree::hasher_type h;
+    m_t.begin_update();
+    for (uint64_t i = 0; i < pages; ++i) {
+        if (!m_t.update_page_node_hash(pma.get_start() + i * PMA_PAGE_SIZE, hashes[i])) {
+            m_t.end_update(h);
+            throw std::runtime_error{"error updating Merkle tree"};
+        }
     }
+    m_t.end_update(h);
+    pma.mark_pages_clean();
+    pma.mark_pages_unverified();
 }
 
 static void store_hash(const machine::hash_type &h, const std::string &dir) {
@@ -765,29 +1149,566 @@ static void store_hash(const machine::hash_type &h, const std::string &dir) {
     }
 }
 
-void machine::store(const std::string &dir) const {
+void machine::store(const std::string &dir, const std::string &base_dir) const {
     if (os_mkdir(dir.c_str(), 0700)) {
         throw std::system_error{errno, std::generic_category(), "error creating directory '"s + dir + "'"s};
     }
-    if (!m_r.skip_root_hash_store) {
+    // Deltas compare page hashes, so they need the Merkle tree up to date.
+    // So do compressed images, since their page hashes are what deltas stored over them compare to.
+    const bool delta = !base_dir.empty();
+    const bool merkle_tree_updated = !m_r.skip_root_hash_store || delta || m_r.compress_images;
+    if (merkle_tree_updated) {
         if (!update_merkle_tree()) {
             throw std::runtime_error{"error updating Merkle tree"};
         }
+    }
+    if (!m_r.skip_root_hash_store) {
         hash_type h;
         m_t.get_root_hash(h);
         store_hash(h, dir);
     }
     auto c = get_serialization_config();
     c.store(dir);
-    store_pmas(c, dir);
+    store_pmas(c, dir, base_dir, merkle_tree_updated);
+    // Page hashes are only known to be up to date if we updated the Merkle tree above.
+    // Deltas and compressed images always keep them, so deltas stored over them can be found without
+    // reading any images.
+    if (delta) {
+        machine_config::store_base_directory(dir, base_dir);
+        store_page_hashes(dir);
+    } else if (merkle_tree_updated && (m_r.use_page_hashes || m_r.compress_images)) {
+        store_page_hashes(dir);
+    }
+}
+
+void machine::store_async(const std::string &dir, const std::string &base_dir) {
+    if (m_async_store) {
+        throw std::runtime_error{"previous asynchronous store was not waited for"};
+    }
+    // The child would read shared ranges while the machine keeps writing to them, so what it stores would not
+    // match the state it hashed
+    for (const auto *pma : m_pmas) {
+        if (pma->get_istart_M() && pma->get_memory().is_shared()) {
+            throw std::runtime_error{"asynchronous store is not supported by machines with shared memory ranges ("s +
+                pma->get_description() + ")"};
+        }
+    }
+    // Worker threads do not survive in the child, so pages they are hashing must be done first
+    if (!finish_background_merkle_update()) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
+    // Soft-dirty bits are per process, so pages written to so far must be recorded where the child sees them
+    if (m_soft_dirty) {
+        mark_soft_dirty_pages();
+    }
+    m_async_store = os_fork_task([this, dir, base_dir]() { store(dir, base_dir); });
+}
+
+bool machine::wait_store(bool wait) {
+    if (!m_async_store) {
+        return true;
+    }
+    if (!wait && !os_forked_task_done(m_async_store)) {
+        return false;
+    }
+    // The store is over even if it failed
+    const auto task = std::move(m_async_store);
+    m_async_store = nullptr;
+    os_forked_task_wait(task);
+    return true;
+}
+
+/// \brief Processor, device, and TLB state saved by snapshot(), with the names of machine state fields
+struct machine::snapshot_state {
+    uint64_t mcycle;
+    uint64_t pc;
+    std::array<uint64_t, X_REG_COUNT> x;
+    uint64_t fcsr;
+    std::array<uint64_t, F_REG_COUNT> f;
+    uint64_t icycleinstret;
+    uint64_t mstatus;
+    uint64_t mtvec;
+    uint64_t mscratch;
+    uint64_t mepc;
+    uint64_t mcause;
+    uint64_t mtval;
+    uint64_t misa;
+    uint64_t mie;
+    uint64_t mip;
+    uint64_t medeleg;
+    uint64_t mideleg;
+    uint64_t mcounteren;
+    uint64_t menvcfg;
+    uint64_t stvec;
+    uint64_t sscratch;
+    uint64_t sepc;
+    uint64_t scause;
+    uint64_t stval;
+    uint64_t satp;
+    uint64_t scounteren;
+    uint64_t senvcfg;
+    uint64_t ilrsc;
+    uint64_t iunrep;
+    unpacked_iflags iflags;
+    decltype(machine_state::clint) clint;
+    decltype(machine_state::plic) plic;
+    shadow_tlb_state tlb;
+    decltype(machine_state::htif) htif;
+    bool soft_yield;
+    struct {
+        uint64_t pc;
+        std::array<uint64_t, UARCH_X_REG_COUNT> x;
+        uint64_t cycle;
+        bool halt_flag;
+    } uarch;
+};
+
+/// \brief Copies the state kept by snapshots between a machine state and a snapshot, in either direction
+template <typename FROM, typename TO>
+static void copy_snapshot_state(const FROM &from, TO &to) {
+    to.mcycle = from.mcycle;
+    to.pc = from.pc;
+    to.x = from.x;
+    to.fcsr = from.fcsr;
+    to.f = from.f;
+    to.icycleinstret = from.icycleinstret;
+    to.mstatus = from.mstatus;
+    to.mtvec = from.mtvec;
+    to.mscratch = from.mscratch;
+    to.mepc = from.mepc;
+    to.mcause = from.mcause;
+    to.mtval = from.mtval;
+    to.misa = from.misa;
+    to.mie = from.mie;
+    to.mip = from.mip;
+    to.medeleg = from.medeleg;
+    to.mideleg = from.mideleg;
+    to.mcounteren = from.mcounteren;
+    to.menvcfg = from.menvcfg;
+    to.stvec = from.stvec;
+    to.sscratch = from.sscratch;
+    to.sepc = from.sepc;
+    to.scause = from.scause;
+    to.stval = from.stval;
+    to.satp = from.satp;
+    to.scounteren = from.scounteren;
+    to.senvcfg = from.senvcfg;
+    to.ilrsc = from.ilrsc;
+    to.iunrep = from.iunrep;
+    to.iflags = from.iflags;
+    to.clint = from.clint;
+    to.plic = from.plic;
+    to.tlb = from.tlb;
+    to.htif = from.htif;
+    to.soft_yield = from.soft_yield;
+}
+
+/// \brief Copies the state kept by snapshots between a uarch state and a snapshot, in either direction
+template <typename FROM, typename TO>
+static void copy_uarch_snapshot_state(const FROM &from, TO &to) {
+    to.pc = from.pc;
+    to.x = from.x;
+    to.cycle = from.cycle;
+    to.halt_flag = from.halt_flag;
+}
+
+void machine::snapshot(void) {
+    if (!m_vdevs.empty()) {
+        throw std::runtime_error{"snapshot is not supported by machines with VirtIO devices"};
+    }
+    commit();
+    auto saved = std::make_unique<snapshot_state>();
+    copy_snapshot_state(m_s, *saved);
+    copy_uarch_snapshot_state(m_uarch.get_state(), saved->uarch);
+    for (auto *pma : m_pmas) {
+        pma->begin_journal();
+    }
+    // Pages in the write TLB can be written to without going through the journal, so they are saved right away
+    for (uint64_t i = 0; i < PMA_TLB_SIZE; ++i) {
+        if (m_s.tlb.hot[TLB_WRITE][i].vaddr_page != TLB_INVALID_PAGE) {
+            const tlb_cold_entry &tlbce = m_s.tlb.cold[TLB_WRITE][i];
+            if (tlbce.pma_index >= m_s.pmas.size()) {
+                commit();
+                throw std::runtime_error{"could not snapshot page for a TLB entry: TLB is corrupt"};
+            }
+            pma_entry &pma = m_s.pmas[tlbce.pma_index];
+            pma.journal_page(tlbce.paddr_page - pma.get_start());
+        }
+    }
+    m_snapshot = std::move(saved);
+}
+
+void machine::commit(void) {
+    for (auto *pma : m_pmas) {
+        pma->end_journal();
+    }
+    m_snapshot.reset();
+}
+
+void machine::rollback(void) {
+    if (!m_snapshot) {
+        throw std::out_of_range{"machine has no pending snapshot to rollback to"};
+    }
+    // Worker threads may be hashing the pages about to be restored
+    if (!finish_background_merkle_update()) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
+    for (auto *pma : m_pmas) {
+        pma->rollback_journal();
+    }
+    copy_snapshot_state(*m_snapshot, m_s);
+    copy_uarch_snapshot_state(m_snapshot->uarch, m_uarch.get_state());
+    // Copies of pages in the write TLB may no longer match the pages
+    for (auto &copy : m_write_tlb_copies) {
+        copy.paddr_page = TLB_INVALID_PAGE;
+    }
+    m_snapshot.reset();
+}
+
+std::unique_ptr<machine> machine::clone(void) const {
+    if (!m_vdevs.empty()) {
+        throw std::runtime_error{"cloning is not supported by machines with VirtIO devices"};
+    }
+    // Pages hashed in the background, or written to since soft-dirty bits were last read, must be settled
+    // before page hashes and dirty page maps are copied
+    if (!finish_background_merkle_update()) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
+    if (m_soft_dirty) {
+        mark_soft_dirty_pages();
+    }
+    // Memory ranges of the clone start pristine and private, and receive the contents of the original below
+    machine_config c = m_c;
+    c.dtb.image_filename.clear();
+    c.ram.image_filename.clear();
+    c.uarch.ram.image_filename.clear();
+    c.tlb.image_filename.clear();
+    for (auto &f : c.flash_drive) {
+        f.image_filename.clear();
+        f.shared = false;
+    }
+    c.cmio.rx_buffer.image_filename.clear();
+    c.cmio.rx_buffer.shared = false;
+    c.cmio.tx_buffer.image_filename.clear();
+    c.cmio.tx_buffer.shared = false;
+    auto cloned = std::make_unique<machine>(c, m_r);
+    if (cloned->m_pmas.size() != m_pmas.size()) {
+        throw std::runtime_error{"clone does not match memory ranges of machine"};
+    }
+    copy_snapshot_state(m_s, cloned->m_s);
+    copy_uarch_snapshot_state(m_uarch.get_state(), cloned->m_uarch.get_state());
+    // Host addresses in the TLB must point to the memory of the clone
+    for (auto etype : {TLB_CODE, TLB_READ, TLB_WRITE}) {
+        for (uint64_t i = 0; i < PMA_TLB_SIZE; ++i) {
+            tlb_hot_entry &tlbhe = cloned->m_s.tlb.hot[etype][i];
+            const tlb_cold_entry &tlbce = cloned->m_s.tlb.cold[etype][i];
+            if (tlbhe.vaddr_page == TLB_INVALID_PAGE) {
+                continue;
+            }
+            if (tlbce.pma_index >= cloned->m_s.pmas.size()) {
+                throw std::runtime_error{"could not clone TLB entry: TLB is corrupt"};
+            }
+            const pma_entry &pma = cloned->m_s.pmas[tlbce.pma_index];
+            const unsigned char *hpage = pma.get_memory().get_host_memory() + (tlbce.paddr_page - pma.get_start());
+            tlbhe.vh_offset = cast_ptr_to_addr<uint64_t>(hpage) - tlbhe.vaddr_page;
+        }
+    }
+    // Copy memory in chunks spread over threads. Pristine pages are only written to where the clone was
+    // initialized with something else, such as the DTB and the uarch RAM.
+    struct chunk {
+        size_t pma_index;
+        uint64_t offset;
+    };
+    std::vector<chunk> chunks;
+    for (size_t i = 0; i < m_pmas.size(); ++i) {
+        if (m_pmas[i]->get_istart_M() && !m_pmas[i]->get_istart_E()) {
+            for (uint64_t offset = 0; offset < m_pmas[i]->get_length(); offset += STORE_IMAGE_CHUNK_SIZE) {
+                chunks.push_back({i, offset});
+            }
+        }
+    }
+    std::atomic<uint64_t> next_chunk{0};
+    (void) os_parallel_for(get_task_concurrency(m_r.concurrency.images), [&](uint64_t, const parallel_for_mutex &) {
+        for (uint64_t i = next_chunk++; i < chunks.size(); i = next_chunk++) {
+            const pma_entry &from = *m_pmas[chunks[i].pma_index];
+            const unsigned char *from_memory = from.get_memory().get_host_memory();
+            unsigned char *to_memory = cloned->m_pmas[chunks[i].pma_index]->get_memory().get_host_memory();
+            const uint64_t chunk_end = std::min(chunks[i].offset + STORE_IMAGE_CHUNK_SIZE, from.get_length());
+            for (uint64_t offset = chunks[i].offset; offset < chunk_end; offset += PMA_PAGE_SIZE) {
+                const uint64_t length = std::min<uint64_t>(PMA_PAGE_SIZE, chunk_end - offset);
+                if (!is_pristine(from_memory + offset, length)) {
+                    memcpy(to_memory + offset, from_memory + offset, length);
+                } else if (!is_pristine(to_memory + offset, length)) {
+                    memset(to_memory + offset, 0, length);
+                }
+            }
+        }
+        return true;
+    });
+    // The clone takes the page hashes of the original instead of hashing its pages again, so only pages that
+    // are dirty in the original are hashed when the Merkle tree of the clone is next updated
+    for (size_t i = 0; i < m_pmas.size(); ++i) {
+        const pma_entry &from = *m_pmas[i];
+        if (!from.get_istart_M() || from.get_istart_E() || from.get_length() == 0) {
+            continue;
+        }
+        std::vector<hash_type> hashes((from.get_length() + PMA_PAGE_SIZE - 1) / PMA_PAGE_SIZE);
+        for (uint64_t p = 0; p < hashes.size(); ++p) {
+            m_t.get_page_node_hash(from.get_start() + p * PMA_PAGE_SIZE, hashes[p]);
+        }
+        pma_entry &to = *cloned->m_pmas[i];
+        cloned->install_page_hashes(to, hashes);
+        to.copy_page_maps(from);
+    }
+    // Pages in the write TLB may have changed since they were last hashed, which the clone cannot tell
+    // from soft-dirty bits, since copying memory set them all
+    for (uint64_t i = 0; i < PMA_TLB_SIZE; ++i) {
+        if (cloned->m_s.tlb.hot[TLB_WRITE][i].vaddr_page != TLB_INVALID_PAGE) {
+            const tlb_cold_entry &tlbce = cloned->m_s.tlb.cold[TLB_WRITE][i];
+            pma_entry &pma = cloned->m_s.pmas[tlbce.pma_index];
+            pma.mark_dirty_page(tlbce.paddr_page - pma.get_start());
+        }
+    }
+    if (cloned->m_soft_dirty) {
+        (void) os_soft_dirty_clear();
+    }
+    // The clone was not initialized from the configuration of the original, but from its current state
+    cloned->m_c = cloned->get_state_config();
+    return cloned;
+}
+
+/// \brief Rounds offset up to a multiple of alignment, which must be a power of two
+static uint64_t align_offset(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
 }
 
+void machine::store_file(const std::string &filename) const {
+    if (read_iunrep()) {
+        throw std::runtime_error{"cannot store PMAs of unreproducible machines"};
+    }
+    // Page hashes are embedded, and they also find pristine and repeated pages
+    if (!update_merkle_tree()) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
+    const auto c = get_serialization_config();
+    const auto config = c.to_archive_json();
+
+    // Same ranges as store_pmas(), with the TLB device read into a buffer
+    const auto tlb = peek_device_pma(*this, find_pma_entry<uint64_t>(PMA_SHADOW_TLB_START));
+    std::vector<std::pair<const pma_entry *, const unsigned char *>> ranges;
+    const auto add_memory = [&ranges](const pma_entry &pma) {
+        if (!pma.get_istart_M()) {
+            throw std::runtime_error{"attempt to save non-memory PMA"};
+        }
+        ranges.emplace_back(&pma, pma.get_memory().get_host_memory());
+    };
+    add_memory(find_pma_entry<uint64_t>(PMA_DTB_START));
+    add_memory(find_pma_entry<uint64_t>(PMA_RAM_START));
+    ranges.emplace_back(&find_pma_entry<uint64_t>(PMA_SHADOW_TLB_START), tlb.data());
+    for (const auto &f : c.flash_drive) {
+        add_memory(find_pma_entry<uint64_t>(f.start));
+    }
+    add_memory(find_pma_entry<uint64_t>(PMA_CMIO_RX_BUFFER_START));
+    add_memory(find_pma_entry<uint64_t>(PMA_CMIO_TX_BUFFER_START));
+    if (!m_uarch.get_state().ram.get_istart_E()) {
+        add_memory(m_uarch.get_state().ram);
+    }
+
+    // Lay out the file
+    machine_file_header header{};
+    header.magic = MACHINE_FILE_MAGIC;
+    header.version = MACHINE_FILE_VERSION;
+    header.config_offset = sizeof(header);
+    header.config_length = config.size();
+    header.range_count = ranges.size();
+    header.ranges_offset = align_offset(header.config_offset + header.config_length, sizeof(uint64_t));
+    header.has_root_hash = 1;
+    m_t.get_root_hash(header.root_hash);
+    std::vector<machine_file_range> table(ranges.size());
+    uint64_t offset = header.ranges_offset + table.size() * sizeof(machine_file_range);
+    for (uint64_t i = 0; i < ranges.size(); ++i) {
+        const auto &pma = *ranges[i].first;
+        if (pma.get_length() % MACHINE_FILE_PAGE_SIZE != 0) {
+            throw std::runtime_error{"cannot store " + pma.get_description() + " with a partial page"};
+        }
+        const uint64_t pages = pma.get_length() / MACHINE_FILE_PAGE_SIZE;
+        table[i].start = pma.get_start();
+        table[i].length = pma.get_length();
+        table[i].index_offset = offset;
+        offset += pages * sizeof(uint64_t);
+        table[i].hashes_offset = offset;
+        offset += pages * sizeof(hash_type);
+    }
+    offset = align_offset(offset, MACHINE_FILE_PAGE_SIZE);
+    for (auto &r : table) {
+        r.data_offset = offset;
+        offset += r.length;
+    }
+    const uint64_t file_length = offset;
+
+    {
+        auto fp = unique_fopen(filename.c_str(), "wb");
+        const auto write_at = [&](uint64_t at, const void *data, uint64_t length) {
+            if (fseek(fp.get(), static_cast<long>(at), SEEK_SET) != 0 ||
+                fwrite(data, 1, length, fp.get()) != length) {
+                throw std::system_error{errno, std::generic_category(), "error writing to '" + filename + "'"};
+            }
+        };
+        // Write each page only the first time its contents show up, and leave pristine pages out
+        const auto &pristine_page_hash =
+            machine_merkle_tree::get_pristine_hash(machine_merkle_tree::get_log2_page_size());
+        std::map<hash_type, std::pair<uint64_t, const unsigned char *>> written;
+        for (uint64_t i = 0; i < ranges.size(); ++i) {
+            const auto &r = table[i];
+            const unsigned char *data = ranges[i].second;
+            const uint64_t pages = r.length / MACHINE_FILE_PAGE_SIZE;
+            std::vector<uint64_t> index(pages, MACHINE_FILE_PRISTINE_PAGE);
+            std::vector<hash_type> hashes(pages);
+            for (uint64_t p = 0; p < pages; ++p) {
+                const uint64_t page_start_in_range = p * MACHINE_FILE_PAGE_SIZE;
+                const unsigned char *page = data + page_start_in_range;
+                m_t.get_page_node_hash(r.start + page_start_in_range, hashes[p]);
+                // Installed hashes that were not yet verified may claim a page is pristine when it is not
+                if (hashes[p] == pristine_page_hash &&
+                    (!ranges[i].first->is_page_unverified(page_start_in_range) ||
+                        is_pristine(page, MACHINE_FILE_PAGE_SIZE))) {
+                    continue;
+                }
+                auto it = written.find(hashes[p]);
+                if (it != written.end() && memcmp(it->second.second, page, MACHINE_FILE_PAGE_SIZE) == 0) {
+                    index[p] = it->second.first;
+                    continue;
+                }
+                index[p] = r.data_offset + page_start_in_range;
+                write_at(index[p], page, MACHINE_FILE_PAGE_SIZE);
+                written.emplace(hashes[p], std::make_pair(index[p], page));
+            }
+            write_at(r.index_offset, index.data(), index.size() * sizeof(uint64_t));
+            write_at(r.hashes_offset, hashes.data(), hashes.size() * sizeof(hash_type));
+        }
+        write_at(header.ranges_offset, table.data(), table.size() * sizeof(machine_file_range));
+        write_at(header.config_offset, config.data(), config.size());
+        write_at(0, &header, sizeof(header));
+    }
+    // Pages that were never written are holes, and the file must still cover them
+    std::error_code ec;
+    std::filesystem::resize_file(filename, file_length, ec);
+    if (ec) {
+        throw std::system_error{ec, "error writing to '" + filename + "'"};
+    }
+}
+
+bool machine::load_file(const std::string &filename, hash_type &root_hash) {
+    auto fp = unique_fopen(filename.c_str(), "rb");
+    const auto header = read_machine_file_header(fp.get(), filename);
+    const uint64_t file_length = std::filesystem::file_size(filename);
+    const auto read_at = [&](uint64_t at, void *data, uint64_t length) {
+        if (at > file_length || length > file_length - at || fseek(fp.get(), static_cast<long>(at), SEEK_SET) != 0 ||
+            fread(data, 1, length, fp.get()) != length) {
+            throw std::runtime_error{"error reading from '" + filename + "'"};
+        }
+    };
+    if (header.range_count > file_length / sizeof(machine_file_range)) {
+        throw std::runtime_error{"corrupt range table in '" + filename + "'"};
+    }
+    std::vector<machine_file_range> table(header.range_count);
+    read_at(header.ranges_offset, table.data(), table.size() * sizeof(machine_file_range));
+    for (const auto &r : table) {
+        if (r.length % MACHINE_FILE_PAGE_SIZE != 0 || r.data_offset % MACHINE_FILE_PAGE_SIZE != 0 ||
+            r.data_offset > file_length || r.length > file_length - r.data_offset) {
+            throw std::runtime_error{"corrupt range table in '" + filename + "'"};
+        }
+        const uint64_t pages = r.length / MACHINE_FILE_PAGE_SIZE;
+        std::vector<uint64_t> index(pages);
+        read_at(r.index_offset, index.data(), index.size() * sizeof(uint64_t));
+        for (const auto entry : index) {
+            if (entry % MACHINE_FILE_PAGE_SIZE != 0 || entry > file_length - MACHINE_FILE_PAGE_SIZE) {
+                throw std::runtime_error{"corrupt page index in '" + filename + "'"};
+            }
+        }
+        // The TLB device is loaded entry by entry, as from an image file
+        if (r.start == PMA_SHADOW_TLB_START && r.length == PMA_SHADOW_TLB_LENGTH) {
+            std::vector<unsigned char> tlb(r.length);
+            for (uint64_t p = 0; p < pages; ++p) {
+                if (index[p] != MACHINE_FILE_PRISTINE_PAGE) {
+                    read_at(index[p], tlb.data() + p * MACHINE_FILE_PAGE_SIZE, MACHINE_FILE_PAGE_SIZE);
+                }
+            }
+            for (uint64_t i = 0; i < PMA_TLB_SIZE; ++i) {
+                load_tlb_entry<TLB_CODE>(*this, i, tlb.data());
+                load_tlb_entry<TLB_READ>(*this, i, tlb.data());
+                load_tlb_entry<TLB_WRITE>(*this, i, tlb.data());
+            }
+            continue;
+        }
+        pma_entry &pma = find_pma_entry(m_pmas, r.start, sizeof(uint64_t));
+        if (!pma.get_istart_M() || pma.get_start() != r.start || pma.get_length() != r.length) {
+            throw std::runtime_error{"range in '" + filename + "' does not match the machine"};
+        }
+        // Map the whole data region when possible, so only pages repeated from elsewhere must be read.
+        // Pristine pages are holes in the region, so they read as zeros.
+        unsigned char *host_memory = pma.get_memory().get_host_memory();
+        const bool mapped = !m_r.copy_images && pma.get_memory().map_image_private(filename, r.data_offset);
+        if (mapped && !m_r.skip_root_hash_check && !m_r.use_page_hashes) {
+            (void) pma.get_memory().advise_will_need();
+        }
+        for (uint64_t p = 0; p < pages; ++p) {
+            const uint64_t page_start_in_range = p * MACHINE_FILE_PAGE_SIZE;
+            unsigned char *page = host_memory + page_start_in_range;
+            if (index[p] == MACHINE_FILE_PRISTINE_PAGE) {
+                if (!mapped) {
+                    memset(page, 0, MACHINE_FILE_PAGE_SIZE);
+                }
+                // The Merkle tree still holds the pristine hash for the page
+                pma.mark_clean_page(page_start_in_range);
+            } else if (!mapped || index[p] != r.data_offset + page_start_in_range) {
+                read_at(index[p], page, MACHINE_FILE_PAGE_SIZE);
+            }
+        }
+        if (m_r.use_page_hashes) {
+            std::vector<hash_type> hashes(pages);
+            read_at(r.hashes_offset, hashes.data(), hashes.size() * sizeof(hash_type));
+            install_page_hashes(pma, hashes);
+        }
+    }
+    std::copy(header.root_hash.begin(), header.root_hash.end(), root_hash.begin());
+    return header.has_root_hash != 0;
+}
+
+/// \brief Maximum number of dirty pages taken by each background Merkle tree update.
+/// \details Bounds the time the machine stops to copy pages. Other dirty pages are left for later.
+static constexpr uint64_t BACKGROUND_MERKLE_UPDATE_MAX_PAGES = 4096;
+
+/// \brief Dirty pages being hashed in the background
+struct machine::background_merkle_update {
+    /// \brief Page taken from a PMA
+    struct page_type {
+        pma_entry *pma;               ///< PMA containing the page
+        uint64_t page_start_in_range; ///< Offset of page in PMA
+    };
+    std::vector<page_type> pages;          ///< Pages taken
+    std::vector<machine::hash_type> hashes; ///< Hash of each page
+    std::vector<uint64_t> copied;          ///< Index in pages of each non-pristine page copied into data
+    std::vector<unsigned char> data;       ///< Contents of non-pristine pages when they were taken
+    os_parallel_for_handle handle;         ///< Tasks hashing the copies
+};
+
 // NOLINTNEXTLINE(modernize-use-equals-default)
 machine::~machine() {
+    // Background tasks reference the page copies, so they must be done before these are released
+    if (m_background_merkle_update) {
+        try {
+            (void) os_parallel_for_wait(m_background_merkle_update->handle);
+        } catch (...) { // NOLINT(bugprone-empty-catch)
+        }
+    }
     // Cleanup TTY if console input was enabled
     if (m_c.htif.console_getchar || has_virtio_console()) {
         os_close_tty();
     }
+    if (m_soft_dirty) {
+        os_soft_dirty_release();
+    }
 #ifdef DUMP_HIST
     (void) fprintf(stderr, "\nInstruction Histogram:\n");
     for (auto v : m_s.insn_hist) {
@@ -832,6 +1753,9 @@ machine::~machine() {
     (void) fprintf(stderr, "tlb_flush_fence_vma_asid: %" PRIu64 "\n", m_s.stats.tlb_flush_fence_vma_asid);
     (void) fprintf(stderr, "tlb_flush_fence_vma_vaddr: %" PRIu64 "\n", m_s.stats.tlb_flush_fence_vma_vaddr);
     (void) fprintf(stderr, "tlb_flush_fence_vma_asid_vaddr: %" PRIu64 "\n", m_s.stats.tlb_flush_fence_vma_asid_vaddr);
+    (void) fprintf(stderr, "tlb_wpage_unchanged: %" PRIu64 "\n", m_s.stats.tlb_wpage_unchanged);
+    (void) fprintf(stderr, "tlb_wpage_dirty: %" PRIu64 "\n", m_s.stats.tlb_wpage_dirty);
+    (void) fprintf(stderr, "tlb_wpage_copied: %" PRIu64 "\n", m_s.stats.tlb_wpage_copied);
 #endif
 }
 
@@ -1491,7 +2415,21 @@ void machine::set_iflags_H(void) {
     m_s.iflags.H = true;
 }
 
+void machine::mark_soft_dirty_pages(void) const {
+    for (auto &pma : m_s.pmas) {
+        if (pma.is_soft_dirty_tracked() && !pma.mark_soft_dirty_pages()) {
+            throw std::runtime_error{"could not read soft-dirty bits of "s + pma.get_description()};
+        }
+    }
+    // Pages written to after this are caught next time, since the machine is not running.
+    // Failing to clear only means the same pages are marked again.
+    (void) os_soft_dirty_clear();
+}
+
 void machine::mark_write_tlb_dirty_pages(void) const {
+    if (m_soft_dirty) {
+        mark_soft_dirty_pages();
+    }
     for (uint64_t i = 0; i < PMA_TLB_SIZE; ++i) {
         const tlb_hot_entry &tlbhe = m_s.tlb.hot[TLB_WRITE][i];
         if (tlbhe.vaddr_page != TLB_INVALID_PAGE) {
@@ -1503,7 +2441,78 @@ void machine::mark_write_tlb_dirty_pages(void) const {
             if (!pma.contains(tlbce.paddr_page, PMA_PAGE_SIZE)) {
                 throw std::runtime_error{"could not mark dirty page for a TLB entry: TLB is corrupt"};
             }
-            pma.mark_dirty_page(tlbce.paddr_page - pma.get_start());
+            // Writes to pages of tracked ranges were already accounted for by the host
+            if (pma.is_soft_dirty_tracked()) {
+                continue;
+            }
+            const uint64_t page_start_in_range = tlbce.paddr_page - pma.get_start();
+            // A page that was not written since it was copied hashes to the same value as the copy.
+            // Comparing against the hash in the tree covers pages rehashed by other means since then.
+            if (!m_write_tlb_copies.empty()) {
+                write_tlb_page_copy &copy = m_write_tlb_copies[i];
+                if (copy.paddr_page == tlbce.paddr_page && !pma.is_page_marked_dirty(page_start_in_range)) {
+                    hash_type hash;
+                    m_t.get_page_node_hash(tlbce.paddr_page, hash);
+                    if (hash == copy.hash &&
+                        memcmp(pma.get_memory().get_host_memory() + page_start_in_range, copy.data.data(),
+                            PMA_PAGE_SIZE) == 0) {
+                        INC_COUNTER(m_s.stats, tlb_wpage_unchanged);
+                        continue;
+                    }
+                }
+                copy.paddr_page = TLB_INVALID_PAGE;
+            }
+            INC_COUNTER(m_s.stats, tlb_wpage_dirty);
+            pma.mark_dirty_page(page_start_in_range);
+        }
+    }
+}
+
+void machine::copy_write_tlb_pages(void) const {
+    if (m_write_tlb_copies.empty()) {
+        m_write_tlb_copies.resize(PMA_TLB_SIZE);
+    }
+    for (uint64_t i = 0; i < PMA_TLB_SIZE; ++i) {
+        const tlb_hot_entry &tlbhe = m_s.tlb.hot[TLB_WRITE][i];
+        write_tlb_page_copy &copy = m_write_tlb_copies[i];
+        const tlb_cold_entry &tlbce = m_s.tlb.cold[TLB_WRITE][i];
+        // Pages left alone by mark_write_tlb_dirty_pages() already have an up-to-date copy
+        if (tlbhe.vaddr_page == TLB_INVALID_PAGE || copy.paddr_page == tlbce.paddr_page) {
+            continue;
+        }
+        const pma_entry &pma = m_s.pmas[tlbce.pma_index];
+        if (pma.is_soft_dirty_tracked()) {
+            continue;
+        }
+        memcpy(copy.data.data(), pma.get_memory().get_host_memory() + (tlbce.paddr_page - pma.get_start()),
+            PMA_PAGE_SIZE);
+        m_t.get_page_node_hash(tlbce.paddr_page, copy.hash);
+        copy.paddr_page = tlbce.paddr_page;
+        INC_COUNTER(m_s.stats, tlb_wpage_copied);
+    }
+}
+
+void machine::add_dense_merkle_subtrees(void) {
+    for (const auto *pma : m_pmas) {
+        if (!pma->get_istart_M()) {
+            continue;
+        }
+        // Split the range into maximal aligned power-of-two chunks, so ranges that are not themselves
+        // aligned powers of two (such as multi-GiB RAM) are still stored densely
+        uint64_t start = pma->get_start();
+        const uint64_t end = start + pma->get_length();
+        while (start < end) {
+            int log2_size = machine_merkle_tree::get_log2_page_size();
+            while (log2_size + 1 < machine_merkle_tree::get_log2_root_size() &&
+                (start & ((UINT64_C(2) << log2_size) - 1)) == 0 && (UINT64_C(2) << log2_size) <= end - start) {
+                ++log2_size;
+            }
+            // Single pages gain nothing from being dense.
+            // If the chunk cannot be stored densely, it simply remains sparse
+            if (log2_size > machine_merkle_tree::get_log2_page_size()) {
+                m_t.add_dense_subtree(start, log2_size);
+            }
+            start += UINT64_C(1) << log2_size;
         }
     }
 }
@@ -1517,6 +2526,10 @@ bool machine::verify_dirty_page_maps(void) const {
         return false;
     }
     bool broken = false;
+    // Hashes computed in the background are not in the Merkle tree yet
+    if (!finish_background_merkle_update()) {
+        return false;
+    }
     // Go over the write TLB and mark as dirty all pages currently there
     mark_write_tlb_dirty_pages();
     // Now go over all memory PMAs verifying that all dirty pages are marked
@@ -1556,15 +2569,101 @@ bool machine::verify_dirty_page_maps(void) const {
     return !broken;
 }
 
-static uint64_t get_task_concurrency(uint64_t value) {
-    const uint64_t concurrency = value > 0 ? value : std::max(os_get_concurrency(), UINT64_C(1));
-    return std::min(concurrency, static_cast<uint64_t>(THREADS_MAX));
+void machine::start_background_merkle_update(void) {
+    static_assert(PMA_PAGE_SIZE == machine_merkle_tree::get_page_size(),
+        "PMA and machine_merkle_tree page sizes must match");
+    if (!finish_background_merkle_update()) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
+    // Go over the write TLB and mark as dirty all pages currently there
+    mark_write_tlb_dirty_pages();
+    auto update = std::make_shared<background_merkle_update>();
+    std::array<unsigned char, PMA_PAGE_SIZE> scratch{};
+    // Only memory PMAs are taken, since device pages are cheap to hash when needed
+    for (auto *pma : m_pmas) {
+        if (!pma->get_istart_M()) {
+            continue;
+        }
+        auto peek = pma->get_peek();
+        for (uint64_t page_start_in_range = 0; page_start_in_range < pma->get_length() &&
+             update->pages.size() < BACKGROUND_MERKLE_UPDATE_MAX_PAGES;
+             page_start_in_range += PMA_PAGE_SIZE) {
+            if (!pma->is_page_marked_dirty(page_start_in_range)) {
+                continue;
+            }
+            // Pages that cannot be peeked are left dirty for update_merkle_tree() to report
+            const unsigned char *page_data = nullptr;
+            if (!peek(*pma, *this, page_start_in_range, &page_data, scratch.data()) || !page_data) {
+                continue;
+            }
+            if (is_pristine(page_data, PMA_PAGE_SIZE)) {
+                if (m_r.reclaim_pristine_pages) {
+                    pma->get_memory().reclaim_pristine(page_start_in_range, PMA_PAGE_SIZE);
+                }
+                update->hashes.push_back(
+                    machine_merkle_tree::get_pristine_hash(machine_merkle_tree::get_log2_page_size()));
+            } else {
+                update->hashes.emplace_back();
+                update->copied.push_back(update->pages.size());
+                update->data.insert(update->data.end(), page_data, page_data + PMA_PAGE_SIZE);
+            }
+            update->pages.push_back({pma, page_start_in_range});
+            pma->mark_verified_page(page_start_in_range);
+            pma->mark_clean_page(page_start_in_range);
+        }
+    }
+    if (update->pages.empty()) {
+        return;
+    }
+    const uint64_t n = get_task_concurrency(m_r.concurrency.update_merkle_tree);
+    // Tasks only read the copies and the tree, which are both kept alive and unmodified until they are done
+    auto *u = update.get();
+    const auto *t = &m_t;
+    update->handle = os_parallel_for_async(n, [u, t, n](uint64_t j, const parallel_for_mutex &) -> bool {
+        machine_merkle_tree::hasher_type h;
+        // Thread j is responsible for copy i if i % n == j.
+        for (uint64_t i = j; i < u->copied.size(); i += n) {
+            t->get_page_node_hash(h, u->data.data() + i * PMA_PAGE_SIZE, u->hashes[u->copied[i]]);
+        }
+        return true;
+    });
+    m_background_merkle_update = std::move(update);
+}
+
+bool machine::finish_background_merkle_update(void) const {
+    if (!m_background_merkle_update) {
+        return true;
+    }
+    const auto update = std::move(m_background_merkle_update);
+    m_background_merkle_update.reset();
+    if (!os_parallel_for_wait(update->handle)) {
+        // Pages must then be hashed again by update_merkle_tree()
+        for (const auto &page : update->pages) {
+            page.pma->mark_dirty_page(page.page_start_in_range);
+        }
+        return true;
+    }
+    machine_merkle_tree::hasher_type h;
+    m_t.begin_update();
+    for (uint64_t i = 0; i < update->pages.size(); ++i) {
+        const auto &page = update->pages[i];
+        if (!m_t.update_page_node_hash(page.pma->get_start() + page.page_start_in_range, update->hashes[i])) {
+            m_t.end_update(h);
+            return false;
+        }
+    }
+    return m_t.end_update(h);
 }
 
 bool machine::update_merkle_tree(void) const {
     machine_merkle_tree::hasher_type gh;
     static_assert(PMA_PAGE_SIZE == machine_merkle_tree::get_page_size(),
         "PMA and machine_merkle_tree page sizes must match");
+    // Install hashes computed in the background first, so pages modified after they
+    // were taken are rehashed below
+    if (!finish_background_merkle_update()) {
+        return false;
+    }
     // Go over the write TLB and mark as dirty all pages currently there
     mark_write_tlb_dirty_pages();
     // Now go over all PMAs and updating the Merkle tree
@@ -1576,6 +2675,7 @@ bool machine::update_merkle_tree(void) const {
         // For each PMA, we launch as many threads (n) as defined on concurrency
         // runtime config or as the hardware supports.
         const uint64_t n = get_task_concurrency(m_r.concurrency.update_merkle_tree);
+        const bool reclaim = m_r.reclaim_pristine_pages;
         const bool succeeded = os_parallel_for(n, [&](int j, const parallel_for_mutex &mutex) -> bool {
             auto scratch = unique_calloc<unsigned char>(PMA_PAGE_SIZE, std::nothrow_t{});
             if (!scratch) {
@@ -1597,10 +2697,11 @@ bool machine::update_merkle_tree(void) const {
                     return false;
                 }
                 if (page_data) {
-                    const bool is_pristine = std::all_of(page_data, page_data + PMA_PAGE_SIZE,
-                        [](unsigned char pp) -> bool { return pp == '\0'; });
-
-                    if (is_pristine) {
+                    if (is_pristine(page_data, PMA_PAGE_SIZE)) {
+                        // Pristine memory pages can be given back to the host, since they read as zeros
+                        if (reclaim && pma->get_istart_M()) {
+                            pma->get_memory().reclaim_pristine(page_start_in_range, PMA_PAGE_SIZE);
+                        }
                         // The update_page_node_hash function in the machine_merkle_tree is not thread
                         // safe, so we protect it with a mutex
                         const parallel_for_mutex_guard lock(mutex);
@@ -1630,15 +2731,22 @@ bool machine::update_merkle_tree(void) const {
             return false;
         }
         // Otherwise, mark all pages in PMA as clean and move on to next
+        pma->mark_dirty_pages_verified();
         pma->mark_pages_clean();
     }
     const bool ret = m_t.end_update(gh);
+    if (ret) {
+        copy_write_tlb_pages();
+    }
     return ret;
 }
 
 bool machine::update_merkle_tree_page(uint64_t address) {
     static_assert(PMA_PAGE_SIZE == machine_merkle_tree::get_page_size(),
         "PMA and machine_merkle_tree page sizes must match");
+    if (!finish_background_merkle_update()) {
+        return false;
+    }
     // Align address to beginning of page
     address &= ~(PMA_PAGE_SIZE - 1);
     pma_entry &pma = find_pma_entry(m_pmas, address, sizeof(uint64_t));
@@ -1664,6 +2772,7 @@ bool machine::update_merkle_tree_page(uint64_t address) {
             return false;
         }
     }
+    pma.mark_verified_page(page_start_in_range);
     pma.mark_clean_page(page_start_in_range);
     return m_t.end_update(h);
 }
@@ -1682,8 +2791,59 @@ void machine::get_root_hash(hash_type &hash) const {
     m_t.get_root_hash(hash);
 }
 
+bool machine::verify_page_hashes(void) const {
+    // Pages in the write TLB may have been modified since their hashes were installed
+    mark_write_tlb_dirty_pages();
+    const uint64_t n = get_task_concurrency(m_r.concurrency.update_merkle_tree);
+    std::atomic<bool> failed{false};
+    for (auto *pma : m_pmas) {
+        if (!pma->has_unverified_pages()) {
+            continue;
+        }
+        const uint64_t pages_in_range = (pma->get_length() + PMA_PAGE_SIZE - 1) / PMA_PAGE_SIZE;
+        // Thread j is responsible for page i if i % n == j, and all of them stop at the first mismatch
+        const bool ok = os_parallel_for(n, [&](uint64_t j, const parallel_for_mutex &) -> bool {
+            machine_merkle_tree::hasher_type h;
+            auto scratch = unique_calloc<unsigned char>(PMA_PAGE_SIZE, std::nothrow_t{});
+            if (!scratch) {
+                return false;
+            }
+            auto peek = pma->get_peek();
+            for (uint64_t i = j; i < pages_in_range && !failed.load(std::memory_order_relaxed); i += n) {
+                const uint64_t page_start_in_range = i * PMA_PAGE_SIZE;
+                // Dirty pages will be rehashed from their data anyway
+                if (!pma->is_page_unverified(page_start_in_range) || pma->is_page_marked_dirty(page_start_in_range)) {
+                    continue;
+                }
+                const unsigned char *page_data = nullptr;
+                if (!peek(*pma, *this, page_start_in_range, &page_data, scratch.get())) {
+                    failed.store(true, std::memory_order_relaxed);
+                    return false;
+                }
+                hash_type stored;
+                hash_type real;
+                m_t.get_page_node_hash(pma->get_start() + page_start_in_range, stored);
+                m_t.get_page_node_hash(h, page_data, real);
+                if (stored != real) {
+                    failed.store(true, std::memory_order_relaxed);
+                    return false;
+                }
+            }
+            return true;
+        });
+        if (!ok || failed.load()) {
+            return false;
+        }
+        // Page bitmaps are not safe to update from several threads, so pages are marked verified afterwards.
+        // Dirty pages are included, since they will be rehashed from their data anyway.
+        pma->mark_pages_verified();
+    }
+    return true;
+}
+
 bool machine::verify_merkle_tree(void) const {
-    return m_t.verify_tree();
+    return finish_background_merkle_update() &&
+        m_t.verify_tree(get_task_concurrency(m_r.concurrency.update_merkle_tree)) && verify_page_hashes();
 }
 
 machine_merkle_tree::proof_type machine::get_proof(uint64_t address, int log2_size, skip_merkle_tree_update_t) const {
@@ -1694,6 +2854,9 @@ machine_merkle_tree::proof_type machine::get_proof(uint64_t address, int log2_si
         log2_size < machine_merkle_tree::get_log2_word_size()) {
         throw std::invalid_argument{"invalid log2_size"};
     }
+    if (!finish_background_merkle_update()) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
     // Check target address alignment
     if (address & ((~UINT64_C(0)) >> (64 - log2_size))) {
         throw std::invalid_argument{"address not aligned to log2_size"};
@@ -1737,6 +2900,42 @@ machine_merkle_tree::proof_type machine::get_proof(uint64_t address, int log2_si
     return get_proof(address, log2_size, skip_merkle_tree_update);
 }
 
+std::vector<machine_merkle_tree::proof_type> machine::get_proofs(const std::vector<uint64_t> &addresses,
+    const std::vector<int> &log2_sizes) const {
+    static_assert(PMA_PAGE_SIZE == machine_merkle_tree::get_page_size(),
+        "PMA and machine_merkle_tree page sizes must match");
+    if (addresses.size() != log2_sizes.size()) {
+        throw std::invalid_argument{"number of addresses and log2 sizes differ"};
+    }
+    // Check all targets before doing any work
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        if (log2_sizes[i] > machine_merkle_tree::get_log2_root_size() ||
+            log2_sizes[i] < machine_merkle_tree::get_log2_word_size()) {
+            throw std::invalid_argument{"invalid log2_size"};
+        }
+        if (addresses[i] & ((~UINT64_C(0)) >> (64 - log2_sizes[i]))) {
+            throw std::invalid_argument{"address not aligned to log2_size"};
+        }
+    }
+    if (!update_merkle_tree()) {
+        throw std::runtime_error{"error updating Merkle tree"};
+    }
+    // Pages are requested one at a time, so a single scratch page suffices
+    auto scratch = unique_calloc<unsigned char>(PMA_PAGE_SIZE);
+    return m_t.get_proofs(addresses, log2_sizes, [&](uint64_t page_address) -> const unsigned char * {
+        // See get_proof() for why nodes smaller than a page are either entirely inside a PMA range or outside all
+        const pma_entry &pma = find_pma_entry(m_pmas, page_address, sizeof(uint64_t));
+        const unsigned char *page_data = nullptr;
+        if (!pma.get_istart_E()) {
+            auto peek = pma.get_peek();
+            if (!peek(pma, *this, page_address - pma.get_start(), &page_data, scratch.get())) {
+                throw std::runtime_error{"PMA peek failed"};
+            }
+        }
+        return page_data;
+    });
+}
+
 void machine::read_memory(uint64_t address, unsigned char *data, uint64_t length) const {
     if (length == 0) {
         return;
@@ -2153,7 +3352,20 @@ interpreter_break_reason machine::run(uint64_t mcycle_end) {
         throw std::invalid_argument{"mcycle is past"};
     }
     state_access a(*this);
-    return interpret(a, mcycle_end);
+    const uint64_t interval = m_r.concurrency.background_merkle_tree_interval;
+    if (interval == 0) {
+        return interpret(a, mcycle_end);
+    }
+    // Run in slices, hashing pages modified in each slice in the background while the next one runs
+    for (;;) {
+        start_background_merkle_update();
+        const uint64_t mcycle = read_mcycle();
+        const uint64_t mcycle_slice_end = mcycle_end - mcycle > interval ? mcycle + interval : mcycle_end;
+        const auto break_reason = interpret(a, mcycle_slice_end);
+        if (break_reason != interpreter_break_reason::reached_target_mcycle || mcycle_slice_end == mcycle_end) {
+            return break_reason;
+        }
+    }
 }
 
 } // namespace cartesi
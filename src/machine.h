@@ -64,6 +64,22 @@ private:
     machine_runtime_config m_r;         ///< Copy of initialization runtime config
     machine_memory_range_descrs m_mrds; ///< List of memory ranges returned by get_memory_ranges().
 
+    struct background_merkle_update;
+    mutable std::shared_ptr<background_merkle_update> m_background_merkle_update; ///< Pages being hashed, if any
+
+    /// \brief Copy of a page in the write TLB, with the hash it had in the Merkle tree when copied
+    struct write_tlb_page_copy {
+        uint64_t paddr_page{TLB_INVALID_PAGE};
+        machine_merkle_tree::hash_type hash{};
+        std::array<unsigned char, PMA_PAGE_SIZE> data{};
+    };
+    mutable std::vector<write_tlb_page_copy> m_write_tlb_copies; ///< One copy per write TLB entry, allocated on demand
+    bool m_soft_dirty{false}; ///< True if this machine owns the soft-dirty bits of the process
+    os_forked_task_handle m_async_store; ///< Store started by store_async() and not waited for, if any
+
+    struct snapshot_state;
+    std::unique_ptr<snapshot_state> m_snapshot; ///< State saved by snapshot(), if a snapshot is pending
+
     boost::container::static_vector<std::unique_ptr<virtio_device>, VIRTIO_MAX> m_vdevs; ///< Array of VirtIO devices
 
     static const pma_entry::flags m_dtb_flags;            ///< PMA flags used for DTB
@@ -99,10 +115,67 @@ private:
     /// \returns New PMA entry with tx buffer flags already set.
     static pma_entry make_cmio_tx_buffer_pma_entry(const cmio_config &cmio_config);
 
+    /// \brief Saves the Merkle tree page hashes of memory PMAs next to their images
+    /// \param directory Directory where page hashes will be stored
+    /// \details Assumes the Merkle tree is up to date.
+    void store_page_hashes(const std::string &directory) const;
+
+    /// \brief Installs page hashes saved by store_page_hashes() into the Merkle tree
+    /// \param directory Directory where page hashes were stored
+    /// \details Memory PMAs without a page hashes file are left untouched.
+    void load_page_hashes(const std::string &directory);
+
+    /// \brief Installs precomputed page hashes for a memory PMA into the Merkle tree
+    /// \param pma Memory PMA
+    /// \param hashes One hash per page in PMA
+    /// \details All pages in the PMA are marked clean, and their hashes are marked unverified,
+    /// to be checked against the data by verify_merkle_tree().
+    void install_page_hashes(pma_entry &pma, const std::vector<machine_merkle_tree::hash_type> &hashes);
+
+    /// \brief Checks the hashes installed by install_page_hashes() against the data
+    /// \returns True if all of them match, false otherwise
+    bool verify_page_hashes(void) const;
+
     /// \brief Saves PMAs into files for serialization
     /// \param config Machine config to be stored
     /// \param directory Directory where PMAs will be stored
-    void store_pmas(const machine_config &config, const std::string &directory) const;
+    /// \param base_directory Directory holding the base machine, or empty to store memory PMAs in full
+    /// \param merkle_tree_updated True if the Merkle tree is known to be up to date
+    void store_pmas(const machine_config &config, const std::string &directory, const std::string &base_directory,
+        bool merkle_tree_updated) const;
+
+    /// \brief Saves the images of memory PMAs
+    /// \param pmas Memory PMAs
+    /// \param directory Directory where the images will be stored
+    /// \param merkle_tree_updated True if the Merkle tree is known to be up to date
+    /// \details Chunks of all images are written concurrently by the worker pool, with positioned writes.
+    /// Pristine pages are skipped, leaving holes in the images where the filesystem supports
+    /// sparse files. They are found by their hashes when the Merkle tree is up to date, and by their
+    /// contents otherwise, or when their hashes were installed and are still unverified.
+    void store_memory_pmas(const std::vector<const pma_entry *> &pmas, const std::string &directory,
+        bool merkle_tree_updated) const;
+
+    /// \brief Loads the memory ranges of a machine file
+    /// \param filename Name of machine file
+    /// \param root_hash Receives the root hash stored in the file
+    /// \returns True if the file holds a root hash, false otherwise
+    /// \details Data regions are mapped privately into memory when possible. Page hashes are
+    /// installed into the Merkle tree when the runtime config asks for them.
+    bool load_file(const std::string &filename, machine_merkle_tree::hash_type &root_hash);
+
+    /// \brief Saves the pages of a memory PMA that differ from the base machine
+    /// \param pma Memory PMA
+    /// \param directory Directory where the delta will be stored
+    /// \param base_directory Directory holding the base machine
+    /// \details Pages are compared by their hashes, when the base has page hashes for the PMA, and by their
+    /// contents otherwise. Assumes the Merkle tree is up to date.
+    void store_memory_pma_delta(const pma_entry &pma, const std::string &directory,
+        const std::string &base_directory) const;
+
+    /// \brief Decompresses compressed images into memory PMAs, and applies the deltas stored over their images
+    /// \param directory Directory the machine was loaded from
+    /// \details Deltas are applied from the oldest to the newest. Full machines have none.
+    void load_memory_images(const std::string &directory);
 
     /// \brief Obtain PMA entry that covers a given physical memory region
     /// \param pmas Container of pmas to be searched.
@@ -182,7 +255,56 @@ public:
 
     /// \brief Serialize entire state to directory
     /// \param directory Directory to store machine into
-    void store(const std::string &directory) const;
+    /// \param base_directory Optional directory holding a previously stored machine. If given, only the pages
+    /// of memory ranges that differ from it are stored, and loading applies them over it.
+    void store(const std::string &directory, const std::string &base_directory = {}) const;
+
+    /// \brief Serialize entire state to a single machine file
+    /// \param filename Name of file to store machine into
+    /// \details The file holds the config, a page index and the page hashes of each memory range,
+    /// followed by the range data laid out so it can be mapped directly into memory. Pristine pages and
+    /// pages repeating an earlier page are stored only in the index. Machines load from the file by
+    /// passing its name instead of a directory.
+    void store_file(const std::string &filename) const;
+
+    /// \brief Starts serializing entire state to directory in the background
+    /// \param directory Directory to store machine into
+    /// \param base_directory Optional directory holding a previously stored machine, as in store()
+    /// \details The state is captured at the time of the call by a child process, which holds a copy-on-write
+    /// snapshot of the machine and stores it while the machine keeps running. Machines with memory ranges
+    /// shared with their image files are refused, since the snapshot cannot cover those. Each store must be
+    /// waited for by wait_store() before the next one starts.
+    void store_async(const std::string &directory, const std::string &base_directory = {});
+
+    /// \brief Checks whether the store started by store_async() is done
+    /// \param wait True to block until it is
+    /// \returns True if no store is in progress anymore, false if it is still running
+    /// \details Throws if the store failed.
+    bool wait_store(bool wait = true);
+
+    /// \brief Takes a snapshot of the machine, to which rollback() can later return
+    /// \details Processor, device, and TLB state are saved right away. Pages of memory ranges are saved to a
+    /// journal only when first written to, so the cost of a snapshot grows with the number of pages changed.
+    /// A pending snapshot is committed first. Machines with VirtIO devices cannot be snapshotted, since their
+    /// host side cannot be rolled back.
+    void snapshot(void);
+
+    /// \brief Discards the pending snapshot, if any
+    void commit(void);
+
+    /// \brief Returns the machine to the state of the pending snapshot, and discards it
+    void rollback(void);
+
+    /// \brief Creates an independent copy of the machine in the same process
+    /// \returns The new machine
+    /// \details The copy is eager, not copy-on-write: all memory that is not pristine is copied before the
+    /// call returns, so it takes time and host memory in proportion to the memory in use. Pristine pages are
+    /// left unbacked by host memory. The copy takes the page hashes of the Merkle tree instead of hashing pages
+    /// again, and the dirty page maps along with them. Memory ranges of the copy are private, even where the
+    /// original shares them with image files. The initial config of the copy describes the state of the
+    /// original at the time of the call, without image files. Machines with VirtIO devices cannot be cloned,
+    /// and a pending snapshot is not cloned.
+    std::unique_ptr<machine> clone(void) const;
 
     /// \brief No default constructor
     machine(void) = delete;
@@ -332,12 +454,23 @@ public:
     /// This overload is used to optimize proof generation when the caller knows that the tree is already up to date.
     machine_merkle_tree::proof_type get_proof(uint64_t address, int log2_size, skip_merkle_tree_update_t) const;
 
+    /// \brief Obtains the proofs for several nodes in the Merkle tree.
+    /// \param addresses Address of each target node. Each must be aligned to a 2<sup>log2_size</sup> boundary.
+    /// \param log2_sizes log<sub>2</sub> of size subintended by each target node.
+    /// Each must be between 3 (for a word) and 64 (for the entire address space), inclusive.
+    /// \returns Proofs for each target node, in the same order.
+    /// \details The Merkle tree is updated once for all proofs. Nodes smaller than a page must lie
+    /// entirely inside the same PMA range, and nodes inside the same page share most of the work.
+    std::vector<machine_merkle_tree::proof_type> get_proofs(const std::vector<uint64_t> &addresses,
+        const std::vector<int> &log2_sizes) const;
+
     /// \brief Obtains the root hash of the Merkle tree.
     /// \param hash Receives the hash.
     void get_root_hash(hash_type &hash) const;
 
     /// \brief Verifies integrity of Merkle tree.
     /// \returns True if tree is self-consistent, false otherwise.
+    /// \details Page hashes installed from page hash files are also checked against the data.
     bool verify_merkle_tree(void) const;
 
     /// \brief Read the value of any CSR
@@ -826,14 +959,43 @@ public:
     }
 
     /// \brief Go over the write TLB and mark as dirty all pages currently there.
+    /// \details Pages that still match the copy taken by copy_write_tlb_pages(), and whose hash
+    /// in the Merkle tree has not changed since, were not modified and are left alone.
     void mark_write_tlb_dirty_pages(void) const;
 
+    /// \brief Copies pages in the write TLB that were marked dirty, after their hashes were updated.
+    void copy_write_tlb_pages(void) const;
+
+    /// \brief Marks as dirty the pages of tracked memory ranges that the host saw written to, and restarts tracking.
+    void mark_soft_dirty_pages(void) const;
+
+    /// \brief Starts hashing the dirty pages of memory PMAs in the background.
+    /// \details Dirty pages are copied and marked clean, so the machine can keep running and
+    /// modifying them while the copies are hashed by the thread pool. The resulting hashes
+    /// are installed in the Merkle tree by finish_background_merkle_update().
+    void start_background_merkle_update(void);
+
+    /// \brief Waits for pages being hashed in the background and installs their hashes in the Merkle tree.
+    /// \returns true if successful, false otherwise.
+    /// \details Must be called before the Merkle tree is read or updated.
+    bool finish_background_merkle_update(void) const;
+
+    /// \brief Stores the memory PMAs as dense subtrees in the Merkle tree, when possible.
+    /// \details Each PMA is split into maximal aligned power-of-two chunks, and each chunk
+    /// longer than a page gets its own dense subtree.
+    void add_dense_merkle_subtrees(void);
+
     /// \brief Verify if dirty page maps are consistent.
     /// \returns true if they are, false if there is an error.
     bool verify_dirty_page_maps(void) const;
 
+    /// \brief Copies the current state into a configuration, without image file names
+    /// \returns The configuration
+    machine_config get_state_config(void) const;
+
     /// \brief Copies the current state into a configuration for serialization
     /// \returns The configuration
+    /// \details Throws for unreproducible machines.
     machine_config get_serialization_config(void) const;
 
     /// \brief Returns copy of initialization config.
@@ -848,9 +1010,13 @@ public:
 
     /// \brief Replaces a memory range.
     /// \param range Configuration of the new memory range.
+    /// \param page_hashes_filename Optional file with one precomputed hash per page of the new range,
+    /// as produced by merkle-tree-hash --page-hashes-output.
     /// \details The machine must contain an existing memory range
     /// matching the start and length specified in range.
-    void replace_memory_range(const memory_range_config &range);
+    /// When page hashes are given, the range joins the Merkle tree without being rehashed.
+    /// The hashes are trusted until verify_merkle_tree() checks them against the data.
+    void replace_memory_range(const memory_range_config &range, const std::string &page_hashes_filename = {});
 
     /// \brief Sends cmio response
     /// \param reason Reason for sending response.
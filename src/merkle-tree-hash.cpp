@@ -14,23 +14,36 @@
 // with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
 #include <cassert>
+#include <cinttypes>
+#include <chrono>
 #include <cstdarg>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <vector>
 
 #include "back-merkle-tree.h"
+#include "is-pristine.h"
 #include "keccak-256-hasher.h"
+#include "os-features.h"
+#include "os.h"
 #include "unique-c-ptr.h"
 
 using namespace cartesi;
 using hasher_type = keccak_256_hasher;
 using hash_type = hasher_type::hash_type;
 
+/// \brief Log<sub>2</sub> of the number of input bytes hashed in parallel at a time
+constexpr int BATCH_LOG2_SIZE = 26;
+/// \brief Number of input bytes hashed in parallel at a time
+constexpr uint64_t BATCH_SIZE = UINT64_C(1) << BATCH_LOG2_SIZE;
+
 /// \brief Checks if string matches prefix and captures remaninder
 /// \param pre Prefix to match in str.
 /// \param str Input string
@@ -142,17 +155,98 @@ static hash_type get_leaf_hash(hasher_type &h, const unsigned char *leaf_data, i
     }
 }
 
-/// \brief Computes the Merkle hash of a leaf of data
-/// \param leaf_data Pointer to buffer containing leaf data with
-/// at least 2^log2_leaf_size bytes
+/// \brief Computes the Merkle hash of a leaf filled with zeros
 /// \param log2_leaf_size Log<sub>2</sub> of leaf size
 /// \param log2_word_size Log<sub>2</sub> of word size
-/// \returns Merkle hash of leaf data
-static hash_type get_leaf_hash(const unsigned char *leaf_data, int log2_leaf_size, int log2_word_size) {
+/// \returns Merkle hash of pristine leaf
+static hash_type get_pristine_leaf_hash(int log2_leaf_size, int log2_word_size) {
     hasher_type h;
-    return get_leaf_hash(h, leaf_data, log2_leaf_size, log2_word_size);
+    const std::vector<unsigned char> word(UINT64_C(1) << log2_word_size, 0);
+    hash_type hash;
+    get_word_hash(h, word.data(), log2_word_size, hash);
+    for (int log2_size = log2_word_size; log2_size < log2_leaf_size; ++log2_size) {
+        get_concat_hash(h, hash, hash, hash);
+    }
+    return hash;
 }
 
+/// \brief Input data, mapped to memory when it comes from a regular file and streamed otherwise
+class input_source {
+public:
+    input_source() = default;
+    ~input_source() {
+        if (m_mapped) {
+            os_unmap_file(m_mapped, m_length);
+        }
+    }
+
+    input_source(const input_source &other) = delete;
+    input_source(input_source &&other) noexcept = delete;
+    input_source &operator=(const input_source &other) = delete;
+    input_source &operator=(input_source &&other) noexcept = delete;
+
+    /// \brief Opens input
+    /// \param name Input filename, or nullptr to read from standard input
+    void open(const char *name) {
+        if (!name) {
+            m_file = unique_file_ptr{stdin};
+            return;
+        }
+#ifdef HAVE_MMAP
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(name, ec)) {
+            const auto length = std::filesystem::file_size(name, ec);
+            if (!ec && length > 0) {
+                m_mapped = os_map_file(name, length, false);
+                m_length = length;
+                return;
+            }
+        }
+#endif
+        m_file = unique_fopen(name, "rb");
+    }
+
+    /// \brief Obtains the next chunk of input
+    /// \param max_length Maximum number of bytes to obtain
+    /// \param length Receives the number of bytes obtained, which is less than max_length only at the end of input
+    /// \returns Pointer to chunk data, valid until the next call
+    const unsigned char *next(uint64_t max_length, uint64_t &length) {
+        if (m_mapped) {
+            length = std::min(max_length, m_length - m_offset);
+            const unsigned char *data = m_mapped + m_offset;
+            m_offset += length;
+            return data;
+        }
+        if (m_buffer_length < max_length) {
+            m_buffer = unique_calloc<unsigned char>(max_length, std::nothrow_t{});
+            if (!m_buffer) {
+                error("unable to allocate input buffer\n");
+            }
+            m_buffer_length = max_length;
+        }
+        length = 0;
+        while (length < max_length) {
+            auto got = fread(m_buffer.get() + length, 1, max_length - length, m_file.get());
+            if (got == 0) {
+                if (ferror(m_file.get())) {
+                    error("error reading input\n");
+                }
+                break;
+            }
+            length += got;
+        }
+        return m_buffer.get();
+    }
+
+private:
+    unique_file_ptr m_file{nullptr};
+    unique_calloc_ptr<unsigned char> m_buffer;
+    uint64_t m_buffer_length{0};
+    unsigned char *m_mapped{nullptr};
+    uint64_t m_length{0};
+    uint64_t m_offset{0};
+};
+
 /// \brief Prints help message
 static void help(const char *name) {
     (void) fprintf(stderr, R"(Usage:
@@ -175,6 +269,9 @@ entire 2^log2_root_size range.
 
 The hash function used is Keccak-256.
 
+Leaves are hashed in parallel, and the input file is mapped to memory
+when it is a regular file.
+
 Options:
 
   --input=<filename>                    default: reads from standard input
@@ -189,6 +286,18 @@ Options:
   (> 0 and <= log2_root_size)
   The granularity in which bytes are read from the input file.
 
+  --page-hashes-output=<filename>       default: none
+  Writes the raw hash of each leaf read from the input to a file, one after
+  the other. With --log2-word-size=5 and --log2-leaf-size=12, and an input
+  file as long as the memory range it will back, this file can be passed to
+  replace_memory_range so the machine does not have to hash the new range.
+
+  --jobs=<integer>                      default: number of host threads
+  Number of threads used to hash leaves.
+
+  --report-throughput
+  Prints the amount of data hashed and the throughput to standard error.
+
   --help
   Prints this message and returns.
 )",
@@ -198,21 +307,30 @@ Options:
 
 int main(int argc, char *argv[]) {
     const char *input_name = nullptr;
+    const char *page_hashes_name = nullptr;
     int log2_word_size = 3;
     int log2_leaf_size = 12;
     int log2_root_size = 0;
+    int jobs = 0;
+    bool report_throughput = false;
     // Process command line arguments
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--help") == 0) {
             help(argv[0]);
         } else if (stringval("--input=", argv[i], &input_name)) {
             ;
+        } else if (stringval("--page-hashes-output=", argv[i], &page_hashes_name)) {
+            ;
         } else if (intval("--log2-word-size=", argv[i], &log2_word_size)) {
             ;
         } else if (intval("--log2-leaf-size=", argv[i], &log2_leaf_size)) {
             ;
         } else if (intval("--log2-root-size=", argv[i], &log2_root_size)) {
             ;
+        } else if (intval("--jobs=", argv[i], &jobs)) {
+            ;
+        } else if (strcmp(argv[i], "--report-throughput") == 0) {
+            report_throughput = true;
         } else if (intval("--page-log2-size=", argv[i], &log2_leaf_size)) {
             std::cerr << "--page-log2-size is deprecated. "
                          "use --log2-leaf-size instead\n";
@@ -229,51 +347,125 @@ int main(int argc, char *argv[]) {
             log2_leaf_size, log2_root_size);
         return 1;
     }
-    // Read from stdin if no input name was given
-    auto input_file = unique_file_ptr{stdin};
-    if (input_name) {
-        input_file = unique_fopen(input_name, "ro", std::nothrow_t{});
-        if (!input_file) {
-            error("unable to open input file '%s'\n", input_name);
+    if (jobs < 0) {
+        error("invalid number of jobs (%d)\n", jobs);
+    }
+    const auto start_time = std::chrono::steady_clock::now();
+
+    // Map input file to memory if possible, otherwise stream it
+    input_source input;
+    try {
+        input.open(input_name);
+    } catch (std::exception &e) {
+        error("unable to open input file '%s' (%s)\n", input_name, e.what());
+    }
+
+    // Open file to receive leaf hashes, if requested
+    unique_file_ptr page_hashes_file{nullptr};
+    if (page_hashes_name) {
+        page_hashes_file = unique_fopen(page_hashes_name, "wb", std::nothrow_t{});
+        if (!page_hashes_file) {
+            error("unable to open page hashes output file '%s'\n", page_hashes_name);
             return 1;
         }
     }
 
-    // Allocate buffer for leaf data
-    const uint64_t leaf_size = UINT64_C(1) << log2_leaf_size;
-    auto leaf_buf = unique_calloc<unsigned char>(leaf_size, std::nothrow_t{});
-    if (!leaf_buf) {
-        error("unable to allocate leaf buffer\n");
-        return 1;
+    back_merkle_tree back_tree{log2_root_size, log2_leaf_size, log2_word_size};
+
+    // Input is hashed in parallel in batches of about BATCH_SIZE bytes, and leaves are then added to the tree in
+    // order. Leaves too large to keep all threads busy within a batch are split into units, and the hashes of the
+    // units of each leaf are combined into the leaf hash.
+    const uint64_t n = jobs > 0 ? static_cast<uint64_t>(jobs) : std::max(os_get_concurrency(), UINT64_C(1));
+    int log2_unit_size = log2_leaf_size;
+    while (log2_unit_size > log2_word_size &&
+        (log2_unit_size > BATCH_LOG2_SIZE || (BATCH_SIZE >> log2_unit_size) < n)) {
+        --log2_unit_size;
     }
+    const uint64_t unit_size = UINT64_C(1) << log2_unit_size;
+    const uint64_t batch_units = std::max(UINT64_C(1), BATCH_SIZE >> std::min(log2_unit_size, BATCH_LOG2_SIZE));
+    const uint64_t units_per_leaf = UINT64_C(1) << (log2_leaf_size - log2_unit_size);
+    std::vector<hash_type> unit_hashes(batch_units);
+    const hash_type pristine_unit_hash = get_pristine_leaf_hash(log2_unit_size, log2_word_size);
+    back_merkle_tree leaf_tree{log2_leaf_size, log2_unit_size, log2_word_size};
+    uint64_t leaf_units = 0;
+    std::vector<hash_type> leaf_hashes;
 
-    back_merkle_tree back_tree{log2_root_size, log2_leaf_size, log2_word_size};
+    const auto add_leaves = [&](const hash_type *hashes, uint64_t count) {
+        if (page_hashes_file && fwrite(hashes, sizeof(hash_type), count, page_hashes_file.get()) != count) {
+            error("error writing page hashes\n");
+        }
+        back_tree.push_back_range(hashes, count, n);
+    };
 
-    const uint64_t max_leaves = UINT64_C(1) << (log2_root_size - log2_leaf_size);
-    uint64_t leaf_count = 0;
-    // Loop reading leaves from file until done or error
+    const uint64_t max_units = UINT64_C(1) << (log2_root_size - log2_unit_size);
+    uint64_t unit_count = 0;
+    uint64_t byte_count = 0;
+    // Loop reading batches of units from input until done or error
     while (true) {
-        auto got = fread(leaf_buf.get(), 1, leaf_size, input_file.get());
+        uint64_t got = 0;
+        const unsigned char *batch_data = input.next(batch_units * unit_size, got);
         if (got == 0) {
-            if (ferror(input_file.get())) {
-                error("error reading input\n");
-            } else {
-                break;
-            }
+            break;
         }
-        if (leaf_count >= max_leaves) {
+        const uint64_t count = (got + unit_size - 1) / unit_size;
+        if (count > max_units - unit_count) {
             error("too many leaves for tree\n");
         }
-        // Pad leaf with zeros if file ended before next leaf boundary
-        memset(leaf_buf.get() + got, 0, leaf_size - got);
-        // Compute leaf hash
-        auto leaf_hash = get_leaf_hash(leaf_buf.get(), log2_leaf_size, log2_word_size);
-        // Add leaf to incremental tree
-        back_tree.push_back(leaf_hash);
-        // Compare the root hash for the incremental tree and the
-        // proof-by-proof tree
-        ++leaf_count;
+        // Pad last unit with zeros if input ended before next unit boundary
+        const uint64_t tail = got % unit_size;
+        unique_calloc_ptr<unsigned char> tail_buf;
+        if (tail != 0) {
+            tail_buf = unique_calloc<unsigned char>(unit_size, std::nothrow_t{});
+            if (!tail_buf) {
+                error("unable to allocate leaf buffer\n");
+            }
+            memcpy(tail_buf.get(), batch_data + (count - 1) * unit_size, tail);
+        }
+        // Compute unit hashes, with thread j responsible for unit i if i % n == j
+        os_parallel_for(n, [&](uint64_t j, const parallel_for_mutex & /*mutex*/) -> bool {
+            hasher_type h;
+            for (uint64_t i = j; i < count; i += n) {
+                const unsigned char *unit_data =
+                    (tail != 0 && i == count - 1) ? tail_buf.get() : batch_data + i * unit_size;
+                if (is_pristine(unit_data, unit_size)) {
+                    unit_hashes[i] = pristine_unit_hash;
+                } else {
+                    unit_hashes[i] = get_leaf_hash(h, unit_data, log2_unit_size, log2_word_size);
+                }
+            }
+            return true;
+        });
+        if (units_per_leaf == 1) {
+            add_leaves(unit_hashes.data(), count);
+        } else {
+            leaf_hashes.clear();
+            for (uint64_t i = 0; i < count; ++i) {
+                leaf_tree.push_back(unit_hashes[i]);
+                if (++leaf_units == units_per_leaf) {
+                    leaf_hashes.push_back(leaf_tree.get_root_hash());
+                    leaf_tree = back_merkle_tree{log2_leaf_size, log2_unit_size, log2_word_size};
+                    leaf_units = 0;
+                }
+            }
+            add_leaves(leaf_hashes.data(), leaf_hashes.size());
+        }
+        unit_count += count;
+        byte_count += got;
+    }
+    // Last leaf is padded with zeros if input ended before next leaf boundary
+    if (leaf_units != 0) {
+        const hash_type leaf_hash = leaf_tree.get_root_hash();
+        add_leaves(&leaf_hash, 1);
+    }
+    if (page_hashes_file && fclose(page_hashes_file.release()) != 0) {
+        error("error writing page hashes\n");
     }
     print_hash(back_tree.get_root_hash(), stdout);
+    if (report_throughput) {
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        const double mib = static_cast<double>(byte_count) / (1024.0 * 1024.0);
+        (void) fprintf(stderr, "hashed %.1f MiB in %.3f s (%.1f MiB/s, %" PRIu64 " jobs)\n", mib,
+            elapsed.count(), elapsed.count() > 0 ? mib / elapsed.count() : 0.0, n);
+    }
     return 0;
 }
@@ -65,4 +65,16 @@
 #define HAVE_USLEEP
 #endif
 
+#if !defined(NO_FORK) && !defined(__wasi__) && !defined(_WIN32)
+#define HAVE_FORK
+#endif
+
+#if !defined(NO_THREAD_AFFINITY) && defined(__linux__)
+#define HAVE_THREAD_AFFINITY
+#endif
+
+#if !defined(NO_SOFT_DIRTY) && defined(__linux__) && !defined(NO_MMAP)
+#define HAVE_SOFT_DIRTY
+#endif
+
 #endif
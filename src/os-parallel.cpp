@@ -0,0 +1,373 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "os-features.h"
+#include "os-parallel.h"
+
+#ifdef HAVE_THREADS
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#if defined(HAVE_THREAD_AFFINITY) || defined(HAVE_FORK)
+#include <pthread.h> // pthread_setaffinity_np/pthread_atfork
+#endif
+#endif
+
+namespace cartesi {
+
+uint64_t os_get_concurrency() {
+#ifdef HAVE_THREADS
+    return std::thread::hardware_concurrency();
+#else
+    return 1;
+#endif
+}
+
+/// \brief Tasks submitted by a single os_parallel_for() or os_parallel_for_async() call
+struct os_parallel_for_batch {
+    os_parallel_for_batch(std::function<bool(uint64_t j, const parallel_for_mutex &mutex)> task, uint64_t n) :
+        task{std::move(task)},
+        n{n}
+#ifdef HAVE_THREADS
+        ,
+        for_mutex{[this] { mutex.lock(); }, [this] { mutex.unlock(); }},
+        remaining{n}
+#endif
+    {
+    }
+
+    std::function<bool(uint64_t j, const parallel_for_mutex &mutex)> task;
+    uint64_t n;
+    bool queued{false}; ///< True if tasks were queued to the thread pool, false if they run when waited for
+#ifdef HAVE_THREADS
+    std::mutex mutex; ///< Mutex exposed to tasks
+    parallel_for_mutex for_mutex;
+    std::atomic<bool> succeeded{true};
+    std::mutex done_mutex; ///< Guards remaining reaching zero and exception
+    std::condition_variable done_cv;
+    uint64_t remaining;
+    std::exception_ptr exception;
+#endif
+};
+
+#ifdef HAVE_THREADS
+
+namespace {
+
+/// \brief Task queued to the thread pool
+struct thread_pool_item {
+    std::shared_ptr<os_parallel_for_batch> batch;
+    uint64_t j;
+};
+
+/// \brief Work-stealing thread pool
+/// \details Each worker has its own queue. Workers take tasks from the back of their own queue
+/// and steal from the front of the others. Threads waiting for a batch help by stealing too.
+class thread_pool {
+    struct worker_queue {
+        std::mutex mutex;
+        std::deque<thread_pool_item> items;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_sleep_cv;
+    std::atomic<int64_t> m_queued{0};
+    bool m_stop{false};
+    std::atomic<uint64_t> m_next_queue{0};
+    std::atomic<uint64_t> m_batches{0};
+    std::atomic<uint64_t> m_tasks{0};
+    std::atomic<uint64_t> m_steals{0};
+
+    /// \brief Takes a task from worker queue i, or steals one from the other queues
+    /// \param only If not null, only tasks from this batch are taken
+    bool try_pop(size_t i, thread_pool_item &item, const os_parallel_for_batch *only = nullptr) {
+        const size_t count = m_queues.size();
+        if (i < count && only == nullptr) {
+            auto &q = *m_queues[i];
+            const std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.items.empty()) {
+                item = q.items.back();
+                q.items.pop_back();
+                --m_queued;
+                return true;
+            }
+        }
+        for (size_t k = 1; k <= count; ++k) {
+            auto &q = *m_queues[(i + k) % count];
+            const std::lock_guard<std::mutex> lock(q.mutex);
+            auto it = q.items.begin();
+            if (only != nullptr) {
+                it = std::find_if(q.items.begin(), q.items.end(),
+                    [only](const thread_pool_item &queued) { return queued.batch.get() == only; });
+            }
+            if (it != q.items.end()) {
+                item = std::move(*it);
+                q.items.erase(it);
+                --m_queued;
+                ++m_steals;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(const thread_pool_item &item) {
+        os_parallel_for_batch &b = *item.batch;
+        bool ok = false;
+        std::exception_ptr exception;
+        try {
+            ok = b.task(item.j, b.for_mutex);
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        if (!ok) {
+            b.succeeded = false;
+        }
+        ++m_tasks;
+        const std::lock_guard<std::mutex> lock(b.done_mutex);
+        if (exception && !b.exception) {
+            b.exception = exception;
+        }
+        if (--b.remaining == 0) {
+            b.done_cv.notify_all();
+        }
+    }
+
+    void work(size_t i) {
+        for (;;) {
+            thread_pool_item item{};
+            if (try_pop(i, item)) {
+                run(item);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            m_sleep_cv.wait(lock, [this] { return m_stop || m_queued > 0; });
+            if (m_stop) {
+                return;
+            }
+        }
+    }
+
+public:
+    thread_pool(uint64_t threads, bool pin) {
+        for (uint64_t i = 0; i < threads; ++i) {
+            m_queues.push_back(std::make_unique<worker_queue>());
+        }
+        for (uint64_t i = 0; i < threads; ++i) {
+            m_workers.emplace_back([this, i] { work(i); });
+#ifdef HAVE_THREAD_AFFINITY
+            if (pin) {
+                const uint64_t cpus = std::max<uint64_t>(std::thread::hardware_concurrency(), 1);
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(i % cpus, &set);
+                // Pinning is only a hint, so failures are ignored
+                (void) pthread_setaffinity_np(m_workers.back().native_handle(), sizeof(set), &set);
+            }
+#else
+            (void) pin;
+#endif
+        }
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool(thread_pool &&) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+    thread_pool &operator=(thread_pool &&) = delete;
+
+    ~thread_pool() {
+        {
+            const std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_stop = true;
+        }
+        m_sleep_cv.notify_all();
+        for (auto &w : m_workers) {
+            w.join();
+        }
+    }
+
+    uint64_t get_threads() const {
+        return m_workers.size();
+    }
+
+    os_thread_pool_stats get_stats() const {
+        return os_thread_pool_stats{m_workers.size(), m_batches, m_tasks, m_steals};
+    }
+
+    /// \brief Queues all tasks in a batch and returns immediately
+    void submit(const std::shared_ptr<os_parallel_for_batch> &b) {
+        ++m_batches;
+        b->queued = true;
+        // Spread tasks over worker queues, starting where the previous batch stopped
+        const size_t count = m_queues.size();
+        const uint64_t first = m_next_queue.fetch_add(b->n);
+        for (uint64_t j = 0; j < b->n; ++j) {
+            auto &q = *m_queues[(first + j) % count];
+            const std::lock_guard<std::mutex> lock(q.mutex);
+            q.items.push_back(thread_pool_item{b, j});
+        }
+        {
+            const std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_queued += static_cast<int64_t>(b->n);
+        }
+        m_sleep_cv.notify_all();
+    }
+
+    /// \brief Helps running the tasks in a batch until all of them are done
+    void wait(os_parallel_for_batch &b) {
+        thread_pool_item item{};
+        while (try_pop(m_queues.size(), item, &b)) {
+            run(item);
+        }
+        std::unique_lock<std::mutex> lock(b.done_mutex);
+        b.done_cv.wait(lock, [&b] { return b.remaining == 0; });
+    }
+};
+
+std::mutex g_thread_pool_mutex;           // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+std::unique_ptr<thread_pool> g_thread_pool; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+uint64_t g_thread_pool_threads = 0;       // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+bool g_thread_pool_pin = false;           // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+/// \brief Returns the process-wide thread pool, creating it if needed
+/// \details Must be called with g_thread_pool_mutex held
+thread_pool &get_thread_pool() {
+    if (!g_thread_pool) {
+#ifdef HAVE_FORK
+        // Worker threads are not inherited by children, so children must create their own pool.
+        // The parent's pool cannot be destroyed in the child either, so it is simply forgotten.
+        static const int registered = pthread_atfork(nullptr, nullptr, [] { (void) g_thread_pool.release(); });
+        (void) registered;
+#endif
+        uint64_t threads = g_thread_pool_threads;
+        if (threads == 0) {
+            threads = std::max<uint64_t>(std::thread::hardware_concurrency(), 2) - 1;
+        }
+        g_thread_pool = std::make_unique<thread_pool>(threads, g_thread_pool_pin);
+    }
+    return *g_thread_pool;
+}
+
+} // namespace
+
+#endif
+
+void os_configure_thread_pool(uint64_t threads, bool pin) {
+#ifdef HAVE_THREADS
+    const std::lock_guard<std::mutex> lock(g_thread_pool_mutex);
+    g_thread_pool_threads = threads;
+    g_thread_pool_pin = pin;
+    // Workers will be recreated with the new configuration on next use
+    g_thread_pool.reset();
+#else
+    (void) threads;
+    (void) pin;
+#endif
+}
+
+os_thread_pool_stats os_get_thread_pool_stats() {
+#ifdef HAVE_THREADS
+    const std::lock_guard<std::mutex> lock(g_thread_pool_mutex);
+    if (g_thread_pool) {
+        return g_thread_pool->get_stats();
+    }
+#endif
+    return os_thread_pool_stats{};
+}
+
+os_parallel_for_handle os_parallel_for_async(uint64_t n,
+    std::function<bool(uint64_t j, const parallel_for_mutex &mutex)> task) {
+    auto b = std::make_shared<os_parallel_for_batch>(std::move(task), n);
+#ifdef HAVE_THREADS
+    if (n > 0) {
+        const std::lock_guard<std::mutex> lock(g_thread_pool_mutex);
+        auto &pool = get_thread_pool();
+        if (pool.get_threads() > 0) {
+            pool.submit(b);
+        }
+    }
+#endif
+    return b;
+}
+
+bool os_parallel_for_done(const os_parallel_for_handle &handle) {
+    if (!handle) {
+        throw std::invalid_argument{"invalid parallel for handle"};
+    }
+#ifdef HAVE_THREADS
+    if (handle->queued) {
+        const std::lock_guard<std::mutex> lock(handle->done_mutex);
+        return handle->remaining == 0;
+    }
+#endif
+    return handle->n == 0;
+}
+
+bool os_parallel_for_wait(const os_parallel_for_handle &handle) {
+    if (!handle) {
+        throw std::invalid_argument{"invalid parallel for handle"};
+    }
+    auto &b = *handle;
+#ifdef HAVE_THREADS
+    if (b.queued) {
+        thread_pool *pool = nullptr;
+        {
+            const std::lock_guard<std::mutex> lock(g_thread_pool_mutex);
+            pool = &get_thread_pool();
+        }
+        pool->wait(b);
+        if (b.exception) {
+            std::rethrow_exception(b.exception);
+        }
+        return b.succeeded;
+    }
+#endif
+    // Tasks were not queued, so run them now without extra threads
+    const parallel_for_mutex for_mutex{[] {}, [] {}};
+    bool succeeded = true;
+    for (uint64_t j = 0; j < b.n; ++j) {
+        succeeded = succeeded && b.task(j, for_mutex);
+    }
+    b.n = 0;
+    return succeeded;
+}
+
+bool os_parallel_for(uint64_t n, const std::function<bool(uint64_t j, const parallel_for_mutex &mutex)> &task) {
+    // Concurrency of 1 runs in the calling thread, without dispatching to the pool
+    if (n > 1) {
+        return os_parallel_for_wait(os_parallel_for_async(n, task));
+    }
+    const parallel_for_mutex for_mutex{[] {}, [] {}};
+    bool succeeded = true;
+    for (uint64_t j = 0; j < n; ++j) {
+        succeeded = succeeded && task(j, for_mutex);
+    }
+    return succeeded;
+}
+
+} // namespace cartesi
@@ -0,0 +1,105 @@
+// Copyright Cartesi and individual authors (see AUTHORS)
+// SPDX-License-Identifier: LGPL-3.0-or-later
+//
+// This program is free software: you can redistribute it and/or modify it under
+// the terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation, either version 3 of the License, or (at your option) any
+// later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE. See the GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License along
+// with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef OS_PARALLEL_H
+#define OS_PARALLEL_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+/// \file
+/// \brief Process-wide thread pool used to run loops in parallel
+/// \details Kept apart from os.h so the Merkle tree library can share it without the rest of the OS layer.
+
+namespace cartesi {
+
+/// \brief Get the number of concurrent threads supported by the OS
+uint64_t os_get_concurrency();
+
+/// \brief Mutex for os_parallel_for()
+struct parallel_for_mutex {
+    std::function<void()> lock;
+    std::function<void()> unlock;
+};
+
+/// \brief Mutex guard for os_parallel_for()
+struct parallel_for_mutex_guard {
+    parallel_for_mutex_guard(const parallel_for_mutex &mutex) : mutex(mutex) {
+        mutex.lock();
+    }
+    ~parallel_for_mutex_guard() { // NOLINT(bugprone-exception-escape)
+        mutex.unlock();
+    }
+
+    parallel_for_mutex_guard() = delete;
+    parallel_for_mutex_guard(const parallel_for_mutex_guard &) = default;
+    parallel_for_mutex_guard(parallel_for_mutex_guard &&) = default;
+    parallel_for_mutex_guard &operator=(const parallel_for_mutex_guard &) = delete;
+    parallel_for_mutex_guard &operator=(parallel_for_mutex_guard &&) = delete;
+
+private:
+    parallel_for_mutex mutex;
+};
+
+/// \brief Runs a for loop in parallel using up to n threads
+/// \return True if all thread tasks succeeded
+/// \details Tasks are executed by a process-wide pool of worker threads, with
+/// the calling thread helping until all of them are done.
+bool os_parallel_for(uint64_t n, const std::function<bool(uint64_t j, const parallel_for_mutex &mutex)> &task);
+
+/// \brief Loop started by os_parallel_for_async()
+struct os_parallel_for_batch;
+
+/// \brief Handle to a loop started by os_parallel_for_async()
+using os_parallel_for_handle = std::shared_ptr<os_parallel_for_batch>;
+
+/// \brief Starts a for loop in parallel using up to n threads, without waiting for it to finish
+/// \return Handle to be passed to os_parallel_for_wait()
+/// \details Tasks are executed by the same pool as os_parallel_for(). When there are no worker
+/// threads, tasks only run when the loop is waited for. The task is kept alive until then.
+os_parallel_for_handle os_parallel_for_async(uint64_t n,
+    std::function<bool(uint64_t j, const parallel_for_mutex &mutex)> task);
+
+/// \brief Checks if all tasks in a loop started by os_parallel_for_async() are done
+bool os_parallel_for_done(const os_parallel_for_handle &handle);
+
+/// \brief Waits for a loop started by os_parallel_for_async(), helping to run its tasks
+/// \return True if all thread tasks succeeded
+bool os_parallel_for_wait(const os_parallel_for_handle &handle);
+
+/// \brief Statistics for the thread pool used by os_parallel_for()
+struct os_thread_pool_stats {
+    uint64_t threads; ///< Number of worker threads
+    uint64_t batches; ///< Number of loops dispatched to the pool
+    uint64_t tasks;   ///< Number of tasks executed
+    uint64_t steals;  ///< Number of tasks executed by a thread other than the worker they were queued to
+};
+
+/// \brief Configures the thread pool used by os_parallel_for()
+/// \param threads Number of worker threads, or 0 to use one less than os_get_concurrency()
+/// \param pin Pin each worker thread to a different CPU, when supported
+/// \details Workers are created on first use. Must not be called while
+/// os_parallel_for() is running in another thread, or while loops started by
+/// os_parallel_for_async() have not been waited for.
+void os_configure_thread_pool(uint64_t threads, bool pin);
+
+/// \brief Returns statistics for the thread pool used by os_parallel_for()
+os_thread_pool_stats os_get_thread_pool_stats();
+
+} // namespace cartesi
+
+#endif
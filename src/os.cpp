@@ -14,14 +14,19 @@
 // with this program (see COPYING). If not, see <https://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <system_error>
+#include <utility>
 #include <vector>
 
 #include "os-features.h"
@@ -33,9 +38,8 @@
 #endif
 
 #ifdef HAVE_THREADS
-#include <future>
+#include <exception>
 #include <mutex>
-#include <thread>
 #endif
 
 #if defined(HAVE_TTY) || defined(HAVE_MMAP) || defined(HAVE_TERMIOS) || defined(_WIN32)
@@ -84,14 +88,19 @@
 
 #else // not _WIN32
 
-#if defined(HAVE_TTY) || defined(HAVE_MMAP) || defined(HAVE_TERMIOS) || defined(HAVE_USLEEP)
-#include <unistd.h> // write/read/close
+#if defined(HAVE_TTY) || defined(HAVE_MMAP) || defined(HAVE_TERMIOS) || defined(HAVE_USLEEP) || defined(HAVE_POSIX_FS)
+#include <unistd.h> // write/read/close/pwrite/pread
 #endif
 
 #if defined(HAVE_SELECT)
 #include <sys/select.h> // select
 #endif
 
+#ifdef HAVE_FORK
+#include <poll.h>     // poll
+#include <sys/wait.h> // waitpid
+#endif
+
 #define plat_write write
 #define plat_mkdir mkdir
 
@@ -655,6 +664,49 @@ unsigned char *os_map_file(const char *path, uint64_t length, bool shared) {
 #endif // HAVE_MMAP
 }
 
+bool os_get_file_data_extents(const char *path, uint64_t length,
+    const std::function<void(uint64_t offset, uint64_t length)> &f) {
+#if defined(HAVE_MMAP) && defined(SEEK_DATA) && defined(SEEK_HOLE)
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat statbuf {};
+    if (fstat(fd, &statbuf) < 0) {
+        close(fd);
+        return false;
+    }
+    const auto end = static_cast<off_t>(std::min(length, static_cast<uint64_t>(statbuf.st_size)));
+    off_t offset = 0;
+    while (offset < end) {
+        const off_t data = lseek(fd, offset, SEEK_DATA);
+        if (data < 0) {
+            // ENXIO means there is no more data past offset
+            const bool ok = errno == ENXIO;
+            close(fd);
+            return ok;
+        }
+        if (data >= end) {
+            break;
+        }
+        const off_t hole = lseek(fd, data, SEEK_HOLE);
+        if (hole < 0) {
+            close(fd);
+            return false;
+        }
+        offset = std::min(hole, end);
+        f(static_cast<uint64_t>(data), static_cast<uint64_t>(offset - data));
+    }
+    close(fd);
+    return true;
+#else
+    (void) path;
+    (void) length;
+    (void) f;
+    return false;
+#endif
+}
+
 void os_unmap_file(unsigned char *host_memory, uint64_t length) {
 #ifdef HAVE_MMAP
     munmap(host_memory, length);
@@ -670,51 +722,289 @@ void os_unmap_file(unsigned char *host_memory, uint64_t length) {
 #endif // HAVE_MMAP
 }
 
-int64_t os_now_us() {
-    std::chrono::time_point<std::chrono::high_resolution_clock> start{};
-    static bool started = false;
-    if (!started) {
-        started = true;
-        start = std::chrono::high_resolution_clock::now();
+unsigned char *os_map_anonymous(uint64_t length) {
+#ifdef HAVE_MMAP
+    auto *host_memory = static_cast<unsigned char *>(
+        mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (host_memory == MAP_FAILED) { // NOLINT(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+        throw std::system_error{errno, std::generic_category(), "could not map anonymous memory"s};
     }
-    auto end = std::chrono::high_resolution_clock::now();
-    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+    return host_memory;
+#else
+    (void) length;
+    return nullptr;
+#endif
 }
 
-uint64_t os_get_concurrency() {
-#ifdef HAVE_THREADS
-    return std::thread::hardware_concurrency();
+bool os_discard_anonymous(unsigned char *host_memory, uint64_t length) {
+#if defined(HAVE_MMAP) && defined(MADV_DONTNEED)
+    static const auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const auto address = reinterpret_cast<uintptr_t>(host_memory); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (address % page_size != 0 || length % page_size != 0) {
+        return false;
+    }
+    return madvise(host_memory, length, MADV_DONTNEED) == 0;
+#else
+    (void) host_memory;
+    (void) length;
+    return false;
+#endif
+}
+
+bool os_advise_huge_pages(unsigned char *host_memory, uint64_t length) {
+#if defined(HAVE_MMAP) && defined(MADV_HUGEPAGE)
+    return madvise(host_memory, length, MADV_HUGEPAGE) == 0;
+#else
+    (void) host_memory;
+    (void) length;
+    return false;
+#endif
+}
+
+bool os_advise_will_need(unsigned char *host_memory, uint64_t length) {
+#if defined(HAVE_MMAP) && defined(MADV_WILLNEED)
+    return madvise(host_memory, length, MADV_WILLNEED) == 0;
 #else
-    return 1;
+    (void) host_memory;
+    (void) length;
+    return false;
 #endif
 }
 
-bool os_parallel_for(uint64_t n, const std::function<bool(uint64_t j, const parallel_for_mutex &mutex)> &task) {
+#if !defined(HAVE_POSIX_FS) && defined(HAVE_THREADS)
+/// \brief Serializes seeks followed by reads or writes, on hosts without positioned I/O
+static std::mutex &get_file_at_mutex(void) {
+    static std::mutex mutex;
+    return mutex;
+}
+#endif
+
+bool os_write_at(FILE *fp, const void *data, uint64_t length, uint64_t offset) {
+#ifdef HAVE_POSIX_FS
+    const int fd = fileno(fp);
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    while (length > 0) {
+        const auto written = pwrite(fd, bytes, length, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        offset += written;
+        length -= written;
+    }
+    return true;
+#else
 #ifdef HAVE_THREADS
-    if (n > 1) {
-        std::mutex mutex;
-        const parallel_for_mutex for_mutex = {[&] { mutex.lock(); }, [&] { mutex.unlock(); }};
-        std::vector<std::future<bool>> futures;
-        futures.reserve(n);
-        for (uint64_t j = 0; j < n; ++j) {
-            futures.emplace_back(std::async(std::launch::async, task, j, for_mutex));
+    const std::lock_guard<std::mutex> lock(get_file_at_mutex());
+#endif
+    return fseek(fp, static_cast<long>(offset), SEEK_SET) == 0 && fwrite(data, 1, length, fp) == length &&
+        fflush(fp) == 0;
+#endif
+}
+
+bool os_read_at(FILE *fp, void *data, uint64_t length, uint64_t offset) {
+#ifdef HAVE_POSIX_FS
+    const int fd = fileno(fp);
+    auto *bytes = static_cast<unsigned char *>(data);
+    while (length > 0) {
+        const auto read = pread(fd, bytes, length, static_cast<off_t>(offset));
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            return false;
+        }
+        bytes += read;
+        offset += read;
+        length -= read;
+    }
+    return true;
+#else
+#ifdef HAVE_THREADS
+    const std::lock_guard<std::mutex> lock(get_file_at_mutex());
+#endif
+    return fseek(fp, static_cast<long>(offset), SEEK_SET) == 0 && fread(data, 1, length, fp) == length;
+#endif
+}
+
+bool os_map_file_private(const char *path, uint64_t offset, unsigned char *host_memory, uint64_t length,
+    uint64_t &mapped_length) {
+    mapped_length = 0;
+#ifdef HAVE_MMAP
+    static const auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const auto address = reinterpret_cast<uintptr_t>(host_memory); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (address % page_size != 0 || offset % page_size != 0) {
+        return false;
+    }
+
+    // Try to open image file
+    const int backing_file = open(path, O_RDONLY);
+    if (backing_file < 0) {
+        throw std::system_error{errno, std::generic_category(), "could not open image file '"s + path + "'"s};
+    }
+
+    // Try to get file size
+    struct stat statbuf {};
+    if (fstat(backing_file, &statbuf) < 0) {
+        close(backing_file);
+        throw std::system_error{errno, std::generic_category(),
+            "unable to obtain length of image file '"s + path + "'"s};
+    }
+
+    // The mapping covers whole host pages, and must not spill past the end of memory
+    const auto file_length = static_cast<uint64_t>(statbuf.st_size);
+    const uint64_t part_length = std::min(file_length > offset ? file_length - offset : 0, length);
+    const uint64_t file_pages_length = (part_length + page_size - 1) & ~(page_size - 1);
+    if (file_pages_length > length) {
+        close(backing_file);
+        return false;
+    }
+
+    // Replace the start of memory with a private mapping of the file
+    if (file_pages_length > 0) {
+        auto *file_memory = mmap(host_memory, file_pages_length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+            backing_file, static_cast<off_t>(offset));
+        if (file_memory == MAP_FAILED) { // NOLINT(cppcoreguidelines-pro-type-cstyle-cast,performance-no-int-to-ptr)
+            close(backing_file);
+            throw std::system_error{errno, std::generic_category(),
+                "could not map image file '"s + path + "' to memory"s};
+        }
+    }
+
+    // We can close the file after mapping it, because the OS will retain a reference of the file on its own
+    close(backing_file);
+    mapped_length = file_pages_length;
+    return true;
+#else
+    (void) path;
+    (void) offset;
+    (void) host_memory;
+    (void) length;
+    return false;
+#endif
+}
+
+#ifdef HAVE_SOFT_DIRTY
+static std::atomic<bool> soft_dirty_acquired{false}; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+
+// Reads the pagemap entries of the host pages covering a range, starting at the page containing addr
+static bool read_pagemap(int fd, uintptr_t addr, uint64_t page_size, std::vector<uint64_t> &entries) {
+    const auto offset = static_cast<off_t>((addr / page_size) * sizeof(uint64_t));
+    const auto length = entries.size() * sizeof(uint64_t);
+    return pread(fd, entries.data(), length, offset) == static_cast<ssize_t>(length);
+}
+
+static bool is_soft_dirty(uint64_t entry) {
+    return ((entry >> 55) & 1) != 0;
+}
+
+// Some kernels accept clear_refs but do not maintain soft-dirty bits, so actually watch a page get dirty
+static bool probe_soft_dirty(void) {
+    const auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    unsigned char *page = os_map_anonymous(page_size);
+    bool ok = false;
+    const int fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd >= 0) {
+        std::vector<uint64_t> entry(1);
+        page[0] = 1;
+        const auto addr = reinterpret_cast<uintptr_t>(page); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+        if (os_soft_dirty_clear() && read_pagemap(fd, addr, page_size, entry) && !is_soft_dirty(entry[0])) {
+            page[0] = 2;
+            ok = read_pagemap(fd, addr, page_size, entry) && is_soft_dirty(entry[0]);
         }
-        // Check if any thread failed
-        bool succeeded = true;
-        for (auto &f : futures) {
-            succeeded = succeeded && f.get();
+        close(fd);
+    }
+    os_unmap_file(page, page_size);
+    return ok;
+}
+#endif
+
+bool os_soft_dirty_acquire(void) {
+#ifdef HAVE_SOFT_DIRTY
+    if (soft_dirty_acquired.exchange(true)) {
+        return false;
+    }
+    if (!probe_soft_dirty() || !os_soft_dirty_clear()) {
+        soft_dirty_acquired = false;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void os_soft_dirty_release(void) {
+#ifdef HAVE_SOFT_DIRTY
+    soft_dirty_acquired = false;
+#endif
+}
+
+bool os_soft_dirty_clear(void) {
+#ifdef HAVE_SOFT_DIRTY
+    const int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    const bool ok = write(fd, "4", 1) == 1;
+    close(fd);
+    return ok;
+#else
+    return false;
+#endif
+}
+
+bool os_soft_dirty_for_each(const unsigned char *host_memory, uint64_t length,
+    const std::function<void(uint64_t offset, uint64_t length)> &f) {
+#ifdef HAVE_SOFT_DIRTY
+    static const auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    constexpr uint64_t entries_per_read = 4096;
+    const int fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    const auto start = reinterpret_cast<uintptr_t>(host_memory); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    const uintptr_t first_page = start - start % page_size;
+    const uint64_t pages = (start + length - first_page + page_size - 1) / page_size;
+    std::vector<uint64_t> entries;
+    for (uint64_t i = 0; i < pages; i += entries_per_read) {
+        entries.resize(std::min(entries_per_read, pages - i));
+        if (!read_pagemap(fd, first_page + i * page_size, page_size, entries)) {
+            close(fd);
+            return false;
+        }
+        for (uint64_t j = 0; j < entries.size(); ++j) {
+            if (is_soft_dirty(entries[j])) {
+                // Clip first and last pages to the range
+                const uintptr_t page = first_page + (i + j) * page_size;
+                const uintptr_t begin = std::max<uintptr_t>(page, start);
+                const uintptr_t end = std::min<uintptr_t>(page + page_size, start + length);
+                f(begin - start, end - begin);
+            }
         }
-        // Return overall status
-        return succeeded;
     }
+    close(fd);
+    return true;
+#else
+    (void) host_memory;
+    (void) length;
+    (void) f;
+    return false;
 #endif
-    // Run without extra threads when concurrency is 1 or as fallback
-    const parallel_for_mutex for_mutex{[] {}, [] {}};
-    bool succeeded = true;
-    for (uint64_t j = 0; j < n; ++j) {
-        succeeded = succeeded && task(j, for_mutex);
+}
+
+int64_t os_now_us() {
+    std::chrono::time_point<std::chrono::high_resolution_clock> start{};
+    static bool started = false;
+    if (!started) {
+        started = true;
+        start = std::chrono::high_resolution_clock::now();
     }
-    return succeeded;
+    auto end = std::chrono::high_resolution_clock::now();
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
 }
 
 bool os_select_fds(const os_select_before_callback &before_cb, const os_select_after_callback &after_cb,
@@ -786,4 +1076,138 @@ void os_sleep_us(uint64_t timeout_us) {
     Sleep(timeout_us / 1000);
 #endif
 }
+
+/// \brief Task running in a child process, started by os_fork_task()
+struct os_forked_task {
+    int pid{-1};       ///< Child process
+    int fd{-1};        ///< Read end of pipe the child reports its outcome to
+    std::string error; ///< Error message from the child, once done
+    bool done{false};  ///< True once the outcome was collected
+
+    os_forked_task() = default;
+    os_forked_task(const os_forked_task &other) = delete;
+    os_forked_task(os_forked_task &&other) = delete;
+    os_forked_task &operator=(const os_forked_task &other) = delete;
+    os_forked_task &operator=(os_forked_task &&other) = delete;
+
+    ~os_forked_task() {
+        try {
+            collect();
+        } catch (...) { // NOLINT(bugprone-empty-catch)
+        }
+    }
+
+    /// \brief Reads the outcome of the child, blocking until it exits
+    void collect() {
+#ifdef HAVE_FORK
+        if (done) {
+            return;
+        }
+        // The child writes its outcome at once when done, and the pipe is closed when it exits
+        std::string output;
+        std::array<char, 256> buffer{};
+        for (;;) {
+            const auto n = read(fd, buffer.data(), buffer.size());
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            output.append(buffer.data(), static_cast<size_t>(n));
+        }
+        close(fd);
+        // Children are reaped by the host when SIGCHLD is ignored, so errors here are harmless
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        done = true;
+        if (output.empty()) {
+            error = "forked task ended unexpectedly";
+        } else if (output[0] != 0) {
+            error = output.substr(1);
+        }
+#endif
+    }
+};
+
+os_forked_task_handle os_fork_task(const std::function<void()> &task) {
+#ifdef HAVE_FORK
+    std::array<int, 2> fds{};
+    if (pipe(fds.data()) != 0) {
+        throw std::system_error{errno, std::generic_category(), "error creating pipe for forked task"};
+    }
+    const int pid = fork();
+    if (pid < 0) {
+        const int errno_copy = errno;
+        close(fds[0]);
+        close(fds[1]);
+        throw std::system_error{errno_copy, std::generic_category(), "error forking task"};
+    }
+    if (pid == 0) {
+        // The child reports a status byte followed by the error message, if any, and exits without running
+        // any of the destructors or exit handlers of the parent
+        close(fds[0]);
+        std::string output(1, 0);
+        try {
+            task();
+        } catch (std::exception &e) {
+            output = std::string(1, 1) + e.what();
+        } catch (...) {
+            output = std::string(1, 1) + "unknown error in forked task";
+        }
+        const char *data = output.data();
+        size_t length = output.size();
+        while (length > 0) {
+            const auto n = write(fds[1], data, length);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            data += n;
+            length -= static_cast<size_t>(n);
+        }
+        _exit(output[0]);
+    }
+    close(fds[1]);
+    auto handle = std::make_shared<os_forked_task>();
+    handle->pid = pid;
+    handle->fd = fds[0];
+    return handle;
+#else
+    (void) task;
+    throw std::runtime_error{"forking tasks is not supported"};
+#endif
+}
+
+bool os_forked_task_done(const os_forked_task_handle &handle) {
+    if (!handle) {
+        throw std::invalid_argument{"invalid forked task handle"};
+    }
+#ifdef HAVE_FORK
+    if (handle->done) {
+        return true;
+    }
+    pollfd pfd{handle->fd, POLLIN, 0};
+    int ret = 0;
+    while ((ret = poll(&pfd, 1, 0)) < 0 && errno == EINTR) {
+    }
+    return ret != 0;
+#else
+    return true;
+#endif
+}
+
+void os_forked_task_wait(const os_forked_task_handle &handle) {
+    if (!handle) {
+        throw std::invalid_argument{"invalid forked task handle"};
+    }
+    handle->collect();
+    if (!handle->error.empty()) {
+        throw std::runtime_error{handle->error};
+    }
+}
+
 } // namespace cartesi
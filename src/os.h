@@ -18,7 +18,11 @@
 #define OS_H
 
 #include <cstdint>
+#include <cstdio>
 #include <functional>
+#include <memory>
+
+#include "os-parallel.h"
 
 /// \file
 /// \brief System-specific OS handling operations
@@ -94,40 +98,112 @@ unsigned char *os_map_file(const char *path, uint64_t length, bool shared);
 /// \brief Unmaps a file from memory
 void os_unmap_file(unsigned char *host_memory, uint64_t length);
 
+/// \brief Enumerates the parts of a file that hold data, skipping holes of sparse files
+/// \param path Path to file
+/// \param length Only the first length bytes of the file are considered
+/// \param f Function called with offset and length of each part holding data, in increasing order
+/// \returns True if successful, false if holes cannot be found (then f may have been called for some parts,
+/// and the whole file should be assumed to hold data)
+bool os_get_file_data_extents(const char *path, uint64_t length,
+    const std::function<void(uint64_t offset, uint64_t length)> &f);
+
+/// \brief Maps private memory filled with zeros
+/// \returns Start of memory, to be unmapped with os_unmap_file(), or nullptr if not supported
+unsigned char *os_map_anonymous(uint64_t length);
+
+/// \brief Returns pages of memory mapped by os_map_anonymous() to the OS
+/// \returns True if successful, false if not supported or if range is not aligned to host pages
+/// \details Pages read as zeros after this, and only take up host memory again when written to.
+bool os_discard_anonymous(unsigned char *host_memory, uint64_t length);
+
+/// \brief Asks the OS to back memory mapped by os_map_anonymous() with transparent huge pages
+/// \returns True if successful, false if not supported
+/// \details Only the parts of memory that cover whole huge pages can use them.
+bool os_advise_huge_pages(unsigned char *host_memory, uint64_t length);
+
+/// \brief Asks the OS to start reading memory mapped from a file in the background
+/// \returns True if successful, false if not supported
+bool os_advise_will_need(unsigned char *host_memory, uint64_t length);
+
+/// \brief Writes data to a file at an offset, without using the file position
+/// \param fp File
+/// \param data Data to write
+/// \param length Length of data
+/// \param offset Offset in file
+/// \returns True if all data was written, false otherwise (errno tells why)
+/// \details Concurrent calls on the same file are safe, as long as they write to different parts of it.
+/// Data must not be written through fp at the same time.
+bool os_write_at(FILE *fp, const void *data, uint64_t length, uint64_t offset);
+
+/// \brief Reads data from a file at an offset, without using the file position
+/// \param fp File
+/// \param data Receives data
+/// \param length Length of data
+/// \param offset Offset in file
+/// \returns True if all data was read, false otherwise
+/// \details Concurrent calls on the same file are safe.
+bool os_read_at(FILE *fp, void *data, uint64_t length, uint64_t offset);
+
+/// \brief Maps part of a file privately over memory mapped by os_map_anonymous()
+/// \param path Path to file
+/// \param offset Offset in file of the part to map
+/// \param host_memory Start of memory
+/// \param length Length of memory
+/// \param mapped_length Receives the length of memory now backed by the file
+/// \returns True if successful, false if not supported, if offset is not aligned to host pages, or if the
+/// part of the file does not fit in whole host pages of memory
+/// \details At most length bytes of the file are mapped, starting at offset. Pages are read from the file
+/// only when first accessed, and clean pages are shared through the page cache with every other process
+/// mapping the same file. Writes stay private. Memory past the host page holding the end of the part is
+/// left untouched.
+bool os_map_file_private(const char *path, uint64_t offset, unsigned char *host_memory, uint64_t length,
+    uint64_t &mapped_length);
+
+/// \brief Claims the soft-dirty page bits of the process
+/// \returns True if the host supports soft-dirty bits and no one else claimed them
+/// \details Clearing soft-dirty bits affects all memory in the process, so only one owner
+/// can rely on them at a time. Bits are cleared when claimed.
+bool os_soft_dirty_acquire(void);
+
+/// \brief Gives up the soft-dirty page bits claimed with os_soft_dirty_acquire()
+void os_soft_dirty_release(void);
+
+/// \brief Clears the soft-dirty bits of all pages in the process
+/// \returns True if successful, false otherwise
+bool os_soft_dirty_clear(void);
+
+/// \brief Enumerates host pages written to since soft-dirty bits were last cleared
+/// \param host_memory Start of memory range
+/// \param length Length of memory range
+/// \param f Function called with offset and length, within range, of each page written to
+/// \returns True if successful, false otherwise
+bool os_soft_dirty_for_each(const unsigned char *host_memory, uint64_t length,
+    const std::function<void(uint64_t offset, uint64_t length)> &f);
+
 /// \brief Get time elapsed since its first call with microsecond precision
 int64_t os_now_us();
 
-/// \brief Get the number of concurrent threads supported by the OS
-uint64_t os_get_concurrency();
+/// \brief Task running in a child process
+struct os_forked_task;
 
-/// \brief Mutex for os_parallel_for()
-struct parallel_for_mutex {
-    std::function<void()> lock;
-    std::function<void()> unlock;
-};
+/// \brief Handle to a task started by os_fork_task()
+using os_forked_task_handle = std::shared_ptr<os_forked_task>;
 
-/// \brief Mutex guard for os_parallel_for()
-struct parallel_for_mutex_guard {
-    parallel_for_mutex_guard(const parallel_for_mutex &mutex) : mutex(mutex) {
-        mutex.lock();
-    }
-    ~parallel_for_mutex_guard() { // NOLINT(bugprone-exception-escape)
-        mutex.unlock();
-    }
-
-    parallel_for_mutex_guard() = delete;
-    parallel_for_mutex_guard(const parallel_for_mutex_guard &) = default;
-    parallel_for_mutex_guard(parallel_for_mutex_guard &&) = default;
-    parallel_for_mutex_guard &operator=(const parallel_for_mutex_guard &) = delete;
-    parallel_for_mutex_guard &operator=(parallel_for_mutex_guard &&) = delete;
-
-private:
-    parallel_for_mutex mutex;
-};
+/// \brief Runs a task in a child process, without waiting for it to finish
+/// \param task Task to run. It reports failure by throwing an exception.
+/// \return Handle to be passed to os_forked_task_wait()
+/// \details The child sees a copy-on-write snapshot of the memory of the caller at the time of the call,
+/// except for memory mapped shared, so the caller may go on changing its memory meanwhile.
+/// Throws if the child cannot be created, or if the host does not support forking.
+/// Releasing the last handle waits for the task.
+os_forked_task_handle os_fork_task(const std::function<void()> &task);
+
+/// \brief Checks if a task started by os_fork_task() is done
+bool os_forked_task_done(const os_forked_task_handle &handle);
 
-/// \brief Runs a for loop in parallel using up to n threads
-/// \return True if all thread tasks succeeded
-bool os_parallel_for(uint64_t n, const std::function<bool(uint64_t j, const parallel_for_mutex &mutex)> &task);
+/// \brief Waits for a task started by os_fork_task()
+/// \details Throws with the error message of the task if it failed. Can be called again after it returns.
+void os_forked_task_wait(const os_forked_task_handle &handle);
 
 // Callbacks used by os_select_fds().
 using os_select_before_callback = std::function<void(select_fd_sets *fds, uint64_t *timeout_us)>;
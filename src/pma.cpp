@@ -16,6 +16,7 @@
 
 #include "pma.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 #include <string>
@@ -32,6 +33,9 @@ void pma_memory::release(void) {
     if (m_mmapped) {
         os_unmap_file(m_host_memory, m_length);
         m_mmapped = false;
+        m_anonymous = false;
+        m_shared = false;
+        m_image_length = 0;
     } else {
         std::free(m_host_memory); // NOLINT(cppcoreguidelines-no-malloc)
     }
@@ -46,19 +50,39 @@ pma_memory::~pma_memory() {
 pma_memory::pma_memory(pma_memory &&other) noexcept :
     m_length{std::move(other.m_length)},
     m_host_memory{std::move(other.m_host_memory)},
-    m_mmapped{std::move(other.m_mmapped)} {
+    m_mmapped{std::move(other.m_mmapped)},
+    m_anonymous{std::move(other.m_anonymous)},
+    m_shared{std::move(other.m_shared)},
+    m_image_length{std::move(other.m_image_length)} {
     // set other to safe state
     other.m_host_memory = nullptr;
     other.m_mmapped = false;
+    other.m_anonymous = false;
+    other.m_shared = false;
+    other.m_image_length = 0;
     other.m_length = 0;
 }
 
 pma_memory::pma_memory(const std::string &description, uint64_t length, const callocd &c) :
     m_length{length},
     m_host_memory{nullptr},
-    m_mmapped{false} {
+    m_mmapped{false},
+    m_anonymous{false},
+    m_shared{false},
+    m_image_length{0} {
     (void) c;
-    // use calloc to improve performance
+    // prefer anonymous mappings, so pristine pages can later be returned to the host
+    try {
+        m_host_memory = os_map_anonymous(length);
+    } catch (std::exception &e) {
+        throw std::runtime_error{e.what() + " when initializing "s + description};
+    }
+    if (m_host_memory) {
+        m_mmapped = true;
+        m_anonymous = true;
+        return;
+    }
+    // otherwise, use calloc to improve performance
     // NOLINTNEXTLINE(cppcoreguidelines-no-malloc, cppcoreguidelines-prefer-member-initializer)
     m_host_memory = static_cast<unsigned char *>(std::calloc(1, length));
     if (!m_host_memory) {
@@ -69,7 +93,10 @@ pma_memory::pma_memory(const std::string &description, uint64_t length, const ca
 pma_memory::pma_memory(const std::string &description, uint64_t length, const mockd &m) :
     m_length{length},
     m_host_memory{nullptr},
-    m_mmapped{false} {
+    m_mmapped{false},
+    m_anonymous{false},
+    m_shared{false},
+    m_image_length{0} {
     (void) m;
     (void) description;
 }
@@ -97,9 +124,31 @@ pma_memory::pma_memory(const std::string &description, uint64_t length, const st
         if (static_cast<uint64_t>(file_length) > length) {
             throw std::runtime_error{"image file '"s + path + "' of "s + description + " is too large for range"s};
         }
-        // Read to host memory
-        auto read = fread(m_host_memory, 1, length, fp.get());
-        (void) read;
+        // Prefer mapping the file privately over the zeroed memory, so pages are only read when first
+        // accessed and clean pages are shared with other machines loading the same image
+        if (m_anonymous && c.map_image) {
+            try {
+                if (os_map_file_private(path.c_str(), 0, m_host_memory, length, m_image_length)) {
+                    return;
+                }
+            } catch (std::exception &e) {
+                throw std::runtime_error{e.what() + " when initializing "s + description};
+            }
+        }
+        // Read to host memory only the parts of the file that hold data, since memory starts zeroed
+        bool read_data = true;
+        const bool sparse = os_get_file_data_extents(path.c_str(), length, [&](uint64_t offset, uint64_t size) {
+            read_data = read_data && fseek(fp.get(), static_cast<long>(offset), SEEK_SET) == 0 &&
+                fread(m_host_memory + offset, 1, size, fp.get()) == size;
+        });
+        if (!sparse || !read_data) {
+            if (fseek(fp.get(), 0, SEEK_SET)) {
+                throw std::system_error{errno, std::generic_category(),
+                    "error reading from image file '"s + path + "' when initializing "s + description};
+            }
+            auto read = fread(m_host_memory, 1, length, fp.get());
+            (void) read;
+        }
         if (ferror(fp.get())) {
             throw std::system_error{errno, std::generic_category(),
                 "error reading from image file '"s + path + "' when initializing "s + description};
@@ -110,10 +159,14 @@ pma_memory::pma_memory(const std::string &description, uint64_t length, const st
 pma_memory::pma_memory(const std::string &description, uint64_t length, const std::string &path, const mmapd &m) :
     m_length{length},
     m_host_memory{nullptr},
-    m_mmapped{false} {
+    m_mmapped{false},
+    m_anonymous{false},
+    m_shared{false},
+    m_image_length{0} {
     try {
         m_host_memory = os_map_file(path.c_str(), length, m.shared);
         m_mmapped = true;
+        m_shared = m.shared;
     } catch (std::exception &e) {
         throw std::runtime_error{e.what() + " when initializing "s + description};
     }
@@ -124,14 +177,115 @@ pma_memory &pma_memory::operator=(pma_memory &&other) noexcept {
     // copy from other
     m_host_memory = std::move(other.m_host_memory);
     m_mmapped = std::move(other.m_mmapped);
+    m_anonymous = std::move(other.m_anonymous);
+    m_shared = std::move(other.m_shared);
+    m_image_length = std::move(other.m_image_length);
     m_length = std::move(other.m_length);
     // set other to safe state
     other.m_host_memory = nullptr;
     other.m_mmapped = false;
+    other.m_anonymous = false;
+    other.m_shared = false;
+    other.m_image_length = 0;
     other.m_length = 0;
     return *this;
 }
 
+bool pma_memory::reclaim_pristine(uint64_t offset, uint64_t length) {
+    // pages privately mapped from an image file would be read back from the file, not as zeros
+    if (!m_anonymous || offset < m_image_length || offset >= m_length || length > m_length - offset) {
+        return false;
+    }
+    return os_discard_anonymous(m_host_memory + offset, length);
+}
+
+bool pma_memory::map_image_private(const std::string &path, uint64_t offset) {
+    if (!m_anonymous) {
+        return false;
+    }
+    uint64_t mapped_length = 0;
+    if (!os_map_file_private(path.c_str(), offset, m_host_memory, m_length, mapped_length)) {
+        return false;
+    }
+    m_image_length = std::max(m_image_length, mapped_length);
+    return true;
+}
+
+bool pma_memory::advise_huge_pages(void) {
+    if (!m_anonymous) {
+        return false;
+    }
+    return os_advise_huge_pages(m_host_memory, m_length);
+}
+
+bool pma_memory::advise_will_need(void) {
+    if (m_anonymous) {
+        return m_image_length > 0 && os_advise_will_need(m_host_memory, m_image_length);
+    }
+    return m_mmapped && os_advise_will_need(m_host_memory, m_length);
+}
+
+bool pma_entry::mark_soft_dirty_pages(void) {
+    const unsigned char *host_memory = get_memory().get_host_memory();
+    return os_soft_dirty_for_each(host_memory, get_length(), [this](uint64_t offset, uint64_t length) {
+        // Host pages may be larger or smaller than our pages
+        const uint64_t end = offset + length;
+        for (uint64_t page = offset & ~(PMA_PAGE_SIZE - 1); page < end; page += PMA_PAGE_SIZE) {
+            mark_dirty_page(page);
+        }
+    });
+}
+
+void pma_entry::begin_journal(void) {
+    end_journal();
+    if (!get_istart_M() || get_istart_E() || get_length() == 0) {
+        return;
+    }
+    const uint64_t pages = (get_length() + PMA_PAGE_SIZE - 1) >> PMA_PAGE_SIZE_LOG2;
+    m_journaled_page_map.assign((pages + 7) / 8, 0);
+}
+
+void pma_entry::save_journal_page(uint64_t page_start_in_range) {
+    // The last page of the range may be partial
+    const uint64_t length = std::min<uint64_t>(PMA_PAGE_SIZE, get_length() - page_start_in_range);
+    const unsigned char *page = get_memory().get_host_memory() + page_start_in_range;
+    m_journal_page_offsets.push_back(page_start_in_range);
+    m_journal_data.insert(m_journal_data.end(), page, page + length);
+    m_journal_data.resize(m_journal_page_offsets.size() * PMA_PAGE_SIZE);
+}
+
+void pma_entry::journal_pages(uint64_t address, uint64_t size) {
+    if (m_journaled_page_map.empty() || size == 0) {
+        return;
+    }
+    if (!contains(address, size)) {
+        throw std::invalid_argument{"range not contained in pma"};
+    }
+    const uint64_t end = address - get_start() + size;
+    for (uint64_t page = (address - get_start()) & ~(PMA_PAGE_SIZE - 1); page < end; page += PMA_PAGE_SIZE) {
+        journal_page(page);
+    }
+}
+
+void pma_entry::rollback_journal(void) {
+    unsigned char *host_memory = m_journal_page_offsets.empty() ? nullptr : get_memory().get_host_memory();
+    for (size_t i = 0; i < m_journal_page_offsets.size(); ++i) {
+        const uint64_t page_start_in_range = m_journal_page_offsets[i];
+        const uint64_t length = std::min<uint64_t>(PMA_PAGE_SIZE, get_length() - page_start_in_range);
+        memcpy(host_memory + page_start_in_range, m_journal_data.data() + i * PMA_PAGE_SIZE, length);
+        // The Merkle tree may have been updated with what the page held since
+        mark_dirty_page(page_start_in_range);
+    }
+    end_journal();
+}
+
+void pma_entry::end_journal(void) {
+    // Release the memory, since journals can grow large
+    std::vector<uint8_t>().swap(m_journaled_page_map);
+    std::vector<uint64_t>().swap(m_journal_page_offsets);
+    std::vector<unsigned char>().swap(m_journal_data);
+}
+
 uint64_t pma_entry::get_istart(void) const {
     uint64_t istart = m_start;
     istart |= (static_cast<uint64_t>(get_istart_M()) << PMA_ISTART_M_SHIFT);
@@ -160,6 +314,7 @@ void pma_entry::write_memory(uint64_t paddr, const unsigned char *data, uint64_t
     if (!data) {
         throw std::invalid_argument{"invalid data buffer"};
     }
+    journal_pages(paddr, size);
     memcpy(get_memory().get_host_memory() + (paddr - get_start()), data, size);
     mark_dirty_pages(paddr, size);
 }
@@ -171,6 +326,7 @@ void pma_entry::fill_memory(uint64_t paddr, unsigned char value, uint64_t size)
     if (!contains(paddr, size)) {
         throw std::invalid_argument{"range not contained in pma"};
     }
+    journal_pages(paddr, size);
     memset(get_memory().get_host_memory() + (paddr - get_start()), value, size);
     mark_dirty_pages(paddr, size);
 }
@@ -218,12 +374,12 @@ pma_entry make_callocd_memory_pma_entry(const std::string &description, uint64_t
 }
 
 pma_entry make_callocd_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length,
-    const std::string &path) {
+    const std::string &path, bool map_image) {
     if (length == 0) {
         throw std::invalid_argument{description + " length cannot be zero"s};
     }
-    return pma_entry{description, start, length, pma_memory{description, length, path, pma_memory::callocd{}},
-        memory_peek};
+    return pma_entry{description, start, length,
+        pma_memory{description, length, path, pma_memory::callocd{map_image}}, memory_peek};
 }
 
 pma_entry make_mockd_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length) {
@@ -94,7 +94,10 @@ class pma_memory final {
 
     uint64_t m_length;            ///< Length of memory range (copy of PMA length field).
     unsigned char *m_host_memory; ///< Start of associated memory region in host.
-    bool m_mmapped;               ///< True if memory was mapped from a file.
+    bool m_mmapped;               ///< True if memory was mapped from a file or anonymously.
+    bool m_anonymous;             ///< True if memory was mapped anonymously.
+    bool m_shared;                ///< True if memory was mapped from a file shared with other processes.
+    uint64_t m_image_length;      ///< Length at the start of anonymous memory privately mapped from an image file.
 
     /// \brief Close file and/or release memory.
     void release(void);
@@ -112,8 +115,10 @@ public:
     /// \param m Mmap'd range data (shared or not).
     pma_memory(const std::string &description, uint64_t length, const std::string &path, const mmapd &m);
 
-    /// \brief Calloc'd range data (just a tag).
-    struct callocd {};
+    /// \brief Calloc'd range data.
+    struct callocd {
+        bool map_image; ///< Map the image file privately when possible, instead of reading it.
+    };
 
     /// \brief Mock'd range data (just a tag).
     struct mockd {};
@@ -122,7 +127,9 @@ public:
     /// \param description Informative description of PMA entry for use in error messages
     /// \param length Length of range.
     /// \param path Path for backing file.
-    /// \param c Calloc'd range data (just a tag).
+    /// \param c Calloc'd range data.
+    /// \details A privately mapped image keeps backing the pages that were never written, so the
+    /// file must not be modified or truncated while the memory exists.
     pma_memory(const std::string &description, uint64_t length, const std::string &path, const callocd &c);
 
     /// \brief Constructor for calloc'd ranges.
@@ -152,6 +159,38 @@ public:
     /// \brief Destructor
     ~pma_memory(void);
 
+    /// \brief Returns pristine pages in a range back to the host
+    /// \param offset Offset of range within memory.
+    /// \param length Length of range.
+    /// \returns True if the range was reclaimed, false if memory does not support it
+    /// \details The range must contain only zeros. Only anonymously mapped memory is
+    /// reclaimed: memory mapped from a file would have to be read back from the file.
+    /// This includes the start of memory privately mapped from an image file.
+    bool reclaim_pristine(uint64_t offset, uint64_t length);
+
+    /// \brief Replaces the contents of memory with part of a file, mapped privately
+    /// \param path Path to file
+    /// \param offset Offset of the part in file, which must hold at least as many bytes as memory past it
+    /// \returns True if successful, false if memory does not support it
+    /// \details Only anonymously mapped memory can be replaced. Pages of the mapped part are never reclaimed.
+    bool map_image_private(const std::string &path, uint64_t offset);
+
+    /// \brief Asks the host to back memory with transparent huge pages
+    /// \returns True if the host accepted, false if memory does not support it
+    /// \details Only anonymously mapped memory uses huge pages. Memory is still tracked page by page.
+    bool advise_huge_pages(void);
+
+    /// \brief Asks the host to start reading the image file memory is mapped from in the background
+    /// \returns True if the host accepted, false if memory is not mapped from a file
+    /// \details Later accesses, such as hashing the whole range, then find pages already read instead of
+    /// waiting for each of them in turn.
+    bool advise_will_need(void);
+
+    /// \brief Tells if writes to memory go to the file it is mapped from, where other processes see them
+    bool is_shared(void) const {
+        return m_shared;
+    }
+
     /// \brief Returns start of associated memory region in host
     unsigned char *get_host_memory(void) {
         return m_host_memory;
@@ -198,7 +237,13 @@ private:
 
     pma_peek m_peek; ///< Callback for peek operations.
 
-    std::vector<uint8_t> m_dirty_page_map; ///< Map of dirty pages.
+    std::vector<uint8_t> m_dirty_page_map;      ///< Map of dirty pages.
+    std::vector<uint8_t> m_unverified_page_map; ///< Map of pages whose hashes were installed but not yet verified.
+    bool m_soft_dirty{false}; ///< True if writes to host memory are tracked with soft-dirty bits.
+
+    std::vector<uint8_t> m_journaled_page_map;    ///< Map of pages saved to the journal, empty if not journaling.
+    std::vector<uint64_t> m_journal_page_offsets; ///< Offset in range of each page saved to the journal.
+    std::vector<unsigned char> m_journal_data;    ///< Contents each page had before it was first written to.
 
     std::variant<pma_empty, ///< Data specific to E ranges
         pma_device,         ///< Data specific to IO ranges
@@ -206,6 +251,10 @@ private:
         >
         m_data;
 
+    /// \brief Appends a copy of a page to the journal
+    /// \param page_start_in_range Start of page in range
+    void save_journal_page(uint64_t page_start_in_range);
+
 public:
     /// \brief No copy constructor
     pma_entry(const pma_entry &) = delete;
@@ -451,6 +500,21 @@ public:
         }
     }
 
+    /// \brief Selects whether writes to host memory are tracked with soft-dirty bits
+    /// \details When tracked, pages in the write TLB need not be marked dirty conservatively.
+    void set_soft_dirty_tracked(bool tracked) {
+        m_soft_dirty = tracked;
+    }
+
+    /// \brief Tells if writes to host memory are tracked with soft-dirty bits
+    bool is_soft_dirty_tracked(void) const {
+        return m_soft_dirty;
+    }
+
+    /// \brief Marks as dirty all pages written to since soft-dirty bits were last cleared
+    /// \returns True if successful, false otherwise
+    bool mark_soft_dirty_pages(void);
+
     /// \brief Mark a given page as clean
     /// \param address_in_range Any address within page in range
     void mark_clean_page(uint64_t address_in_range) {
@@ -481,6 +545,101 @@ public:
         return std::fill(m_dirty_page_map.begin(), m_dirty_page_map.end(), 0);
     }
 
+    /// \brief Marks all pages in range as having unverified hashes in the Merkle tree
+    /// \details Used when page hashes are installed from an external source rather than computed from the data.
+    void mark_pages_unverified(void) {
+        m_unverified_page_map.assign(m_dirty_page_map.size(), 0xff);
+    }
+
+    /// \brief Marks all pages in range as verified
+    void mark_pages_verified(void) {
+        m_unverified_page_map.clear();
+    }
+
+    /// \brief Checks if the hash of any page may still be unverified
+    bool has_unverified_pages(void) const {
+        return !m_unverified_page_map.empty();
+    }
+
+    /// \brief Marks all pages currently marked dirty as verified
+    /// \details Called before dirty pages are hashed, since their hashes will then be computed from the data.
+    void mark_dirty_pages_verified(void) {
+        if (m_unverified_page_map.empty()) {
+            return;
+        }
+        for (size_t i = 0; i < m_unverified_page_map.size(); ++i) {
+            m_unverified_page_map[i] &= ~m_dirty_page_map[i];
+        }
+    }
+
+    /// \brief Marks a given page as verified
+    /// \param address_in_range Any address within page in range
+    void mark_verified_page(uint64_t address_in_range) {
+        if (!m_unverified_page_map.empty()) {
+            auto page_number = address_in_range >> PMA_constants::PMA_PAGE_SIZE_LOG2;
+            auto map_index = page_number >> 3;
+            assert(map_index < m_unverified_page_map.size());
+            m_unverified_page_map[map_index] &= ~(1 << (page_number & 7));
+        }
+    }
+
+    /// \brief Copies which pages are dirty and which have unverified hashes from another range
+    /// \param other Range of the same length
+    void copy_page_maps(const pma_entry &other) {
+        m_dirty_page_map = other.m_dirty_page_map;
+        m_unverified_page_map = other.m_unverified_page_map;
+    }
+
+    /// \brief Checks if the hash of a given page is still unverified
+    /// \param address_in_range Any address within page in range
+    /// \returns true if unverified, false otherwise
+    bool is_page_unverified(uint64_t address_in_range) const {
+        if (!m_unverified_page_map.empty()) {
+            auto page_number = address_in_range >> PMA_constants::PMA_PAGE_SIZE_LOG2;
+            auto map_index = page_number >> 3;
+            assert(map_index < m_unverified_page_map.size());
+            return m_unverified_page_map[map_index] & (1 << (page_number & 7));
+        } else {
+            return false;
+        }
+    }
+
+    /// \brief Starts saving pages to a journal before they are first written to
+    /// \details Only memory ranges keep a journal. Pages saved before are discarded.
+    void begin_journal(void);
+
+    /// \brief Tells if pages are being saved to a journal
+    bool is_journaling(void) const {
+        return !m_journaled_page_map.empty();
+    }
+
+    /// \brief Saves a page to the journal, unless already saved or not journaling
+    /// \param address_in_range Any address within page in range
+    /// \details Must be called before the page is written to, or before a pointer that allows writing to the
+    /// page is handed out.
+    void journal_page(uint64_t address_in_range) {
+        if (!m_journaled_page_map.empty()) {
+            auto page_number = address_in_range >> PMA_constants::PMA_PAGE_SIZE_LOG2;
+            auto map_index = page_number >> 3;
+            assert(map_index < m_journaled_page_map.size());
+            if (!(m_journaled_page_map[map_index] & (1 << (page_number & 7)))) {
+                m_journaled_page_map[map_index] |= (1 << (page_number & 7));
+                save_journal_page(page_number << PMA_constants::PMA_PAGE_SIZE_LOG2);
+            }
+        }
+    }
+
+    /// \brief Saves all pages in range to the journal, unless already saved or not journaling
+    /// \param address Start address
+    /// \param size Size of range
+    void journal_pages(uint64_t address, uint64_t size);
+
+    /// \brief Restores the pages saved to the journal, marks them dirty, and stops journaling
+    void rollback_journal(void);
+
+    /// \brief Discards the pages saved to the journal and stops journaling
+    void end_journal(void);
+
     /// \brief Returns PMA description as a string
     /// \returns Description
     const std::string &get_description(void) const {
@@ -523,9 +682,10 @@ pma_entry make_callocd_memory_pma_entry(const std::string &description, uint64_t
 /// \param start Start of PMA range.
 /// \param length Length of PMA range.
 /// \param path Path to backing file.
+/// \param map_image Map the file privately when possible, instead of reading it.
 /// \returns Corresponding PMA entry
 pma_entry make_callocd_memory_pma_entry(const std::string &description, uint64_t start, uint64_t length,
-    const std::string &path);
+    const std::string &path, bool map_image);
 
 /// \brief Creates a PMA entry for a new memory region using the host's
 /// mmap functionality.
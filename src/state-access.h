@@ -621,6 +621,10 @@ private:
         }
         const uint64_t vaddr_page = vaddr & ~PAGE_OFFSET_MASK;
         const uint64_t paddr_page = paddr & ~PAGE_OFFSET_MASK;
+        // Save page to snapshot journal, since writes through the TLB will bypass it
+        if constexpr (ETYPE == TLB_WRITE) {
+            pma.journal_page(paddr_page - pma.get_start());
+        }
         unsigned char *hpage = pma.get_memory_noexcept().get_host_memory() + (paddr_page - pma.get_start());
         tlbhe.vaddr_page = vaddr_page;
         tlbhe.vh_offset = cast_ptr_to_addr<uint64_t>(hpage) - vaddr_page;
@@ -65,6 +65,8 @@ static inline bool write_ram_uint64(STATE_ACCESS &a, uint64_t paddr, uint64_t va
     const uint64_t paddr_page = paddr & ~PAGE_OFFSET_MASK;
     unsigned char *hpage = a.get_host_memory(pma) + (paddr_page - pma.get_start());
     const uint64_t hoffset = paddr - paddr_page;
+    // save page to snapshot journal before it changes
+    pma.journal_page(paddr_page - pma.get_start());
     // log writes to memory
     a.write_memory_word(paddr, hpage, hoffset, val);
     // mark page as dirty so we know to update the Merkle tree
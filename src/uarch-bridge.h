@@ -600,8 +600,12 @@ private:
                     tlbhe.vaddr_page = val;
                     // Update vh_offset
                     if (val != TLB_INVALID_PAGE) {
-                        const pma_entry &pma = find_pma_entry<uint64_t>(s, tlbce.paddr_page);
+                        pma_entry &pma = find_pma_entry<uint64_t>(s, tlbce.paddr_page);
                         assert(pma.get_istart_M()); // TLB only works for memory mapped PMAs
+                        // Save page to snapshot journal, since writes through the TLB will bypass it
+                        if (etype == TLB_WRITE) {
+                            pma.journal_page(tlbce.paddr_page - pma.get_start());
+                        }
                         const unsigned char *hpage =
                             pma.get_memory().get_host_memory() + (tlbce.paddr_page - pma.get_start());
                         tlbhe.vh_offset = cast_ptr_to_addr<uint64_t>(hpage) - tlbhe.vaddr_page;
@@ -632,8 +636,8 @@ private:
     /// \returns Corresponding entry if found, or a sentinel entry
     /// for an empty range.
     template <typename T>
-    static const pma_entry &find_pma_entry(machine_state &s, uint64_t paddr) {
-        for (const auto &pma : s.pmas) {
+    static pma_entry &find_pma_entry(machine_state &s, uint64_t paddr) {
+        for (auto &pma : s.pmas) {
             // Stop at first empty PMA
             if (pma.get_length() == 0) {
                 return pma;
@@ -48,9 +48,10 @@ uarch_machine::uarch_machine(uarch_config c) : m_s{}, m_c{c} {
     constexpr auto ram_description = "uarch RAM";
     if (!c.ram.image_filename.empty()) {
         // Load RAM image from file
-        m_s.ram =
-            make_callocd_memory_pma_entry(ram_description, PMA_UARCH_RAM_START, UARCH_RAM_LENGTH, c.ram.image_filename)
-                .set_flags(ram_flags);
+        // The image is small, so it is read rather than mapped, leaving the machine independent of the file
+        m_s.ram = make_callocd_memory_pma_entry(ram_description, PMA_UARCH_RAM_START, UARCH_RAM_LENGTH,
+            c.ram.image_filename, false)
+                      .set_flags(ram_flags);
     } else {
         // Load embedded pristine RAM image
         m_s.ram = make_callocd_memory_pma_entry(ram_description, PMA_UARCH_RAM_START, PMA_UARCH_RAM_LENGTH)
@@ -374,6 +374,7 @@ private:
         // Log the write access
         log_before_write(paddr, data, "memory");
         // Actually modify the state
+        pma.journal_page(hoffset);
         aliased_aligned_write<uint64_t>(hdata, data);
 
         // Finally, update Merkle tree or mark the page dirty, depending on whether proofs are being requested or not
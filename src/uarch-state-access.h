@@ -165,6 +165,7 @@ private:
         }
         // Found a writable memory range. Access host memory accordingly.
         const uint64_t hoffset = paddr - pma.get_start();
+        pma.journal_page(hoffset);
         unsigned char *hmem = pma.get_memory().get_host_memory() + hoffset;
         aliased_aligned_write(hmem, data);
         const uint64_t paddr_page = paddr & ~PAGE_OFFSET_MASK;
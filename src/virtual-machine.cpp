@@ -24,12 +24,33 @@ virtual_machine::virtual_machine(const machine_config &c, const machine_runtime_
 virtual_machine::virtual_machine(const std::string &dir, const machine_runtime_config &r) :
     m_machine(new machine(dir, r)) {}
 
+virtual_machine::virtual_machine(machine *m) : m_machine(m) {}
+
 virtual_machine::~virtual_machine(void) {
     delete m_machine;
 }
 
-void virtual_machine::do_store(const std::string &dir) {
-    m_machine->store(dir);
+i_virtual_machine *virtual_machine::do_clone(void) const {
+    auto cloned = m_machine->clone();
+    auto *vm = new virtual_machine(cloned.get());
+    cloned.release();
+    return vm;
+}
+
+void virtual_machine::do_store(const std::string &dir, const std::string &base_dir) {
+    m_machine->store(dir, base_dir);
+}
+
+void virtual_machine::do_store_file(const std::string &filename) {
+    m_machine->store_file(filename);
+}
+
+void virtual_machine::do_store_async(const std::string &dir, const std::string &base_dir) {
+    m_machine->store_async(dir, base_dir);
+}
+
+bool virtual_machine::do_wait_store(bool wait) {
+    return m_machine->wait_store(wait);
 }
 
 interpreter_break_reason virtual_machine::do_run(uint64_t mcycle_end) {
@@ -44,6 +65,11 @@ machine_merkle_tree::proof_type virtual_machine::do_get_proof(uint64_t address,
     return m_machine->get_proof(address, log2_size);
 }
 
+std::vector<machine_merkle_tree::proof_type> virtual_machine::do_get_proofs(const std::vector<uint64_t> &addresses,
+    const std::vector<int> &log2_sizes) const {
+    return m_machine->get_proofs(addresses, log2_sizes);
+}
+
 void virtual_machine::do_get_root_hash(hash_type &hash) const {
     m_machine->get_root_hash(hash);
 }
@@ -444,8 +470,9 @@ void virtual_machine::do_write_plic_girqsrvd(uint64_t val) {
     return m_machine->write_plic_girqsrvd(val);
 }
 
-void virtual_machine::do_replace_memory_range(const memory_range_config &new_range) {
-    m_machine->replace_memory_range(new_range);
+void virtual_machine::do_replace_memory_range(const memory_range_config &new_range,
+    const std::string &page_hashes_filename) {
+    m_machine->replace_memory_range(new_range, page_hashes_filename);
 }
 
 uint64_t virtual_machine::do_read_word(uint64_t address) const {
@@ -465,15 +492,15 @@ void virtual_machine::do_destroy() {
 }
 
 void virtual_machine::do_snapshot(void) {
-    throw std::runtime_error("snapshot is not supported");
+    m_machine->snapshot();
 }
 
 void virtual_machine::do_commit(void) {
-    // no-op, we are always committed
+    m_machine->commit();
 }
 
 void virtual_machine::do_rollback(void) {
-    throw std::runtime_error("rollback is not supported");
+    m_machine->rollback();
 }
 
 uint64_t virtual_machine::do_read_uarch_x(int i) const {
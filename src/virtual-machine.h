@@ -39,10 +39,18 @@ public:
     ~virtual_machine(void) override;
 
 private:
-    void do_store(const std::string &dir) override;
+    explicit virtual_machine(machine *m);
+
+    i_virtual_machine *do_clone(void) const override;
+    void do_store(const std::string &dir, const std::string &base_dir) override;
+    void do_store_file(const std::string &filename) override;
+    void do_store_async(const std::string &dir, const std::string &base_dir) override;
+    bool do_wait_store(bool wait) override;
     interpreter_break_reason do_run(uint64_t mcycle_end) override;
     access_log do_log_uarch_step(const access_log::type &log_type, bool one_based = false) override;
     machine_merkle_tree::proof_type do_get_proof(uint64_t address, int log2_size) const override;
+    std::vector<machine_merkle_tree::proof_type> do_get_proofs(const std::vector<uint64_t> &addresses,
+        const std::vector<int> &log2_sizes) const override;
     void do_get_root_hash(hash_type &hash) const override;
     bool do_verify_merkle_tree(void) const override;
     uint64_t do_read_csr(csr r) const override;
@@ -143,7 +151,8 @@ private:
     void do_write_plic_girqpend(uint64_t val) override;
     uint64_t do_read_plic_girqsrvd(void) const override;
     void do_write_plic_girqsrvd(uint64_t val) override;
-    void do_replace_memory_range(const memory_range_config &new_range) override;
+    void do_replace_memory_range(const memory_range_config &new_range,
+        const std::string &page_hashes_filename) override;
     uint64_t do_read_word(uint64_t address) const override;
     bool do_verify_dirty_page_maps(void) const override;
     machine_config do_get_initial_config(void) const override;
@@ -383,6 +383,25 @@ do_test("should provide proof for values in registers", function(machine)
     end
 end)
 
+print("\n\ntesting merkle tree get_proofs for values for registers")
+do_test("should provide the same proofs as get_proof", function(machine)
+    local addresses, log2_sizes = {}, {}
+    for _, v in pairs(get_cpu_xreg_test_values()) do
+        for el = cartesi.TREE_LOG2_WORD_SIZE, cartesi.TREE_LOG2_ROOT_SIZE - 1 do
+            addresses[#addresses + 1] = test_util.align(v, el)
+            log2_sizes[#log2_sizes + 1] = el
+        end
+    end
+    local proofs = machine:get_proofs(addresses, log2_sizes)
+    assert(#proofs == #addresses, "wrong number of proofs")
+    for i, proof in ipairs(proofs) do
+        assert(test_util.check_proof(proof), "proof failed")
+        local expected = machine:get_proof(addresses[i], log2_sizes[i])
+        assert(proof.target_hash == expected.target_hash, "target hash mismatch")
+        assert(proof.root_hash == expected.root_hash, "root hash mismatch")
+    end
+end)
+
 print("\n\ntesting get_csr_address function binding")
 do_test("should return address value for csr register", function()
     local module = cartesi
@@ -38,9 +38,12 @@
 #include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <thread>
 
+#include <sys/stat.h>
+
 #include <machine-c-api.h>
 #include <riscv-constants.h>
 #include <uarch-constants.h>
@@ -338,6 +341,50 @@ protected:
     const std::string _flash_path = "/tmp/flash.bin";
 };
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(sparse_flash_drive_image_test, machine_flash_simple_fixture) {
+    // The image is a sparse file, so give it some data past the first hole
+    {
+        std::fstream flash_stream(_flash_path, std::ios::in | std::ios::out | std::ios::binary);
+        flash_stream.seekp(0x1000010);
+        flash_stream << "bbbb";
+    }
+    cm_machine *sparse_machine{};
+    int error_code = cm_create_machine(&_machine_config, &_runtime_config, &sparse_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // A dense copy of the image must give the same root hash
+    const std::string dense_path = "/tmp/flash-dense.bin";
+    {
+        std::ifstream in(_flash_path, std::ios::binary);
+        std::ofstream out(dense_path, std::ios::binary);
+        out << in.rdbuf();
+    }
+    delete[] _machine_config.flash_drive.entry[0].image_filename;
+    _machine_config.flash_drive.entry[0].image_filename = new_cstr(dense_path.c_str());
+    cm_machine *dense_machine{};
+    error_code = cm_create_machine(&_machine_config, &_runtime_config, &dense_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    cm_hash sparse_hash{};
+    cm_hash dense_hash{};
+    error_code = cm_get_root_hash(sparse_machine, &sparse_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_get_root_hash(dense_machine, &dense_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(sparse_hash, dense_hash, sizeof(cm_hash)));
+    bool result{};
+    error_code = cm_verify_dirty_page_maps(sparse_machine, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+    error_code = cm_verify_merkle_tree(sparse_machine, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+
+    cm_delete_machine(dense_machine);
+    cm_delete_machine(sparse_machine);
+    std::filesystem::remove(dense_path);
+}
+
 BOOST_FIXTURE_TEST_CASE_NOLINT(replace_memory_range_invalid_alignment_test, machine_flash_simple_fixture) {
     _machine_config.flash_drive.entry[0].start -= 1;
 
@@ -629,6 +676,585 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(serde_complex_test, ordinary_machine_fixture) {
     cm_delete_machine(restored_machine);
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(serde_page_hashes_test, ordinary_machine_fixture) {
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.use_page_hashes = true;
+    cm_machine *machine{};
+    char *err_msg{};
+    int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_store(machine, _machine_dir_path.c_str(), &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(err_msg, nullptr);
+
+    std::stringstream ram_name;
+    ram_name << _machine_dir_path << "/" << std::hex << std::setw(16) << std::setfill('0') << 0x80000000 << "-"
+             << _machine_config.ram.length;
+    BOOST_REQUIRE(std::filesystem::exists(ram_name.str() + ".hashes"));
+
+    cm_machine *restored_machine{};
+    error_code = cm_load_machine(_machine_dir_path.c_str(), &runtime_config, &restored_machine, &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(err_msg, nullptr);
+
+    cm_hash origin_hash{};
+    error_code = cm_get_root_hash(machine, &origin_hash, &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash restored_hash{};
+    error_code = cm_get_root_hash(restored_machine, &restored_hash, &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, restored_hash, sizeof(cm_hash)));
+    bool ret{};
+    error_code = cm_verify_merkle_tree(restored_machine, &ret, &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(ret);
+    cm_delete_machine(restored_machine);
+
+    // tamper with the RAM image: the installed page hashes are trusted on load, but fail verification
+    {
+        std::fstream ram_image(ram_name.str() + ".bin", std::ios::in | std::ios::out | std::ios::binary);
+        BOOST_REQUIRE(ram_image.is_open());
+        ram_image.seekp(0);
+        ram_image.put(static_cast<char>(0xff));
+    }
+    error_code = cm_load_machine(_machine_dir_path.c_str(), &runtime_config, &restored_machine, &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_verify_merkle_tree(restored_machine, &ret, &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(!ret);
+
+    // the tampered page has a pristine installed hash, but its data must still be stored
+    const std::string stored_path = _machine_dir_path + "-tampered";
+    error_code = cm_store(restored_machine, stored_path.c_str(), &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    {
+        std::stringstream stored_ram_name;
+        stored_ram_name << stored_path << "/" << std::hex << std::setw(16) << std::setfill('0') << 0x80000000 << "-"
+                        << _machine_config.ram.length << ".bin";
+        std::ifstream stored_ram_image(stored_ram_name.str(), std::ios::binary);
+        BOOST_REQUIRE(stored_ram_image.is_open());
+        BOOST_CHECK_EQUAL(stored_ram_image.get(), 0xff);
+    }
+    std::filesystem::remove_all(stored_path);
+    const std::string stored_file_path = _machine_dir_path + "-tampered.cm";
+    error_code = cm_store_file(restored_machine, stored_file_path.c_str(), &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_machine *stored_machine{};
+    error_code = cm_load_machine(stored_file_path.c_str(), &runtime_config, &stored_machine, &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    uint8_t byte{};
+    error_code = cm_read_memory(stored_machine, 0x80000000, &byte, 1, &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(byte, 0xff);
+    cm_delete_machine(stored_machine);
+    std::filesystem::remove(stored_file_path);
+
+    cm_delete_machine(restored_machine);
+    cm_delete_machine(machine);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(store_sparse_image_test, ordinary_machine_fixture) {
+    constexpr uint64_t address = 0x80080000;
+    std::array<uint8_t, 4096> data{};
+    data.fill(0xda);
+    int error_code = cm_write_memory(_machine, address, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // Pristine pages are found by their hashes, or by their contents when the root hash is not stored
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.skip_root_hash_store = true;
+    cm_machine *unhashed_machine{};
+    error_code = cm_create_machine(&_machine_config, &runtime_config, &unhashed_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_write_memory(unhashed_machine, address, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const std::string unhashed_path = _machine_dir_path + "-unhashed";
+    const auto check_store = [&](cm_machine *machine, const std::string &path, const cm_machine_runtime_config &rc) {
+        error_code = cm_store(machine, path.c_str(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        std::stringstream ram_name;
+        ram_name << path << "/" << std::hex << std::setw(16) << std::setfill('0') << 0x80000000 << "-"
+                 << _machine_config.ram.length << ".bin";
+        BOOST_REQUIRE_EQUAL(std::filesystem::file_size(ram_name.str()), _machine_config.ram.length);
+        struct stat statbuf {};
+        BOOST_REQUIRE_EQUAL(stat(ram_name.str().c_str(), &statbuf), 0);
+        BOOST_CHECK_LT(static_cast<uint64_t>(statbuf.st_blocks) * 512, _machine_config.ram.length);
+        std::vector<uint8_t> image(_machine_config.ram.length);
+        std::ifstream in(ram_name.str(), std::ios::binary);
+        in.read(reinterpret_cast<char *>(image.data()), static_cast<std::streamsize>(image.size()));
+        BOOST_CHECK(std::equal(data.begin(), data.end(), image.begin() + (address - 0x80000000)));
+        cm_machine *restored_machine{};
+        error_code = cm_load_machine(path.c_str(), &rc, &restored_machine, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        std::vector<uint8_t> ram(_machine_config.ram.length);
+        error_code = cm_read_memory(restored_machine, 0x80000000, ram.data(), ram.size(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK(image == ram);
+        cm_delete_machine(restored_machine);
+    };
+    check_store(_machine, _machine_dir_path, _runtime_config);
+    runtime_config.skip_root_hash_check = true;
+    check_store(unhashed_machine, unhashed_path, runtime_config);
+
+    cm_delete_machine(unhashed_machine);
+    std::filesystem::remove_all(unhashed_path);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(serde_delta_test, ordinary_machine_fixture) {
+    const std::string delta1_path = _machine_dir_path + "-delta1";
+    const std::string delta2_path = _machine_dir_path + "-delta2";
+    int error_code = cm_store(_machine, _machine_dir_path.c_str(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // The base has no page hashes, so the first delta compares page contents
+    constexpr uint64_t address = 0x80080000;
+    std::array<uint8_t, 2 * 4096> data{};
+    data.fill(0xda);
+    error_code = cm_write_memory(_machine, address, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    char *err_msg{};
+    error_code = cm_store_delta(_machine, delta1_path.c_str(), _machine_dir_path.c_str(), &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(err_msg, nullptr);
+    cm_hash delta1_hash{};
+    error_code = cm_get_root_hash(_machine, &delta1_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::stringstream ram_name;
+    ram_name << delta1_path << "/" << std::hex << std::setw(16) << std::setfill('0') << 0x80000000 << "-"
+             << _machine_config.ram.length;
+    BOOST_CHECK(!std::filesystem::exists(ram_name.str() + ".bin"));
+    BOOST_CHECK_EQUAL(std::filesystem::file_size(ram_name.str() + ".delta"), 2 * (sizeof(uint64_t) + 4096));
+
+    // The second delta compares page hashes stored with the first
+    data.fill(0xdb);
+    error_code = cm_write_memory(_machine, address + 4096, data.data(), 4096, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_store_delta(_machine, delta2_path.c_str(), delta1_path.c_str(), &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(err_msg, nullptr);
+    cm_hash delta2_hash{};
+    error_code = cm_get_root_hash(_machine, &delta2_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // Loading composes the deltas over the base
+    const auto check_load = [&](const std::string &path, const cm_hash &hash) {
+        cm_machine *restored_machine{};
+        error_code = cm_load_machine(path.c_str(), &_runtime_config, &restored_machine, &err_msg);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK_EQUAL(err_msg, nullptr);
+        cm_hash restored_hash{};
+        error_code = cm_get_root_hash(restored_machine, &restored_hash, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK_EQUAL(0, memcmp(hash, restored_hash, sizeof(cm_hash)));
+        bool result{};
+        error_code = cm_verify_merkle_tree(restored_machine, &result, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK(result);
+        cm_delete_machine(restored_machine);
+    };
+    check_load(delta1_path, delta1_hash);
+    check_load(delta2_path, delta2_hash);
+
+    // The base must hold every memory range of the machine
+    error_code = cm_store_delta(_machine, (delta2_path + "-bad").c_str(), "/nonexistent-base", &err_msg);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_RUNTIME_ERROR);
+    cm_delete_cstring(err_msg);
+
+    std::filesystem::remove_all(delta1_path);
+    std::filesystem::remove_all(delta2_path);
+    std::filesystem::remove_all(delta2_path + "-bad");
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(store_file_test, ordinary_machine_fixture) {
+    // Two pages with equal contents, so the second is stored only in the page index
+    constexpr uint64_t address = 0x80080000;
+    constexpr uint64_t repeated_address = 0x80090000;
+    std::array<uint8_t, 4096> data{};
+    data.fill(0xda);
+    int error_code = cm_write_memory(_machine, address, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_write_memory(_machine, repeated_address, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const std::string file_path = _machine_dir_path + ".cm";
+    char *err_msg{};
+    error_code = cm_store_file(_machine, file_path.c_str(), &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(err_msg, nullptr);
+    BOOST_REQUIRE(std::filesystem::is_regular_file(file_path));
+    struct stat statbuf {};
+    BOOST_REQUIRE_EQUAL(stat(file_path.c_str(), &statbuf), 0);
+    BOOST_CHECK_LT(static_cast<uint64_t>(statbuf.st_blocks) * 512, _machine_config.ram.length);
+
+    cm_hash origin_hash{};
+    error_code = cm_get_root_hash(_machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::vector<uint8_t> origin_ram(_machine_config.ram.length);
+    error_code = cm_read_memory(_machine, 0x80000000, origin_ram.data(), origin_ram.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const auto check_load = [&](const cm_machine_runtime_config &rc) {
+        cm_machine *restored_machine{};
+        error_code = cm_load_machine(file_path.c_str(), &rc, &restored_machine, &err_msg);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK_EQUAL(err_msg, nullptr);
+        cm_hash restored_hash{};
+        error_code = cm_get_root_hash(restored_machine, &restored_hash, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK_EQUAL(0, memcmp(origin_hash, restored_hash, sizeof(cm_hash)));
+        std::vector<uint8_t> ram(_machine_config.ram.length);
+        error_code = cm_read_memory(restored_machine, 0x80000000, ram.data(), ram.size(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK(origin_ram == ram);
+        bool ret{};
+        error_code = cm_verify_merkle_tree(restored_machine, &ret, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK(ret);
+        cm_delete_machine(restored_machine);
+    };
+    check_load(_runtime_config);
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.use_page_hashes = true;
+    check_load(runtime_config);
+
+    // Changes to a loaded machine must not reach the file it was mapped from
+    cm_machine *restored_machine{};
+    error_code = cm_load_machine(file_path.c_str(), &_runtime_config, &restored_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::array<uint8_t, 4096> other{};
+    other.fill(0x5a);
+    error_code = cm_write_memory(restored_machine, address, other.data(), other.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_delete_machine(restored_machine);
+    check_load(_runtime_config);
+
+    std::filesystem::remove(file_path);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(store_file_corrupt_config_test, ordinary_machine_fixture) {
+    const std::string file_path = _machine_dir_path + ".cm";
+    int error_code = cm_store_file(_machine, file_path.c_str(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    // Config length follows magic, version and config offset in the header
+    {
+        std::fstream file(file_path, std::ios::binary | std::ios::in | std::ios::out);
+        const uint64_t config_length = UINT64_C(1) << 60;
+        file.seekp(24);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        file.write(reinterpret_cast<const char *>(&config_length), sizeof(config_length));
+    }
+    cm_machine *restored_machine{};
+    char *err_msg{};
+    error_code = cm_load_machine(file_path.c_str(), &_runtime_config, &restored_machine, &err_msg);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_RUNTIME_ERROR);
+    BOOST_CHECK_EQUAL(std::string("corrupt config in '") + file_path + "'", std::string(err_msg));
+    cm_delete_cstring(err_msg);
+    std::filesystem::remove(file_path);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(store_compressed_image_test, ordinary_machine_fixture) {
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.compress_images = true;
+    runtime_config.concurrency.images = 4;
+    cm_machine *machine{};
+    int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    // Compressible data spanning several chunks, and a chunk that does not compress
+    constexpr uint64_t address = 0x80040000;
+    std::vector<uint8_t> data(3 * 0x40000);
+    for (uint64_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i % 251 < 8 ? i : 0);
+    }
+    for (uint64_t i = 0x80000; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+    }
+    error_code = cm_write_memory(machine, address, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    char *err_msg{};
+    error_code = cm_store(machine, _machine_dir_path.c_str(), &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(err_msg, nullptr);
+
+    std::stringstream ram_name;
+    ram_name << _machine_dir_path << "/" << std::hex << std::setw(16) << std::setfill('0') << 0x80000000 << "-"
+             << _machine_config.ram.length << ".bin";
+    BOOST_CHECK(!std::filesystem::exists(ram_name.str()));
+    BOOST_REQUIRE(std::filesystem::exists(ram_name.str() + ".z"));
+    BOOST_CHECK_LT(std::filesystem::file_size(ram_name.str() + ".z"), 0x40000 + 0x20000);
+
+    cm_hash origin_hash{};
+    error_code = cm_get_root_hash(machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::vector<uint8_t> origin_ram(_machine_config.ram.length);
+    error_code = cm_read_memory(machine, 0x80000000, origin_ram.data(), origin_ram.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const auto check_load = [&](const std::string &path) {
+        cm_machine *restored_machine{};
+        error_code = cm_load_machine(path.c_str(), &runtime_config, &restored_machine, &err_msg);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK_EQUAL(err_msg, nullptr);
+        cm_hash restored_hash{};
+        error_code = cm_get_root_hash(restored_machine, &restored_hash, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK_EQUAL(0, memcmp(origin_hash, restored_hash, sizeof(cm_hash)));
+        std::vector<uint8_t> ram(_machine_config.ram.length);
+        error_code = cm_read_memory(restored_machine, 0x80000000, ram.data(), ram.size(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK(origin_ram == ram);
+        cm_delete_machine(restored_machine);
+    };
+    check_load(_machine_dir_path);
+
+    // Deltas stored over a compressed machine compare against its page hashes
+    std::array<uint8_t, 4096> page{};
+    page.fill(0xda);
+    error_code = cm_write_memory(machine, address, page.data(), page.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const std::string delta_path = _machine_dir_path + "-delta";
+    error_code = cm_store_delta(machine, delta_path.c_str(), _machine_dir_path.c_str(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_get_root_hash(machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::copy(page.begin(), page.end(), origin_ram.begin() + (address - 0x80000000));
+    check_load(delta_path);
+
+    // Corrupt chunks are caught by their checksums, even when the root hash is not checked
+    runtime_config.skip_root_hash_check = true;
+    const auto check_corrupt = [&](uint64_t offset, const void *bytes, uint64_t length, const std::string &what) {
+        std::vector<char> saved(length);
+        {
+            std::fstream image(ram_name.str() + ".z", std::ios::in | std::ios::out | std::ios::binary);
+            BOOST_REQUIRE(image.is_open());
+            image.seekg(static_cast<std::streamoff>(offset));
+            image.read(saved.data(), static_cast<std::streamsize>(length));
+            image.seekp(static_cast<std::streamoff>(offset));
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            image.write(reinterpret_cast<const char *>(bytes), static_cast<std::streamsize>(length));
+        }
+        cm_machine *restored_machine{};
+        error_code = cm_load_machine(_machine_dir_path.c_str(), &runtime_config, &restored_machine, &err_msg);
+        BOOST_CHECK_NE(error_code, CM_ERROR_OK);
+        BOOST_REQUIRE_NE(err_msg, nullptr);
+        BOOST_CHECK_NE(std::string(err_msg).find(what), std::string::npos);
+        cm_delete_cstring(err_msg);
+        std::fstream image(ram_name.str() + ".z", std::ios::in | std::ios::out | std::ios::binary);
+        image.seekp(static_cast<std::streamoff>(offset));
+        image.write(saved.data(), static_cast<std::streamsize>(length));
+    };
+    const uint8_t garbage = 0xff;
+    // The first chunk is pristine, so the deflate data of the second one comes right after the chunk table
+    check_corrupt(40 + 4 * 32 + 64, &garbage, 1, "corrupt chunk");
+    // The last chunk does not compress, so it is stored raw at the end of the image
+    check_corrupt(std::filesystem::file_size(ram_name.str() + ".z") - 1, &garbage, 1, "corrupt chunk");
+    // A chunk size that would need a table larger than the image is refused before allocating it
+    const std::array<uint64_t, 2> tiny_chunks{1, _machine_config.ram.length};
+    check_corrupt(24, tiny_chunks.data(), sizeof(tiny_chunks), "corrupt chunk table");
+
+    cm_delete_machine(machine);
+    std::filesystem::remove_all(delta_path);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(store_parallel_image_test, ordinary_machine_fixture) {
+    // RAM large enough to be split in several chunks, written by different threads
+    _machine_config.ram.length = 16 << 20;
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.concurrency.images = 3;
+    cm_machine *machine{};
+    int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::array<uint8_t, 2 * 4096> data{};
+    data.fill(0xda);
+    for (const uint64_t address : {UINT64_C(0x803ff000), UINT64_C(0x80a00000), UINT64_C(0x80ffe000)}) {
+        error_code = cm_write_memory(machine, address, data.data(), data.size(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    }
+    error_code = cm_store(machine, _machine_dir_path.c_str(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    std::vector<uint8_t> ram(_machine_config.ram.length);
+    error_code = cm_read_memory(machine, 0x80000000, ram.data(), ram.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::stringstream ram_name;
+    ram_name << _machine_dir_path << "/" << std::hex << std::setw(16) << std::setfill('0') << 0x80000000 << "-"
+             << _machine_config.ram.length << ".bin";
+    BOOST_REQUIRE_EQUAL(std::filesystem::file_size(ram_name.str()), _machine_config.ram.length);
+    std::vector<uint8_t> image(_machine_config.ram.length);
+    std::ifstream in(ram_name.str(), std::ios::binary);
+    in.read(reinterpret_cast<char *>(image.data()), static_cast<std::streamsize>(image.size()));
+    BOOST_CHECK(image == ram);
+
+    cm_machine *restored_machine{};
+    error_code = cm_load_machine(_machine_dir_path.c_str(), &runtime_config, &restored_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash origin_hash{};
+    error_code = cm_get_root_hash(machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash restored_hash{};
+    error_code = cm_get_root_hash(restored_machine, &restored_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, restored_hash, sizeof(cm_hash)));
+
+    cm_delete_machine(restored_machine);
+    cm_delete_machine(machine);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(store_async_test, ordinary_machine_fixture) {
+    cm_hash origin_hash{};
+    int error_code = cm_get_root_hash(_machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_store_async(_machine, _machine_dir_path.c_str(), nullptr, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // changes made while the store runs must not reach the stored machine
+    std::array<uint8_t, 4096> data{};
+    data.fill(0xda);
+    error_code = cm_write_memory(_machine, 0x80000000, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    char *err_msg{};
+    error_code = cm_store_async(_machine, (_machine_dir_path + "-other").c_str(), nullptr, &err_msg);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_RUNTIME_ERROR);
+    BOOST_CHECK_EQUAL(std::string("previous asynchronous store was not waited for"), std::string(err_msg));
+    cm_delete_cstring(err_msg);
+
+    bool done{};
+    error_code = cm_wait_store(_machine, true, &done, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(done);
+    error_code = cm_wait_store(_machine, false, &done, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(done);
+
+    cm_machine *restored_machine{};
+    error_code = cm_load_machine(_machine_dir_path.c_str(), &_runtime_config, &restored_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash restored_hash{};
+    error_code = cm_get_root_hash(restored_machine, &restored_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, restored_hash, sizeof(cm_hash)));
+    cm_delete_machine(restored_machine);
+
+    // failures of the store are reported when waiting
+    error_code = cm_store_async(_machine, _machine_dir_path.c_str(), nullptr, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_wait_store(_machine, true, &done, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_RUNTIME_ERROR);
+    error_code = cm_wait_store(_machine, true, &done, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OK);
+}
+
+BOOST_AUTO_TEST_CASE_NOLINT(clone_machine_null_machine_test) {
+    cm_machine *cloned{};
+    int error_code = cm_clone_machine(nullptr, &cloned, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(clone_machine_null_output_test, ordinary_machine_fixture) {
+    char *err_msg{};
+    int error_code = cm_clone_machine(_machine, nullptr, &err_msg);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(std::string("invalid new machine output"), std::string(err_msg));
+    cm_delete_cstring(err_msg);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(clone_machine_test, ordinary_machine_fixture) {
+    std::array<uint8_t, 2 * 4096> data{};
+    data.fill(0xda);
+    int error_code = cm_write_memory(_machine, 0x80010000, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    CM_BREAK_REASON break_reason{};
+    error_code = cm_machine_run(_machine, 1000, &break_reason, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash hash{};
+    error_code = cm_get_root_hash(_machine, &hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    // Pages changed since the Merkle tree was last updated must be hashed by the clone
+    data.fill(0xfe);
+    error_code = cm_write_memory(_machine, 0x80020800, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_machine_run(_machine, 2000, &break_reason, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    cm_machine *cloned{};
+    error_code = cm_clone_machine(_machine, &cloned, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash origin_hash{};
+    error_code = cm_get_root_hash(_machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash cloned_hash{};
+    error_code = cm_get_root_hash(cloned, &cloned_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, cloned_hash, sizeof(cm_hash)));
+    bool result{};
+    error_code = cm_verify_merkle_tree(cloned, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+    // The initial config of the clone describes the state it was cloned from
+    uint64_t mcycle{};
+    error_code = cm_read_csr(_machine, CM_PROC_MCYCLE, &mcycle, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const cm_machine_config *cloned_config{};
+    error_code = cm_get_initial_config(cloned, &cloned_config, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(cloned_config->processor.mcycle, mcycle);
+    BOOST_CHECK((cloned_config->ram.image_filename == nullptr || *cloned_config->ram.image_filename == '\0'));
+    cm_delete_machine_config(cloned_config);
+
+    // Both machines go on independently
+    error_code = cm_machine_run(cloned, 3000, &break_reason, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_machine_run(_machine, 3000, &break_reason, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_get_root_hash(_machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_get_root_hash(cloned, &cloned_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, cloned_hash, sizeof(cm_hash)));
+    data.fill(0x11);
+    error_code = cm_write_memory(cloned, 0x80010000, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::array<uint8_t, 2 * 4096> read{};
+    error_code = cm_read_memory(_machine, 0x80010000, read.data(), read.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(read[0], 0xda);
+    cm_delete_machine(cloned);
+}
+
+BOOST_AUTO_TEST_CASE_NOLINT(get_thread_pool_stats_null_output_test) {
+    char *err_msg{};
+    int error_code = cm_get_thread_pool_stats(nullptr, &err_msg);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(std::string("invalid stats output"), std::string(err_msg));
+    cm_delete_cstring(err_msg);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(thread_pool_root_hash_test, ordinary_machine_fixture) {
+    cm_hash origin_hash{};
+    int error_code = cm_get_root_hash(_machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    error_code = cm_configure_thread_pool(2, false, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.concurrency.update_merkle_tree = 8;
+    cm_machine *machine{};
+    error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash pool_hash{};
+    error_code = cm_get_root_hash(machine, &pool_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, pool_hash, sizeof(cm_hash)));
+
+    cm_thread_pool_stats stats{};
+    error_code = cm_get_thread_pool_stats(&stats, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(stats.threads, 2);
+    BOOST_CHECK_GT(stats.batches, 0);
+    BOOST_CHECK_GE(stats.tasks, 8 * stats.batches);
+
+    cm_delete_machine(machine);
+    error_code = cm_configure_thread_pool(0, false, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+}
+
 BOOST_AUTO_TEST_CASE_NOLINT(get_root_hash_null_machine_test) {
     cm_hash restored_hash;
     int error_code = cm_get_root_hash(nullptr, &restored_hash, nullptr);
@@ -756,6 +1382,53 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(get_proof_machine_hash_test, ordinary_machine_fix
     cm_delete_merkle_tree_proof(p);
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(get_proofs_match_get_proof_test, ordinary_machine_fixture) {
+    std::array<uint8_t, 4096> data{};
+    data.fill(0xda);
+    int error_code = cm_write_memory(_machine, 0x80040000, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    // Unordered targets of several sizes, some sharing pages or addresses, some in pristine ranges,
+    // and some inside or around the dense subtree of RAM
+    const std::array<uint64_t, 14> addresses{0x80000020, 0x20, 0x0, 0x80000000, 0x80000040, 0x40000000, 0x0,
+        0x80000000, 0x80040020, 0x80040000, 0x80000000, 0x80000000, 0x80080000, 0x80040fe0};
+    const std::array<int, 14> log2_sizes{5, 5, 64, 12, 6, 5, 6, 5, 5, 16, 20, 31, 19, 5};
+    std::array<cm_merkle_tree_proof *, 14> proofs{};
+    error_code = cm_get_proofs(_machine, addresses.data(), log2_sizes.data(), addresses.size(), proofs.data(),
+        nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        cm_merkle_tree_proof *p{};
+        error_code = cm_get_proof(_machine, addresses[i], log2_sizes[i], &p, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK_EQUAL(proofs[i]->target_address, p->target_address);
+        BOOST_CHECK_EQUAL(proofs[i]->log2_target_size, p->log2_target_size);
+        BOOST_CHECK_EQUAL(0, memcmp(proofs[i]->target_hash, p->target_hash, sizeof(cm_hash)));
+        BOOST_CHECK_EQUAL(0, memcmp(proofs[i]->root_hash, p->root_hash, sizeof(cm_hash)));
+        BOOST_REQUIRE_EQUAL(proofs[i]->sibling_hashes.count, p->sibling_hashes.count);
+        BOOST_CHECK_EQUAL(0,
+            memcmp(proofs[i]->sibling_hashes.entry, p->sibling_hashes.entry,
+                p->sibling_hashes.count * sizeof(cm_hash)));
+        cm_delete_merkle_tree_proof(p);
+        cm_delete_merkle_tree_proof(proofs[i]);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(get_proofs_invalid_target_test, ordinary_machine_fixture) {
+    const std::array<uint64_t, 2> addresses{0x0, 0x1};
+    const std::array<int, 2> log2_sizes{12, 12};
+    std::array<cm_merkle_tree_proof *, 2> proofs{};
+    char *err_msg{};
+    int error_code = cm_get_proofs(_machine, addresses.data(), log2_sizes.data(), addresses.size(), proofs.data(),
+        &err_msg);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+    BOOST_CHECK_EQUAL(std::string("address not aligned to log2_size"), std::string(err_msg));
+    BOOST_CHECK_EQUAL(proofs[0], nullptr);
+    cm_delete_cstring(err_msg);
+
+    error_code = cm_get_proofs(_machine, addresses.data(), log2_sizes.data(), addresses.size(), nullptr, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
+}
+
 BOOST_AUTO_TEST_CASE_NOLINT(read_word_null_machine_test) {
     uint64_t word_value = 0;
     int error_code = cm_read_word(nullptr, 0x100, &word_value, nullptr);
@@ -1572,6 +2245,179 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(replace_memory_range_basic_test, flash_drive_mach
     BOOST_CHECK_EQUAL(_flash_data, read_string);
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(store_async_shared_flash_drive_test, flash_drive_machine_fixture) {
+    // the machine keeps writing to the shared flash drive, so it cannot be stored in the background
+    char *err_msg{};
+    int error_code = cm_store_async(_machine, _machine_dir_path.c_str(), nullptr, &err_msg);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_RUNTIME_ERROR);
+    BOOST_CHECK_EQUAL(std::string("asynchronous store is not supported by machines with shared memory ranges "
+                                  "(flash drive 0)"),
+        std::string(err_msg));
+    cm_delete_cstring(err_msg);
+    BOOST_CHECK(!std::filesystem::exists(_machine_dir_path));
+
+    std::array<uint8_t, 4096> data{};
+    data.fill(0xda);
+    error_code = cm_write_memory(_machine, _flash_config.start, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    bool done{};
+    error_code = cm_wait_store(_machine, true, &done, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(done);
+
+    // once the flash drive is private, writes made after the store returns must not reach the stored machine
+    _flash_config.shared = false;
+    error_code = cm_replace_memory_range(_machine, &_flash_config, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash origin_hash{};
+    error_code = cm_get_root_hash(_machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_store_async(_machine, _machine_dir_path.c_str(), nullptr, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_write_memory(_machine, _flash_config.start, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_wait_store(_machine, true, &done, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(done);
+
+    cm_machine *restored_machine{};
+    error_code = cm_load_machine(_machine_dir_path.c_str(), &_runtime_config, &restored_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash restored_hash{};
+    error_code = cm_get_root_hash(restored_machine, &restored_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, restored_hash, sizeof(cm_hash)));
+    cm_delete_machine(restored_machine);
+}
+
+// Writes one hash per page of the flash drive image, as merkle-tree-hash --page-hashes-output would
+static void write_flash_page_hashes(const std::string &filename, const std::string &data, uint64_t length,
+    uint64_t pages_to_write, bool corrupt) {
+    std::string page(detail::MERKLE_PAGE_SIZE, '\0');
+    const auto pristine_hash = merkle_hash(page, detail::MERKLE_PAGE_LOG2_SIZE);
+    page.replace(0, data.size(), data);
+    auto first_hash = merkle_hash(page, detail::MERKLE_PAGE_LOG2_SIZE);
+    if (corrupt) {
+        first_hash[0] ^= 1;
+    }
+    std::ofstream out(filename, std::ios::binary);
+    const uint64_t pages = std::min(pages_to_write, length / detail::MERKLE_PAGE_SIZE);
+    for (uint64_t i = 0; i < pages; ++i) {
+        const auto &hash = i == 0 ? first_hash : pristine_hash;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        out.write(reinterpret_cast<const char *>(hash.data()), static_cast<std::streamsize>(hash.size()));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(replace_memory_range_page_hashes_test, flash_drive_machine_fixture) {
+    const std::string hashes_path = (std::filesystem::temp_directory_path() / "data.bin.hashes").string();
+    write_flash_page_hashes(hashes_path, _flash_data, _flash_config.length, UINT64_MAX, false);
+
+    char *err_msg{};
+    int error_code = cm_replace_memory_range_with_page_hashes(_machine, &_flash_config, hashes_path.c_str(), &err_msg);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(err_msg, nullptr);
+    cm_hash installed_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &installed_hash, nullptr), CM_ERROR_OK);
+    bool result{};
+    BOOST_REQUIRE_EQUAL(cm_verify_merkle_tree(_machine, &result, nullptr), CM_ERROR_OK);
+    BOOST_CHECK(result);
+
+    // The root hash must match the one obtained by hashing the range
+    error_code = cm_replace_memory_range(_machine, &_flash_config, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash computed_hash{};
+    BOOST_REQUIRE_EQUAL(cm_get_root_hash(_machine, &computed_hash, nullptr), CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(installed_hash, computed_hash, sizeof(cm_hash)));
+
+    std::filesystem::remove(hashes_path);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(replace_memory_range_corrupt_page_hashes_test, flash_drive_machine_fixture) {
+    const std::string hashes_path = (std::filesystem::temp_directory_path() / "data.bin.hashes").string();
+    write_flash_page_hashes(hashes_path, _flash_data, _flash_config.length, UINT64_MAX, true);
+
+    int error_code = cm_replace_memory_range_with_page_hashes(_machine, &_flash_config, hashes_path.c_str(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    bool result{true};
+    BOOST_REQUIRE_EQUAL(cm_verify_merkle_tree(_machine, &result, nullptr), CM_ERROR_OK);
+    BOOST_CHECK(!result);
+
+    std::filesystem::remove(hashes_path);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(verify_merkle_tree_concurrency_test, flash_drive_machine_fixture) {
+    const std::string hashes_path = (std::filesystem::temp_directory_path() / "data.bin.hashes").string();
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.concurrency.update_merkle_tree = 4;
+    cm_machine *machine{};
+    int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    bool result{};
+    BOOST_REQUIRE_EQUAL(cm_verify_merkle_tree(machine, &result, nullptr), CM_ERROR_OK);
+    BOOST_CHECK(result);
+
+    // A single bad page hash must be found by whichever thread checks it
+    write_flash_page_hashes(hashes_path, _flash_data, _flash_config.length, UINT64_MAX, true);
+    error_code = cm_replace_memory_range_with_page_hashes(machine, &_flash_config, hashes_path.c_str(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_verify_merkle_tree(machine, &result, nullptr), CM_ERROR_OK);
+    BOOST_CHECK(!result);
+
+    write_flash_page_hashes(hashes_path, _flash_data, _flash_config.length, UINT64_MAX, false);
+    error_code = cm_replace_memory_range_with_page_hashes(machine, &_flash_config, hashes_path.c_str(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_REQUIRE_EQUAL(cm_verify_merkle_tree(machine, &result, nullptr), CM_ERROR_OK);
+    BOOST_CHECK(result);
+
+    cm_delete_machine(machine);
+    std::filesystem::remove(hashes_path);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(verify_merkle_tree_thread_count_test, ordinary_machine_fixture) {
+    // The tree is split differently for each thread count, and pristine subtrees must not get in the way
+    std::array<uint8_t, 4096> data{};
+    data.fill(0xda);
+    for (const uint64_t concurrency : {1, 2, 3, 8}) {
+        cm_machine_runtime_config runtime_config = _runtime_config;
+        runtime_config.concurrency.update_merkle_tree = concurrency;
+        cm_machine *machine{};
+        int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        bool result{};
+        BOOST_REQUIRE_EQUAL(cm_verify_merkle_tree(machine, &result, nullptr), CM_ERROR_OK);
+        BOOST_CHECK(result);
+        error_code = cm_write_memory(machine, 0x80040000, data.data(), data.size(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_REQUIRE_EQUAL(cm_verify_merkle_tree(machine, &result, nullptr), CM_ERROR_OK);
+        BOOST_CHECK(result);
+        cm_delete_machine(machine);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(replace_memory_range_page_hashes_mismatch_test, flash_drive_machine_fixture) {
+    const std::string hashes_path = (std::filesystem::temp_directory_path() / "data.bin.hashes").string();
+    write_flash_page_hashes(hashes_path, _flash_data, _flash_config.length, 1, false);
+
+    char *err_msg{};
+    int error_code = cm_replace_memory_range_with_page_hashes(_machine, &_flash_config, hashes_path.c_str(), &err_msg);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_RUNTIME_ERROR);
+    std::string result = err_msg;
+    std::string origin = "page hashes in '" + hashes_path + "' do not match memory range";
+    BOOST_CHECK_EQUAL(origin, result);
+    cm_delete_cstring(err_msg);
+
+    // The original range must be left in place
+    std::array<uint8_t, 4> read_data{};
+    error_code = cm_read_memory(_machine, _flash_config.start, read_data.data(), read_data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    BOOST_CHECK_EQUAL(std::string(reinterpret_cast<char *>(read_data.data()), read_data.size()), "aaaa");
+
+    std::filesystem::remove(hashes_path);
+}
+
 BOOST_AUTO_TEST_CASE_NOLINT(destroy_null_machine_test) {
     int error_code = cm_destroy(nullptr, nullptr);
     BOOST_CHECK_EQUAL(error_code, CM_ERROR_INVALID_ARGUMENT);
@@ -1590,13 +2436,84 @@ BOOST_AUTO_TEST_CASE_NOLINT(snapshot_null_machine_test) {
 }
 
 BOOST_FIXTURE_TEST_CASE_NOLINT(snapshot_basic_test, ordinary_machine_fixture) {
-    char *err_msg = nullptr;
-    int error_code = cm_snapshot(_machine, &err_msg);
-    std::string result = err_msg;
-    std::string origin("snapshot is not supported");
-    BOOST_CHECK_EQUAL(error_code, CM_ERROR_RUNTIME_ERROR);
-    BOOST_CHECK_EQUAL(origin, result);
-    cm_delete_cstring(err_msg);
+    cm_hash origin_hash{};
+    int error_code = cm_get_root_hash(_machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    uint64_t origin_x5{};
+    error_code = cm_read_x(_machine, 5, &origin_x5, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::vector<uint8_t> origin_ram(_machine_config.ram.length);
+    error_code = cm_read_memory(_machine, 0x80000000, origin_ram.data(), origin_ram.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    error_code = cm_snapshot(_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::array<uint8_t, 3 * 4096> data{};
+    data.fill(0xda);
+    error_code = cm_write_memory(_machine, 0x80001800, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_write_x(_machine, 5, origin_x5 + 1, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    CM_BREAK_REASON break_reason{};
+    error_code = cm_machine_run(_machine, 1000, &break_reason, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    // Updating the Merkle tree in between must not get in the way
+    cm_hash changed_hash{};
+    error_code = cm_get_root_hash(_machine, &changed_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_NE(0, memcmp(origin_hash, changed_hash, sizeof(cm_hash)));
+
+    error_code = cm_rollback(_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash restored_hash{};
+    error_code = cm_get_root_hash(_machine, &restored_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, restored_hash, sizeof(cm_hash)));
+    uint64_t restored_x5{};
+    error_code = cm_read_x(_machine, 5, &restored_x5, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(origin_x5, restored_x5);
+    std::vector<uint8_t> restored_ram(_machine_config.ram.length);
+    error_code = cm_read_memory(_machine, 0x80000000, restored_ram.data(), restored_ram.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(origin_ram == restored_ram);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(snapshot_uarch_test, ordinary_machine_fixture) {
+    cm_hash origin_hash{};
+    int error_code = cm_get_root_hash(_machine, &origin_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_snapshot(_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_write_uarch_x(_machine, 5, 0xda, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::array<uint8_t, 4096> data{};
+    data.fill(0xda);
+    error_code = cm_write_memory(_machine, cartesi::UARCH_RAM_START_ADDRESS, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_rollback(_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash restored_hash{};
+    error_code = cm_get_root_hash(_machine, &restored_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(origin_hash, restored_hash, sizeof(cm_hash)));
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(commit_basic_test, ordinary_machine_fixture) {
+    int error_code = cm_snapshot(_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::array<uint8_t, 4096> data{};
+    data.fill(0xda);
+    error_code = cm_write_memory(_machine, 0x80000000, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_commit(_machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_rollback(_machine, nullptr);
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OUT_OF_RANGE);
+    std::array<uint8_t, 4096> read{};
+    error_code = cm_read_memory(_machine, 0x80000000, read.data(), read.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(data == read);
 }
 
 BOOST_AUTO_TEST_CASE_NOLINT(rollback_null_machine_test) {
@@ -1608,8 +2525,8 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(rollback_basic_test, ordinary_machine_fixture) {
     char *err_msg = nullptr;
     int error_code = cm_rollback(_machine, &err_msg);
     std::string result = err_msg;
-    std::string origin("rollback is not supported");
-    BOOST_CHECK_EQUAL(error_code, CM_ERROR_RUNTIME_ERROR);
+    std::string origin("machine has no pending snapshot to rollback to");
+    BOOST_CHECK_EQUAL(error_code, CM_ERROR_OUT_OF_RANGE);
     BOOST_CHECK_EQUAL(origin, result);
     cm_delete_cstring(err_msg);
 }
@@ -2216,6 +3133,369 @@ BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_long_cycle_test, ordinary_machine_fix
     BOOST_CHECK_EQUAL_COLLECTIONS(verification.begin(), verification.end(), hash_end, hash_end + sizeof(cm_hash));
 }
 
+BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_background_merkle_tree_test, ordinary_machine_fixture) {
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.concurrency.background_merkle_tree_interval = 1000;
+    cm_machine *machine{};
+    int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // Root hashes must match no matter how many times hashing was started in the background
+    cm_hash hash{};
+    cm_hash background_hash{};
+    for (uint64_t mcycle : {1, 150000, 600000}) {
+        error_code = cm_machine_run(_machine, mcycle, nullptr, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        error_code = cm_machine_run(machine, mcycle, nullptr, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        error_code = cm_get_root_hash(_machine, &hash, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        error_code = cm_get_root_hash(machine, &background_hash, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK_EQUAL(0, memcmp(hash, background_hash, sizeof(cm_hash)));
+    }
+
+    error_code = cm_machine_run(machine, 700000, nullptr, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    bool result{};
+    error_code = cm_verify_dirty_page_maps(machine, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+    error_code = cm_get_root_hash(machine, &background_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    auto verification = calculate_emulator_hash(machine);
+    BOOST_CHECK_EQUAL_COLLECTIONS(verification.begin(), verification.end(), background_hash,
+        background_hash + sizeof(cm_hash));
+
+    cm_delete_machine(machine);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_periodic_root_hash_test, ordinary_machine_fixture) {
+    cm_machine *machine{};
+    int error_code = cm_create_machine(&_machine_config, &_runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // Pages that stay in the write TLB between hashes must still be rehashed whenever they change
+    cm_hash hash{};
+    cm_hash periodic_hash{};
+    for (uint64_t mcycle = 5000; mcycle <= 300000; mcycle += 5000) {
+        error_code = cm_machine_run(machine, mcycle, nullptr, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        error_code = cm_get_root_hash(machine, &periodic_hash, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    }
+    error_code = cm_machine_run(_machine, 300000, nullptr, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_get_root_hash(_machine, &hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(hash, periodic_hash, sizeof(cm_hash)));
+    bool result{};
+    error_code = cm_verify_dirty_page_maps(machine, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+    error_code = cm_verify_merkle_tree(machine, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+
+    cm_delete_machine(machine);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(machine_run_soft_dirty_tracking_test, ordinary_machine_fixture) {
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.soft_dirty_tracking = true;
+    cm_machine *machine{};
+    int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    // Only one machine can own the soft-dirty bits, so this one falls back to the default tracking
+    cm_machine *other{};
+    error_code = cm_create_machine(&_machine_config, &runtime_config, &other, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // Results must not depend on whether the host supports soft-dirty bits
+    cm_hash hash{};
+    cm_hash tracked_hash{};
+    cm_hash other_hash{};
+    for (uint64_t mcycle = 20000; mcycle <= 300000; mcycle += 20000) {
+        error_code = cm_machine_run(machine, mcycle, nullptr, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        error_code = cm_get_root_hash(machine, &tracked_hash, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        error_code = cm_machine_run(other, mcycle, nullptr, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        error_code = cm_get_root_hash(other, &other_hash, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK_EQUAL(0, memcmp(tracked_hash, other_hash, sizeof(cm_hash)));
+    }
+    error_code = cm_machine_run(_machine, 300000, nullptr, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_get_root_hash(_machine, &hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(hash, tracked_hash, sizeof(cm_hash)));
+    bool result{};
+    error_code = cm_verify_dirty_page_maps(machine, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+
+    cm_delete_machine(other);
+    cm_delete_machine(machine);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(reclaim_pristine_pages_test, ordinary_machine_fixture) {
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.reclaim_pristine_pages = true;
+    cm_machine *machine{};
+    int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // Zeroing written pages makes them reclaimable, so they must still read and hash as zeros
+    constexpr uint64_t address = 0x80080000;
+    std::array<uint8_t, 3 * 4096> data{};
+    std::array<uint8_t, 3 * 4096> zeros{};
+    data.fill(0xda);
+    cm_hash initial_hash{};
+    error_code = cm_get_root_hash(machine, &initial_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_write_memory(machine, address, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash written_hash{};
+    error_code = cm_get_root_hash(machine, &written_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_write_memory(machine, address, zeros.data(), zeros.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash hash{};
+    error_code = cm_get_root_hash(machine, &hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(initial_hash, hash, sizeof(cm_hash)));
+    std::array<uint8_t, 3 * 4096> read{};
+    read.fill(0xff);
+    error_code = cm_read_memory(machine, address, read.data(), read.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(read == zeros);
+
+    // Reclaimed pages come back when written again
+    error_code = cm_write_memory(machine, address, data.data(), data.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    error_code = cm_get_root_hash(machine, &hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(written_hash, hash, sizeof(cm_hash)));
+    bool result{};
+    error_code = cm_verify_dirty_page_maps(machine, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+    auto verification = calculate_emulator_hash(machine);
+    BOOST_CHECK_EQUAL_COLLECTIONS(verification.begin(), verification.end(), hash, hash + sizeof(cm_hash));
+
+    cm_delete_machine(machine);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(private_ram_image_test, ordinary_machine_fixture) {
+    // The image is shorter than RAM and does not end at a page boundary
+    constexpr uint64_t ram_start = 0x80000000;
+    const std::string image_path = "/tmp/test-private-ram-image.bin";
+    std::vector<uint8_t> image(3 * 4096 + 100, 0x5a);
+    {
+        std::ofstream out(image_path, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+    }
+    delete[] _machine_config.ram.image_filename;
+    _machine_config.ram.image_filename = new_cstr(image_path.c_str());
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.reclaim_pristine_pages = true;
+    cm_machine *machine{};
+    int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // RAM holds the image followed by zeros
+    std::vector<uint8_t> expected(5 * 4096, 0);
+    std::copy(image.begin(), image.end(), expected.begin());
+    std::vector<uint8_t> read(expected.size(), 0xff);
+    error_code = cm_read_memory(machine, ram_start, read.data(), read.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(read == expected);
+
+    // Zeroed pages backed by the image must not revert to the image when reclaimed
+    std::vector<uint8_t> zeros(2 * 4096, 0);
+    error_code = cm_write_memory(machine, ram_start, zeros.data(), zeros.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash hash{};
+    error_code = cm_get_root_hash(machine, &hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    std::fill(expected.begin(), expected.begin() + static_cast<std::ptrdiff_t>(zeros.size()), 0);
+    error_code = cm_read_memory(machine, ram_start, read.data(), read.size(), nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(read == expected);
+    auto verification = calculate_emulator_hash(machine);
+    BOOST_CHECK_EQUAL_COLLECTIONS(verification.begin(), verification.end(), hash, hash + sizeof(cm_hash));
+    bool result{};
+    error_code = cm_verify_merkle_tree(machine, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+
+    // Writes stay private to the machine
+    std::vector<uint8_t> on_disk(image.size());
+    {
+        std::ifstream in(image_path, std::ios::binary);
+        in.read(reinterpret_cast<char *>(on_disk.data()), static_cast<std::streamsize>(on_disk.size()));
+    }
+    BOOST_CHECK(on_disk == image);
+
+    cm_delete_machine(machine);
+    std::filesystem::remove(image_path);
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(rewritten_ram_image_test, ordinary_machine_fixture) {
+    constexpr uint64_t ram_start = 0x80000000;
+    const std::string image_path = "/tmp/test-rewritten-ram-image.bin";
+    const auto write_image = [&](uint8_t value) {
+        // Rewrite the image in place, as truncating a mapped image would kill the process with SIGBUS
+        std::fstream out(image_path, std::ios::in | std::ios::out | std::ios::binary);
+        const std::vector<uint8_t> image(2 * 4096, value);
+        out.write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+    };
+    std::ofstream{image_path, std::ios::binary}.close();
+    delete[] _machine_config.ram.image_filename;
+    _machine_config.ram.image_filename = new_cstr(image_path.c_str());
+    const auto check_rewrite = [&](bool copy_images, uint8_t expected_first_page) {
+        write_image(0x5a);
+        cm_machine_runtime_config runtime_config = _runtime_config;
+        runtime_config.copy_images = copy_images;
+        cm_machine *machine{};
+        int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        std::vector<uint8_t> page(4096, 0xda);
+        error_code = cm_write_memory(machine, ram_start + 4096, page.data(), page.size(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        write_image(0xa5);
+        // Pages the machine wrote are its own, but unwritten pages of a mapped image follow the file
+        std::vector<uint8_t> read(2 * 4096);
+        error_code = cm_read_memory(machine, ram_start, read.data(), read.size(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        BOOST_CHECK(
+            std::all_of(read.begin(), read.begin() + 4096, [&](uint8_t b) { return b == expected_first_page; }));
+        BOOST_CHECK(std::all_of(read.begin() + 4096, read.end(), [](uint8_t b) { return b == 0xda; }));
+        cm_delete_machine(machine);
+    };
+    check_rewrite(true, 0x5a);
+    check_rewrite(false, 0xa5);
+    std::filesystem::remove(image_path);
+}
+
+// Counts mappings of this process the kernel was asked to back with transparent huge pages
+static int count_huge_page_mappings(void) {
+    std::ifstream smaps("/proc/self/smaps");
+    int count = 0;
+    std::string line;
+    while (std::getline(smaps, line)) {
+        if (line.rfind("VmFlags:", 0) == 0 && (line + " ").find(" hg ") != std::string::npos) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(huge_pages_test, ordinary_machine_fixture) {
+    // RAM large enough to hold a few whole huge pages
+    _machine_config.ram.length = 8 << 20;
+    cm_machine_runtime_config runtime_config = _runtime_config;
+    runtime_config.huge_pages = true;
+    runtime_config.reclaim_pristine_pages = true;
+    const int mappings_before = count_huge_page_mappings();
+    cm_machine *machine{};
+    int error_code = cm_create_machine(&_machine_config, &runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const int mappings_with_huge_pages = count_huge_page_mappings();
+    cm_machine *reference{};
+    error_code = cm_create_machine(&_machine_config, &_runtime_config, &reference, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    // Hosts with transparent huge pages must have accepted the advice for the machine, and only for it
+    if (std::filesystem::exists("/sys/kernel/mm/transparent_hugepage/enabled") &&
+        std::filesystem::exists("/proc/self/smaps")) {
+        BOOST_CHECK_GT(mappings_with_huge_pages, mappings_before);
+        BOOST_CHECK_EQUAL(count_huge_page_mappings(), mappings_with_huge_pages);
+    }
+
+    // Pages are still tracked one by one, including zeroed pages inside a huge page
+    constexpr uint64_t address = 0x80300000;
+    std::array<uint8_t, 3 * 4096> data{};
+    std::array<uint8_t, 4096> zeros{};
+    data.fill(0xda);
+    for (auto *m : {machine, reference}) {
+        error_code = cm_write_memory(m, address, data.data(), data.size(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        cm_hash hash{};
+        error_code = cm_get_root_hash(m, &hash, nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+        error_code = cm_write_memory(m, address + 4096, zeros.data(), zeros.size(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    }
+    cm_hash hash{};
+    error_code = cm_get_root_hash(machine, &hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    cm_hash reference_hash{};
+    error_code = cm_get_root_hash(reference, &reference_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK_EQUAL(0, memcmp(hash, reference_hash, sizeof(cm_hash)));
+    bool result{};
+    error_code = cm_verify_dirty_page_maps(machine, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+    auto verification = calculate_emulator_hash(machine);
+    BOOST_CHECK_EQUAL_COLLECTIONS(verification.begin(), verification.end(), hash, hash + sizeof(cm_hash));
+
+    cm_delete_machine(reference);
+    cm_delete_machine(machine);
+}
+
+// Reads the resident set size of this process, in bytes
+static uint64_t get_resident_set_size(void) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmRSS:", 0) == 0) {
+            return std::stoull(line.substr(6)) << 10;
+        }
+    }
+    return 0;
+}
+
+BOOST_FIXTURE_TEST_CASE_NOLINT(large_ram_dense_merkle_tree_test, ordinary_machine_fixture) {
+    // 4 GiB of RAM at 0x80000000 is not an aligned power of two, so it is split into two 2 GiB dense subtrees.
+    // A sparse tree would hold a node for each of its pages, and take hundreds of MiB.
+    _machine_config.ram.length = UINT64_C(4) << 30;
+    const uint64_t rss_before = get_resident_set_size();
+    cm_machine *machine{};
+    int error_code = cm_create_machine(&_machine_config, &_runtime_config, &machine, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+
+    std::array<uint8_t, 4096> data{};
+    data.fill(0xda);
+    for (const uint64_t address : {UINT64_C(0xfffff000), UINT64_C(0x100000000), UINT64_C(0x17ffff000)}) {
+        error_code = cm_write_memory(machine, address, data.data(), data.size(), nullptr);
+        BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    }
+    cm_merkle_tree_proof *proof{};
+    error_code = cm_get_proof(machine, 0x17ffff000, 12, &proof, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const auto page_hash = merkle_hash(std::string_view{reinterpret_cast<const char *>(data.data()), data.size()}, 12);
+    BOOST_CHECK_EQUAL_COLLECTIONS(page_hash.begin(), page_hash.end(), proof->target_hash,
+        proof->target_hash + sizeof(cm_hash));
+    cm_hash root_hash{};
+    error_code = cm_get_root_hash(machine, &root_hash, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    const auto proof_root_hash = calculate_proof_root_hash(proof);
+    BOOST_CHECK_EQUAL_COLLECTIONS(proof_root_hash.begin(), proof_root_hash.end(), root_hash,
+        root_hash + sizeof(cm_hash));
+    cm_delete_merkle_tree_proof(proof);
+    bool result{};
+    error_code = cm_verify_merkle_tree(machine, &result, nullptr);
+    BOOST_REQUIRE_EQUAL(error_code, CM_ERROR_OK);
+    BOOST_CHECK(result);
+    BOOST_CHECK_LT(get_resident_set_size() - rss_before, UINT64_C(64) << 20);
+
+    cm_delete_machine(machine);
+}
+
 BOOST_AUTO_TEST_CASE_NOLINT(machine_run_uarch_null_machine_test) {
     auto status{CM_UARCH_BREAK_REASON_REACHED_TARGET_CYCLE};
     int error_code = cm_machine_run_uarch(nullptr, 1000, &status, nullptr);
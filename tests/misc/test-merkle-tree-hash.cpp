@@ -309,6 +309,55 @@ int main(int argc, char *argv[]) try {
         }
         ++leaf_count;
     }
+    // 5) The back_merkle_tree can also receive ranges of leaf hashes,
+    // split at any point, with their subtrees hashed in parallel
+    for (uint64_t split = 0; split <= leaf_count; ++split) {
+        back_merkle_tree range_tree{log2_root_size, log2_leaf_size, log2_word_size};
+        range_tree.push_back_range(leaf_hashes.data(), split);
+        range_tree.push_back_range(leaf_hashes.data() + split, leaf_count - split, 3);
+        if (range_tree.get_root_hash() != back_tree.get_root_hash()) {
+            error("mismatch in root hash for back tree and "
+                  "back tree from ranges\n");
+            return 1;
+        }
+    }
+    // 6) The complete_merkle_tree and the full_merkle_tree can have
+    // existing leaves replaced, one by one or in runs
+    if (leaf_count > 0) {
+        full_merkle_tree full_tree(log2_root_size, log2_leaf_size, log2_word_size, leaf_hashes, 3);
+        auto changed_hashes = leaf_hashes;
+        for (uint64_t i = 0; i < leaf_count; i += 3) {
+            get_concat_hash(h, changed_hashes[i], changed_hashes[i], changed_hashes[i]);
+            complete_tree.set_leaf(i, changed_hashes[i]);
+            full_tree.set_leaves(i, {changed_hashes[i]});
+        }
+        const uint64_t half = leaf_count / 2;
+        for (uint64_t i = half; i < leaf_count; ++i) {
+            get_concat_hash(h, changed_hashes[i], leaf_hashes[i], changed_hashes[i]);
+        }
+        complete_tree.set_leaves(half,
+            {changed_hashes.begin() + static_cast<std::ptrdiff_t>(half), changed_hashes.end()});
+        full_tree.set_leaves(half, {changed_hashes.begin() + static_cast<std::ptrdiff_t>(half), changed_hashes.end()},
+            3);
+        full_merkle_tree changed_tree(log2_root_size, log2_leaf_size, log2_word_size, changed_hashes);
+        if (complete_tree.get_root_hash() != changed_tree.get_root_hash()) {
+            error("mismatch in root hash for changed complete tree and "
+                  "tree from scratch\n");
+            return 1;
+        }
+        if (full_tree.get_root_hash() != changed_tree.get_root_hash()) {
+            error("mismatch in root hash for changed full tree and "
+                  "tree from scratch\n");
+            return 1;
+        }
+        for (uint64_t i = 0; i < leaf_count; ++i) {
+            if (complete_tree.get_proof(i << log2_leaf_size, log2_leaf_size) !=
+                changed_tree.get_proof(i << log2_leaf_size, log2_leaf_size)) {
+                error("mismatch in leaf proofs for changed complete tree and "
+                      "tree from scratch\n");
+            }
+        }
+    }
     (void) fprintf(stderr, "passed test\n");
     print_hash(back_tree.get_root_hash(), stdout);
     return 0;